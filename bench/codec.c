@@ -0,0 +1,145 @@
+/* codec: times the v1 header codec over a fixed set of frames
+ *
+ *   codec [payload max] [frames.bin]
+ *
+ * payloads are 1 to <payload max> bytes, 255 by default, 3 shows the header alone;
+ * every frame is encoded, viewed and copied back first, and any one that does not come back as
+ * the packet it was built from is counted as a mismatch; the frames come from a fixed seed, so
+ * writing them to frames.bin and comparing that file across two builds checks the bytes match */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "packet/packet.h"
+
+
+/*** data ***/
+
+#define CODEC_FRAMES 4096
+#define CODEC_ROUNDS 2000
+#define CODEC_SEED 7
+
+static packet_t packets[CODEC_FRAMES];
+static uint8_t bufs[CODEC_FRAMES][PACKET_SIZE_MAX];
+
+
+/*** aux ***/
+
+static double
+codec_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void
+codec_fill(char* str, int len) {
+    for (int i = 0; i < len; ++i) {
+        str[i] = (char)('a' + rand() % 26);
+    }
+}
+
+/* a spread of what a room carries: messages without options, whispers with, joins to a room */
+static void
+codec_build(packet_t* packet, int payld_max) {
+    static const uint8_t flags[] = {PACKET_FLAG_MSG, PACKET_FLAG_WHSP, PACKET_FLAG_JOIN};
+    int kind = rand() % 3;
+
+    memset(packet, 0, sizeof(*packet));
+    codec_fill(packet->usrname, 1 + rand() % SIZE_USRNAME);
+    codec_fill(packet->options, flags[kind] == PACKET_FLAG_MSG ? 0 : 1 + rand() % SIZE_OPTIONS);
+
+    packet->flags = flags[kind];
+    packet->crc = 1 + (uint32_t)rand() * 2654435761u;
+    packet->nonce = ((uint64_t)rand() << 33) ^ (uint64_t)rand();
+    packet->timestamp = ((uint64_t)rand() << 20) ^ (uint64_t)rand();
+    packet->payld_len = (uint8_t)(1 + rand() % payld_max);
+    codec_fill(packet->payld, packet->payld_len);
+}
+
+static bool
+codec_same(const packet_t* a, const packet_t* b) {
+    return strcmp(a->usrname, b->usrname) == 0 && strcmp(a->options, b->options) == 0
+        && a->flags == b->flags && a->crc == b->crc && a->nonce == b->nonce
+        && a->timestamp == b->timestamp && a->payld_len == b->payld_len
+        && memcmp(a->payld, b->payld, a->payld_len) == 0;
+}
+
+
+/*** main ***/
+
+int
+main(int argc, char** argv) {
+    int payld_max = argc > 1 ? atoi(argv[1]) : SIZE_PAYLD;
+
+    if (payld_max < 1 || payld_max > SIZE_PAYLD) {
+        fprintf(stderr, "usage: codec [payload max, 1 to %d] [frames.bin]\n", SIZE_PAYLD);
+        return EXIT_FAILURE;
+    }
+
+    srand(CODEC_SEED);
+
+    for (int i = 0; i < CODEC_FRAMES; ++i) {
+        codec_build(&packets[i], payld_max);
+        packet_encode(&packets[i], bufs[i]);
+    }
+
+    if (argc > 2) {
+        FILE* file = fopen(argv[2], "wb");
+
+        if (file == NULL) {
+            perror("codec: fopen");
+            return EXIT_FAILURE;
+        }
+
+        for (int i = 0; i < CODEC_FRAMES; ++i) {
+            fwrite(bufs[i], 1, (size_t)PACKET_SIZE_MIN + packets[i].payld_len, file);
+        }
+
+        fclose(file);
+    }
+
+    int mismatches = 0;
+
+    for (int i = 0; i < CODEC_FRAMES; ++i) {
+        packet_view_t view;
+        packet_t copy;
+
+        (void)packet_view_head(&view, bufs[i]);
+        packet_view_copy(&view, &copy);
+        mismatches += !codec_same(&copy, &packets[i]);
+    }
+
+    volatile uint64_t sink = 0;
+    double start = codec_now();
+
+    for (int r = 0; r < CODEC_ROUNDS; ++r) {
+        for (int i = 0; i < CODEC_FRAMES; ++i) {
+            packet_encode(&packets[i], bufs[i]);
+            sink += bufs[i][OFFSET_NONCE];
+        }
+    }
+
+    double encoded = codec_now();
+
+    for (int r = 0; r < CODEC_ROUNDS; ++r) {
+        for (int i = 0; i < CODEC_FRAMES; ++i) {
+            packet_view_t view;
+
+            (void)packet_view_head(&view, bufs[i]);
+            sink += view.nonce + view.usrname.len;
+        }
+    }
+
+    double viewed = codec_now();
+    double per = CODEC_FRAMES * (double)CODEC_ROUNDS;
+
+    printf("codec: %d frames of 1 to %d bytes, %d mismatches, encode %.1f ns, view_head %.1f ns\n",
+           CODEC_FRAMES, payld_max, mismatches, (encoded - start) / per, (viewed - encoded) / per);
+
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,280 @@
+/* fanout: bursts room messages through a running host and times their delivery
+ *
+ *   fanout <ip> <port> <senders> <receivers> <frames> [payload bytes]
+ *
+ * every peer joins the room "bench", once all of them are in each sender writes <frames> messages
+ * as fast as the host takes them and each receiver counts every one it gets, it speaks v1 and
+ * never offers a HELO; run the host under bin/sendcount.so to count its send calls too */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "net/net.h"
+#include "packet/packet.h"
+#include "packet/parser/parser.h"
+
+
+/*** data ***/
+
+#define FANOUT_ROOM "bench"
+#define FANOUT_BATCH 64                         /* frames encoded per write */
+#define FANOUT_IDLE_MS 5000                     /* no progress for this long ends the run */
+
+typedef struct peer {
+    int fd;
+    bool sender;
+    bool joined;                                /* the host answered the JOIN */
+    char usrname[SIZE_USRNAME + 1];
+    packet_t packet;
+    packet_parser_t parser;
+    unsigned queued;
+    uint8_t out[FANOUT_BATCH * PACKET_SIZE_MAX];
+    size_t out_off;
+    size_t out_len;
+    unsigned long long frames;
+    unsigned long long bytes;
+} peer_t;
+
+
+/*** aux ***/
+
+static void
+fanout_die(const char* what) {
+    perror(what);
+    exit(EXIT_FAILURE);
+}
+
+static double
+fanout_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static unsigned
+fanout_uint(const char* arg) {
+    char* end;
+    unsigned long value = strtoul(arg, &end, 10);
+
+    if (*arg == '\0' || *end != '\0' || value == 0 || value > 1000000) {
+        fprintf(stderr, "fanout: %s is not a count\n", arg);
+        exit(EXIT_FAILURE);
+    }
+
+    return (unsigned)value;
+}
+
+
+/*** peers ***/
+
+static void
+fanout_connect(peer_t* peer, const char* ip, const char* port, unsigned idx, unsigned payld) {
+    peer->fd = get_socket_connect(ip, port);
+
+    if (peer->fd == -1) {
+        fanout_die("fanout: connect");
+    }
+
+    snprintf(peer->usrname, sizeof(peer->usrname), "%c%u", peer->sender ? 's' : 'r', idx);
+    packet_parser_init(&peer->parser);
+
+    packet_t join = packet_build(peer->usrname);
+
+    strncpy(join.options, FANOUT_ROOM, SIZE_OPTIONS);
+    packet_seal(&join, PACKET_FLAG_JOIN);
+
+    if (packet_send(&join, peer->fd) < 0) {
+        fanout_die("fanout: join");
+    }
+
+    if (set_socket_nonblock(peer->fd) == -1) {
+        fanout_die("fanout: nonblock");
+    }
+
+    peer->packet = packet_build(peer->usrname);
+    memset(peer->packet.payld, 'x', payld);
+}
+
+static bool
+fanout_read(peer_t* peer) {
+    uint8_t buf[1 << 16];
+    ssize_t n = recv(peer->fd, buf, sizeof(buf), 0);
+
+    if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return true;
+    }
+
+    if (n <= 0) {
+        return false;
+    }
+
+    size_t off = 0;
+
+    while (off < (size_t)n) {
+        size_t used;
+        packet_view_t view;
+        int rv = packet_parser_feed(&peer->parser, buf + off, (size_t)n - off, &used, &view);
+
+        off += used;
+
+        if (rv != PARSE_FRAME) {
+            continue;
+        }
+
+        if (view.flags == PACKET_FLAG_MSG) {
+            peer->frames += 1;
+            peer->bytes += view.len;
+        } else if (view.flags == PACKET_FLAG_JOIN && packet_str_eq(view.usrname, peer->usrname)) {
+            peer->joined = true;
+        }
+    }
+
+    return true;
+}
+
+static bool
+fanout_write(peer_t* peer, unsigned frames) {
+    if (peer->out_off == peer->out_len) {
+        peer->out_off = peer->out_len = 0;
+
+        for (; peer->queued < frames && peer->out_len + PACKET_SIZE_MAX <= sizeof(peer->out); ++peer->queued) {
+            packet_seal(&peer->packet, PACKET_FLAG_MSG);
+            packet_encode(&peer->packet, peer->out + peer->out_len);
+            peer->out_len += PACKET_SIZE_MIN + peer->packet.payld_len;
+        }
+    }
+
+    if (peer->out_off == peer->out_len) {
+        return true;
+    }
+
+    ssize_t n = send(peer->fd, peer->out + peer->out_off, peer->out_len - peer->out_off, MSG_NOSIGNAL);
+
+    if (n == -1) {
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+
+    peer->out_off += (size_t)n;
+
+    return true;
+}
+
+
+/*** main ***/
+
+int
+main(int argc, char** argv) {
+    if (argc != 6 && argc != 7) {
+        fprintf(stderr, "usage: fanout <ip> <port> <senders> <receivers> <frames> [payload bytes]\n");
+        return EXIT_FAILURE;
+    }
+
+    unsigned senders = fanout_uint(argv[3]);
+    unsigned receivers = fanout_uint(argv[4]);
+    unsigned frames = fanout_uint(argv[5]);
+    unsigned payld = argc == 7 ? fanout_uint(argv[6]) : 64;
+    unsigned count = senders + receivers;
+
+    if (payld > SIZE_PAYLD) {
+        fprintf(stderr, "fanout: a payload is at most %d bytes\n", SIZE_PAYLD);
+        return EXIT_FAILURE;
+    }
+
+    peer_t* peers = calloc(count, sizeof(peer_t));
+    struct pollfd* fds = calloc(count, sizeof(struct pollfd));
+
+    if (peers == NULL || fds == NULL) {
+        fanout_die("fanout: calloc");
+    }
+
+    for (unsigned i = 0; i < count; ++i) {
+        peers[i].sender = i < senders;
+        fanout_connect(&peers[i], argv[1], argv[2], peers[i].sender ? i : i - senders, payld);
+        fds[i] = (struct pollfd) { .fd = peers[i].fd, .events = POLLIN };
+    }
+
+    unsigned long long expect = (unsigned long long)senders * frames * receivers;
+    unsigned long long got = 0;
+    unsigned joined = 0;
+    double start = 0.0, last = fanout_now();
+
+    while (got < expect && fanout_now() - last < FANOUT_IDLE_MS / 1000.0) {
+        bool bursting = joined == count;
+
+        for (unsigned i = 0; i < count; ++i) {
+            bool out = bursting && peers[i].sender && (peers[i].queued < frames || peers[i].out_off < peers[i].out_len);
+
+            fds[i].events = (short)(POLLIN | (out ? POLLOUT : 0));
+        }
+
+        if (poll(fds, count, 100) == -1 && errno != EINTR) {
+            fanout_die("fanout: poll");
+        }
+
+        got = 0;
+        joined = 0;
+
+        for (unsigned i = 0; i < count; ++i) {
+            peer_t* peer = &peers[i];
+            unsigned long long before = peer->frames;
+
+            if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && !fanout_read(peer)) {
+                fprintf(stderr, "fanout: %s was disconnected\n", peer->usrname);
+                return EXIT_FAILURE;
+            }
+
+            if ((fds[i].revents & POLLOUT) && !fanout_write(peer, frames)) {
+                fanout_die("fanout: send");
+            }
+
+            if (peer->frames != before || (fds[i].revents & POLLOUT)) {
+                last = fanout_now();
+            }
+
+            got += peer->sender ? 0 : peer->frames;
+            joined += peer->joined;
+        }
+
+        if (joined == count && start == 0.0) {
+            start = last = fanout_now();
+        }
+    }
+
+    double secs = fanout_now() - start;
+    unsigned long long bytes = 0;
+
+    for (unsigned i = senders; i < count; ++i) {
+        bytes += peers[i].bytes;
+    }
+
+    if (joined != count) {
+        fprintf(stderr, "fanout: only %u of %u peers joined\n", joined, count);
+        return EXIT_FAILURE;
+    }
+
+    if (got == expect) {                        /* the idle wait is not delivery time */
+        secs = last - start;
+    }
+
+    printf("fanout: %u senders x %u receivers x %u frames of %u bytes\n", senders, receivers, frames, payld);
+    printf("fanout: %llu of %llu delivered, %.1f MB in %.3f s, %.0f frames/s, %.2f ns/byte\n",
+           got, expect, (double)bytes / 1e6, secs, (double)got / secs, secs * 1e9 / (double)bytes);
+
+    for (unsigned i = 0; i < count; ++i) {
+        close(peers[i].fd);
+    }
+
+    free(peers);
+    free(fds);
+
+    return got == expect ? EXIT_SUCCESS : EXIT_FAILURE;
+}
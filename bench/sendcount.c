@@ -0,0 +1,188 @@
+/* sendcount: an LD_PRELOAD shim counting the calls a process makes to put bytes on a socket
+ *
+ *   LD_PRELOAD=bin/sendcount.so bin/rooms host ...
+ *
+ * prints the counts to stderr at exit, or on SIGINT or SIGTERM since the host runs until killed;
+ * writes to anything but a socket are not counted, io_uring submissions never reach these wrappers */
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+
+/*** data ***/
+
+typedef enum {
+    COUNT_SEND,
+    COUNT_SENDMSG,
+    COUNT_SENDMMSG,
+    COUNT_WRITE,
+    COUNT_WRITEV,
+    COUNT_LEN,
+} count_call_t;
+
+static const char* const COUNT_NAMES[COUNT_LEN] = {"send", "sendmsg", "sendmmsg", "write", "writev"};
+
+static atomic_ullong calls[COUNT_LEN];
+static atomic_ullong bytes[COUNT_LEN];
+
+
+/*** aux ***/
+
+static void
+count_next(const char* name, void* next) {   /* next points at a function pointer, ISO C cannot assign one a void* */
+    void* fn = dlsym(RTLD_NEXT, name);
+
+    if (fn == NULL) {
+        static const char msg[] = "sendcount: dlsym failed\n";
+
+        (void)!write(STDERR_FILENO, msg, sizeof(msg) - 1);
+        _exit(1);
+    }
+
+    memcpy(next, &fn, sizeof(fn));
+}
+
+static void
+count_add(count_call_t call, ssize_t n) {
+    atomic_fetch_add_explicit(&calls[call], 1, memory_order_relaxed);
+
+    if (n > 0) {
+        atomic_fetch_add_explicit(&bytes[call], (unsigned long long)n, memory_order_relaxed);
+    }
+}
+
+static int
+count_is_socket(int fd) {
+    struct stat st;
+
+    return fstat(fd, &st) == 0 && S_ISSOCK(st.st_mode);
+}
+
+static void
+count_report(void) {
+    char buf[512];
+    int len = snprintf(buf, sizeof(buf), "sendcount: pid %d\n", (int)getpid());
+
+    for (int i = 0; i < COUNT_LEN && len < (int)sizeof(buf); ++i) {
+        unsigned long long n = atomic_load(&calls[i]);
+
+        if (n != 0) {
+            len += snprintf(buf + len, sizeof(buf) - (size_t)len, "sendcount: %-8s %12llu calls %14llu bytes\n",
+                            COUNT_NAMES[i], n, atomic_load(&bytes[i]));
+        }
+    }
+
+    (void)!write(STDERR_FILENO, buf, (size_t)len < sizeof(buf) ? (size_t)len : sizeof(buf) - 1);
+}
+
+static void
+count_signal(int sig) {
+    count_report();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+__attribute__((constructor)) static void
+count_init(void) {
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = count_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    atexit(count_report);
+}
+
+
+/*** wrappers ***/
+
+ssize_t
+send(int fd, const void* buf, size_t len, int flags) {
+    static ssize_t (*next)(int, const void*, size_t, int);
+
+    if (next == NULL) {
+        count_next("send", &next);
+    }
+
+    ssize_t n = next(fd, buf, len, flags);
+
+    count_add(COUNT_SEND, n);
+    return n;
+}
+
+ssize_t
+sendmsg(int fd, const struct msghdr* msg, int flags) {
+    static ssize_t (*next)(int, const struct msghdr*, int);
+
+    if (next == NULL) {
+        count_next("sendmsg", &next);
+    }
+
+    ssize_t n = next(fd, msg, flags);
+
+    count_add(COUNT_SENDMSG, n);
+    return n;
+}
+
+int
+sendmmsg(int fd, struct mmsghdr* msgs, unsigned int vlen, int flags) {
+    static int (*next)(int, struct mmsghdr*, unsigned int, int);
+
+    if (next == NULL) {
+        count_next("sendmmsg", &next);
+    }
+
+    int n = next(fd, msgs, vlen, flags);
+    ssize_t sent = 0;
+
+    for (int i = 0; i < n; ++i) {
+        sent += msgs[i].msg_len;
+    }
+
+    count_add(COUNT_SENDMMSG, sent);
+    return n;
+}
+
+ssize_t
+write(int fd, const void* buf, size_t len) {
+    static ssize_t (*next)(int, const void*, size_t);
+
+    if (next == NULL) {
+        count_next("write", &next);
+    }
+
+    ssize_t n = next(fd, buf, len);
+
+    if (count_is_socket(fd)) {
+        count_add(COUNT_WRITE, n);
+    }
+
+    return n;
+}
+
+ssize_t
+writev(int fd, const struct iovec* iov, int iovcnt) {
+    static ssize_t (*next)(int, const struct iovec*, int);
+
+    if (next == NULL) {
+        count_next("writev", &next);
+    }
+
+    ssize_t n = next(fd, iov, iovcnt);
+
+    if (count_is_socket(fd)) {
+        count_add(COUNT_WRITEV, n);
+    }
+
+    return n;
+}
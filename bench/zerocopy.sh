@@ -0,0 +1,29 @@
+#!/bin/sh
+# zerocopy: times the same fan-out burst against a host copying and one pinning with MSG_ZEROCOPY
+#
+#   bench/zerocopy.sh [senders] [receivers] [frames] [payload bytes]
+#
+# run from the repo root after make bench; on loopback the kernel copies pinned pages anyway and
+# reports SO_EE_CODE_ZEROCOPY_COPIED, so only a run across a real nic shows the difference
+
+set -eu
+
+SENDERS=${1:-4}
+RECEIVERS=${2:-64}
+FRAMES=${3:-5000}
+PAYLD=${4:-255}
+PORT=${PORT:-7900}
+IO=${IO:-epoll}
+
+for zerocopy in off on; do
+    bin/rooms host --port "$PORT" --io "$IO" --zerocopy "$zerocopy" --queue 65536 >/dev/null 2>&1 &
+    host=$!
+    sleep 1
+
+    echo "zerocopy $zerocopy:"
+    bin/fanout 127.0.0.1 "$PORT" "$SENDERS" "$RECEIVERS" "$FRAMES" "$PAYLD" || true
+
+    kill "$host"
+    wait "$host" 2>/dev/null || true
+    PORT=$((PORT + 1))
+done
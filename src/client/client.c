@@ -16,15 +16,20 @@
 #include "ui/ui.h"
 #include "conn/cconn.h"
 #include "conf/cconf.h"
+#include "dedup/cdedup.h"
+#include "inflight/cinflight.h"
 
 #include "../error/error.h"
 #include "../packet/packet.h"
+#include "../packet/reader/reader.h"
+#include "../syscall/syscall.h"
 
 
 /*** data ***/
 
 typedef struct threads {
     pthread_t listener;
+    pthread_t heartbeat;
 
     pthread_mutex_t lock_ui;
     pthread_mutex_t lock_conn;
@@ -37,6 +42,10 @@ typedef struct client_context {
     cconf_t* config;
     cthreads_t* threads;
     cconn_t* conn;
+    cdedup_t* dedup;                            /* guarded by lock_ui, like the ui */
+    cinflight_t* inflight;
+    packet_reader_t* reader;                    /* listener thread only */
+    uint64_t token;                             /* listener thread only, resumes the session */
     ui_t* ui;
 } ccontext_t;
 
@@ -44,10 +53,82 @@ typedef struct client_context {
 /*** synchronized ***/
 
 static void
-client_locked_enqueue(cthreads_t* threads, ui_t* ui, packet_t* packet) {
-    pthread_mutex_lock(&threads->lock_ui);
-    ui_handle_msg(ui, packet);
-    pthread_mutex_unlock(&threads->lock_ui);
+client_locked_enqueue(ccontext_t* ctx, const packet_view_t* view) {
+    pthread_mutex_lock(&ctx->threads->lock_ui);
+
+    if (cdedup_mark(ctx->dedup, view)) {        /* a catch-up may overlap what was already shown */
+        ui_handle_msg(ctx->ui, view);
+    }
+
+    pthread_mutex_unlock(&ctx->threads->lock_ui);
+}
+
+static void
+client_locked_track(ccontext_t* ctx, const packet_t* packet) {
+    packet_view_t view;
+
+    packet_view_of(&view, packet);
+
+    pthread_mutex_lock(&ctx->threads->lock_ui);
+
+    if (!cinflight_track(ctx->inflight, packet)) {
+        error_log("client err: too many unacknowledged messages, gave up on the oldest");
+    }
+
+    (void)cdedup_mark(ctx->dedup, &view);       /* a catch-up may bring it back */
+    ui_handle_sent(ctx->ui, &view);
+
+    pthread_mutex_unlock(&ctx->threads->lock_ui);
+}
+
+static void
+client_locked_ack(ccontext_t* ctx, const packet_ack_t* acks, unsigned count) {
+    pthread_mutex_lock(&ctx->threads->lock_ui);
+
+    for (unsigned i = 0; i < count; ++i) {
+        (void)cinflight_ack(ctx->inflight, &acks[i]);
+        ui_handle_ack(ctx->ui, &acks[i]);
+    }
+
+    pthread_mutex_unlock(&ctx->threads->lock_ui);
+}
+
+static unsigned
+client_locked_pending(ccontext_t* ctx, packet_t* packets, unsigned max) {
+    pthread_mutex_lock(&ctx->threads->lock_ui);
+
+    unsigned count = cinflight_pending(ctx->inflight, packets, max);
+
+    pthread_mutex_unlock(&ctx->threads->lock_ui);
+
+    return count;
+}
+
+static void
+client_locked_position(ccontext_t* ctx, char* usrname, uint64_t* nonce) {
+    pthread_mutex_lock(&ctx->threads->lock_ui);
+
+    if (!cdedup_position(ctx->dedup, usrname, nonce)) {
+        usrname[0] = '\0';
+    }
+
+    pthread_mutex_unlock(&ctx->threads->lock_ui);
+}
+
+static void
+client_locked_pong(ccontext_t* ctx, const packet_view_t* view) {
+    pthread_mutex_lock(&ctx->threads->lock_conn);
+
+    bool sampled = cconn_pong(ctx->conn, view);
+    int64_t srtt = ctx->conn->rtt.srtt_us;
+
+    pthread_mutex_unlock(&ctx->threads->lock_conn);
+
+    if (sampled) {                              /* never both locks at once */
+        pthread_mutex_lock(&ctx->threads->lock_ui);
+        ui_set_rtt(ctx->ui, srtt);
+        pthread_mutex_unlock(&ctx->threads->lock_ui);
+    }
 }
 
 static void
@@ -62,28 +143,192 @@ client_locked_refresh(cthreads_t* threads, ui_t* ui) {
 
 static void
 client_send(ccontext_t* ctx, packet_t* packet, uint8_t flags) {
+    bool tracked = flags & (PACKET_FLAG_MSG | PACKET_FLAG_WHSP);
+
     packet_seal(packet, flags);
 
-    if (packet_send(packet, ctx->conn->sockfd) < 0) {
-        error_shutdown("client err: packet_send");
+    if (tracked) {                              /* before the send, so its ack finds it */
+        client_locked_track(ctx, packet);
+    }
+
+    if (cconn_send(ctx->conn, packet, 1) < 0) {
+        if (atomic_load(&ctx->conn->online) && !tracked) {
+            error_shutdown("client err: packet_send");
+        }
+
+        error_log("client err: packet_send: offline");
+        return;
     }
 
-    client_locked_enqueue(ctx->threads, ctx->ui, packet);
+    if (!tracked && flags != PACKET_FLAG_JOIN) {    /* the room's presence frame shows that one */
+        packet_view_t view;
+
+        packet_view_of(&view, packet);
+        client_locked_enqueue(ctx, &view);
+    }
 }
 
 static void
-client_recv(ccontext_t* ctx) {
-    packet_t packet = {0};
+client_rejoin(ccontext_t* ctx) {
+    if (!atomic_load(&ctx->threads->running)) {     /* stopped instead of reconnecting */
+        return;
+    }
+
+    packet_t packet = packet_build(ctx->config->usrname);
+    packet_resume_t resume = {
+        .token = ctx->token,                    /* a resume is silent, peers see no JOIN nor DISC */
+        .nonce = 0,
+        .usrname = {0},
+    };
+
+    strncpy(packet.options, ctx->config->room, SIZE_OPTIONS);  /* a fresh socket starts in the lobby */
+    client_locked_position(ctx, resume.usrname, &resume.nonce);
+
+    if (resume.token != 0 || resume.usrname[0] != '\0') {
+        packet_set_resume(&packet, &resume);
+    }
+
+    packet_seal(&packet, PACKET_FLAG_JOIN);
+
+    if (cconn_send(ctx->conn, &packet, 1) < 0) {
+        error_log("client err: packet_send: rejoin");
+        return;
+    }
+
+    packet_t pending[CINFLIGHT_SIZE];
+    unsigned count = client_locked_pending(ctx, pending, CINFLIGHT_SIZE);
+
+    if (count > 0 && cconn_send(ctx->conn, pending, count) < 0) {  /* unchanged, so seen ones are dropped */
+        error_log("client err: packet_send: resend");
+    }
+}
+
+static bool
+client_token(ccontext_t* ctx, const packet_t* packet) {
+    packet_resume_t resume;
+
+    if (packet->flags != PACKET_FLAG_JOIN || strcmp(packet->usrname, ctx->config->usrname) != 0) {
+        return false;                           /* names are unique, our own JOIN is the server's notice */
+    }
+
+    if (packet_get_resume(packet, &resume)) {
+        ctx->token = resume.token;
+    }
+
+    return true;
+}
 
+static bool
+client_acked(ccontext_t* ctx, const packet_t* packet) {
+    packet_ack_t acks[PACKET_ACK_MAX];
+
+    if (packet->flags != PACKET_FLAG_ACK) {
+        return false;
+    }
+
+    client_locked_ack(ctx, acks, packet_get_acks(packet, acks, PACKET_ACK_MAX));
+
+    return true;
+}
+
+static bool
+client_pace(ccontext_t* ctx, const packet_t* packet) {
+    packet_retry_t retry;
+
+    if (!packet_get_retry(packet, &retry)) {
+        return false;
+    }
+
+    ctx->conn->retry_after_ms = retry.after_ms; /* obeyed once the server hangs up */
+    ctx->conn->retry_jitter_ms = retry.jitter_ms;
+
+    return true;
+}
+
+static bool
+client_agree(ccontext_t* ctx, const packet_t* packet) {
+    packet_hello_t hello;
+    wire_caps_t caps;
+
+    if (!packet_get_hello(packet, &hello)) {
+        return packet->flags == PACKET_FLAG_HELO;
+    }
+
+    /* an older server relays other clients' offers, only an answer from the server itself is ours */
+    if (strcmp(packet->usrname, PACKET_SERVER_USRNAME) != 0 || !wire_accept(&hello, &caps)) {
+        return true;
+    }
+
+    if (cconn_agree(ctx->conn, ctx->config->usrname, &caps) && caps.version == WIRE_V2) {
+        packet_reader_upgrade(ctx->reader, &caps);
+    }
+
+    return true;
+}
+
+static bool
+client_control(ccontext_t* ctx, const packet_view_t* view) {
+    packet_t packet;
+
+    if (view->flags != PACKET_FLAG_ACK && view->flags != PACKET_FLAG_JOIN && view->flags != PACKET_FLAG_DISC
+            && view->flags != PACKET_FLAG_HELO) {
+        return false;
+    }
+
+    packet_view_copy(view, &packet);
+
+    return client_acked(ctx, &packet) || client_token(ctx, &packet) || client_pace(ctx, &packet)
+            || client_agree(ctx, &packet);
+}
+
+static bool
+client_heartbeat(ccontext_t* ctx, const packet_view_t* view) {
+    packet_t pong;
+
+    if (view->flags == PACKET_FLAG_PONG) {
+        client_locked_pong(ctx, view);
+        return true;
+    }
+
+    if (view->flags != PACKET_FLAG_PING) {
+        return false;
+    }
+
+    packet_view_copy(view, &pong);
+    packet_build_pong(&pong);                   /* the server measures with its own nonce */
+
+    if (cconn_send(ctx->conn, &pong, 1) < 0) {
+        error_log("client err: packet_send: pong");
+    }
+
+    return true;
+}
+
+static void
+client_reconnect(ccontext_t* ctx) {
     cthreads_t* th = ctx->threads;
 
-    int bytes = packet_recv(&packet, ctx->conn->sockfd, RESYNC_NOLIMIT);
+    ui_toggle_conn(ctx->ui);
+    cconn_reconnect(ctx->conn, ctx->config, &th->running, &th->cond, &th->lock_conn);
+    packet_reader_reset(ctx->reader);           /* whatever was buffered belonged to the old socket */
+    client_rejoin(ctx);
+    ui_toggle_conn(ctx->ui);
+}
+
+static void
+client_recv(ccontext_t* ctx) {
+    packet_view_t view;
+
+    int bytes = packet_reader_next(ctx->reader, &view, ctx->conn->sockfd);
 
     if (bytes == RECV_DISCONN) {                           /* server disconnected */
-        ui_toggle_conn(ctx->ui);
-        cconn_reconnect(ctx->conn, ctx->config, &th->running, &th->cond, &th->lock_conn);
-        ui_toggle_conn(ctx->ui);
+        client_reconnect(ctx);
+        return;
+    }
 
+    if (bytes == RECV_DESYNC) {
+        error_log("client err: packet_recv: stream out of sync, reconnecting");
+        client_reconnect(ctx);
         return;
     }
 
@@ -92,9 +337,7 @@ client_recv(ccontext_t* ctx) {
             case ETIMEDOUT:
             case ECONNRESET:
                 error_log("client err: packet_recv: socket disconnected");
-                ui_toggle_conn(ctx->ui);
-                cconn_reconnect(ctx->conn, ctx->config, &th->running, &th->cond, &th->lock_conn);
-                ui_toggle_conn(ctx->ui);
+                client_reconnect(ctx);
                 break;
             default:
                 error_shutdown("client err: packet_recv: fatal");
@@ -109,7 +352,13 @@ client_recv(ccontext_t* ctx) {
         return;
     }
 
-    client_locked_enqueue(ctx->threads, ctx->ui, &packet);
+    atomic_store(&ctx->conn->heard, safe_time_ms());
+
+    if (client_heartbeat(ctx, &view) || client_control(ctx, &view)) {
+        return;
+    }
+
+    client_locked_enqueue(ctx, &view);
 }
 
 
@@ -121,7 +370,7 @@ client_stop(cthreads_t* th, cconn_t* conn) {
 
     cconn_shutdown(conn, SHUT_RD);                /* unlock the listener thread calling recv */
     atomic_store(&th->running, false);
-    pthread_cond_signal(&th->cond);
+    pthread_cond_broadcast(&th->cond);          /* the heartbeat and a reconnect backoff both wait on it */
 
     pthread_mutex_unlock(&th->lock_conn);
 }
@@ -129,6 +378,22 @@ client_stop(cthreads_t* th, cconn_t* conn) {
 
 /*** client loops ***/
 
+static void*
+client_loop_heartbeat(void* ctx_nullable) {
+    ccontext_t* ctx = (ccontext_t*) ctx_nullable;
+    cthreads_t* th = ctx->threads;
+
+    pthread_mutex_lock(&th->lock_conn);
+
+    while (atomic_load(&th->running)) {
+        cconn_beat(ctx->conn, ctx->config->usrname, &th->cond, &th->lock_conn);
+    }
+
+    pthread_mutex_unlock(&th->lock_conn);
+
+    return NULL;
+}
+
 static void*
 client_loop_listener(void* ctx_nullable) {
     ccontext_t* ctx = (ccontext_t*) ctx_nullable;
@@ -142,9 +407,11 @@ client_loop_listener(void* ctx_nullable) {
 
 static void
 client_loop_talker(ccontext_t* ctx) {
+    packet_t join = packet_build(ctx->config->usrname);
     packet_t packet = packet_build(ctx->config->usrname);
 
-    client_send(ctx, &packet, PACKET_FLAG_JOIN);
+    strncpy(join.options, ctx->config->room, SIZE_OPTIONS);
+    client_send(ctx, &join, PACKET_FLAG_JOIN);
 
     while (atomic_load(&ctx->threads->running)) {
         ui_signal_t rv = ui_handle_keypress(ctx->ui, packet.payld);
@@ -184,6 +451,10 @@ cthreads_init(ccontext_t* ctx) {
     if (pthread_create(&ctx->threads->listener, NULL, &client_loop_listener, ctx) != 0) {
         error_shutdown("threads err: create");
     }
+
+    if (pthread_create(&ctx->threads->heartbeat, NULL, &client_loop_heartbeat, ctx) != 0) {
+        error_shutdown("threads err: create");
+    }
 }
 
 static void
@@ -192,6 +463,10 @@ cthreads_free(ccontext_t* ctx) {
         error_shutdown("thread err: join");
     }
 
+    if (pthread_join(ctx->threads->heartbeat, NULL) != 0) {
+        error_shutdown("thread err: join");
+    }
+
     pthread_mutex_destroy(&ctx->threads->lock_ui);
     pthread_mutex_destroy(&ctx->threads->lock_conn);
     pthread_cond_destroy(&ctx->threads->cond);
@@ -207,6 +482,10 @@ static void
 ccontext_init(ccontext_t* ctx, const char** args) {
     cconf_init(&ctx->config, args);
     cconn_init(&ctx->conn, ctx->config);
+    cdedup_init(&ctx->dedup);
+    cinflight_init(&ctx->inflight);
+    packet_reader_init(&ctx->reader, RESYNC_NOLIMIT);
+    ctx->token = 0;
     ui_init(&ctx->ui);
     cthreads_init(ctx);
 }
@@ -216,6 +495,9 @@ ccontext_free(ccontext_t* ctx) {
     ui_free(ctx->ui);
     cthreads_free(ctx);
     cconn_free(ctx->conn);
+    cdedup_free(ctx->dedup);
+    cinflight_free(ctx->inflight);
+    packet_reader_free(ctx->reader);
     cconf_free(ctx->config);
 }
 
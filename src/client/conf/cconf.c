@@ -18,6 +18,7 @@ typedef enum {
     POS_USRNSME = 2,
     POS_IP,
     POS_PORT,
+    POS_ROOM,
 } cargs_t;
 
 
@@ -62,6 +63,23 @@ cconf_extract_port(const char** args) {
     return port;
 }
 
+static const char*
+cconf_extract_room(const char** args) {
+    if (args[POS_PORT] == NULL || args[POS_ROOM] == NULL) {
+        return "";
+    }
+
+    const char* room = args[POS_ROOM];
+
+    size_t len = strlen(room);
+
+    if (len == 0 || len > SIZE_OPTIONS) {
+        error_shutdown("cconf err: room length must be between 1 and %d", SIZE_OPTIONS);
+    }
+
+    return room;
+}
+
 
 /*** methods ***/
 
@@ -76,7 +94,8 @@ cconf_init(cconf_t** conf, const char** args) {
     **conf = (cconf_t) {
         .port    = cconf_extract_port(args),
         .ip      = cconf_extract_ip(args),
-        .usrname = cconf_extract_usrname(args)
+        .usrname = cconf_extract_usrname(args),
+        .room    = cconf_extract_room(args),
    };
 }
 
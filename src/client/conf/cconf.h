@@ -8,6 +8,7 @@ typedef struct config {
     const char* usrname;
     const char* ip;
     const char* port;
+    const char* room;                           /* empty for the lobby */
 } cconf_t;
 
 /*** methods ***/
@@ -13,6 +13,9 @@
 #include "../../syscall/syscall.h"
 #include "../../net/net.h"
 
+static void
+cconn_online(cconn_t* conn, const cconf_t* config, int sockfd);
+
 void
 cconn_init(cconn_t** conn_ptr, const cconf_t* config) {
     *conn_ptr = malloc(sizeof(cconn_t));
@@ -24,14 +27,30 @@ cconn_init(cconn_t** conn_ptr, const cconf_t* config) {
     cconn_t* conn = *conn_ptr;
 
     *conn = (cconn_t) {
-        .sockfd = get_socket_connect(config->ip, config->port),
-        .online = ATOMIC_VAR_INIT(true),
+        .sockfd = -1,
+        .online = ATOMIC_VAR_INIT(false),
+        .retry_after_ms = 0,
+        .retry_jitter_ms = 0,
+        .heard = ATOMIC_VAR_INIT(safe_time_ms()),
+        .ping_nonce = 0,
+        .ping_sent = 0,
+        .pinged = 0,
+        .missed = 0,
+        .caps = wire_caps_v1(),
+        .offered = false,
     };
 
-    if (conn->sockfd == -1) {
+    rtt_init(&conn->rtt);
+    pthread_mutex_init(&conn->lock_send, NULL);
+
+    int sockfd = get_socket_connect(config->ip, config->port);
+
+    if (sockfd == -1) {
         error_shutdown("conn err: failed to connect");
     }
 
+    cconn_online(conn, config, sockfd);
+
 #if defined(__APPLE__) || defined(__MACH__) /* on macOS SIGPIPE has to be disabled manually */
     struct sigaction sa;
     sa.sa_handler = SIG_IGN;
@@ -50,6 +69,89 @@ cconn_init(cconn_t** conn_ptr, const cconf_t* config) {
 #define INM_RETRIES 16
 #define JITTER_RATIO 8
 
+#define CCONN_SENDER 1                          /* our messages on a v2 stream, anything else names itself */
+
+#define BEAT_MS 5000
+#define MAX_MISSES 3
+#define RTT_STALE_BEATS 4                       /* a busy server is still pinged this often, to keep the rtt fresh */
+
+static void
+cconn_sleep(pthread_cond_t* cond, pthread_mutex_t* mutex, int64_t delay) {
+    struct timespec now, timeout;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    timeout.tv_sec = now.tv_sec + (now.tv_nsec + delay) / ONE_SC;
+    timeout.tv_nsec = (now.tv_nsec + delay) % ONE_SC;
+
+    pthread_cond_timedwait(cond, mutex, &timeout);
+}
+
+static bool
+cconn_pace(cconn_t* conn, pthread_cond_t* cond, pthread_mutex_t* mutex) {
+    if (conn->retry_after_ms == 0 && conn->retry_jitter_ms == 0) {
+        return false;
+    }
+
+    int64_t delay = conn->retry_after_ms * ONE_MS;
+
+    if (conn->retry_jitter_ms > 0) {
+        delay += (int64_t)((uint64_t)safe_rand() % (uint64_t)(conn->retry_jitter_ms * ONE_MS));
+    }
+
+    conn->retry_after_ms = 0;                   /* good for one reconnect only */
+    conn->retry_jitter_ms = 0;
+
+    cconn_sleep(cond, mutex, delay);
+
+    return true;
+}
+
+static void
+cconn_hello(cconn_t* conn, const char* usrname, const packet_hello_t* hello) {
+    packet_t packet = packet_build(usrname);
+
+    packet_set_hello(&packet, hello);
+    packet_seal(&packet, PACKET_FLAG_HELO);
+
+    if (packet_send(&packet, conn->sockfd) < 0) {
+        error_log("conn err: packet_send: hello");
+    }
+}
+
+static void
+cconn_online(cconn_t* conn, const cconf_t* config, int sockfd) {
+    packet_hello_t offer;
+
+    wire_offer(&offer);
+
+    pthread_mutex_lock(&conn->lock_send);       /* the offer goes first, whoever sends next */
+
+    conn->sockfd = sockfd;
+    conn->caps = wire_caps_v1();
+    conn->offered = true;
+    cconn_hello(conn, config->usrname, &offer);
+
+    pthread_mutex_unlock(&conn->lock_send);
+
+    conn->ping_sent = 0;                        /* a pong for the old socket never comes */
+    conn->missed = 0;
+    atomic_store(&conn->heard, safe_time_ms());
+    atomic_store(&conn->online, true);
+}
+
+static void
+cconn_ping(cconn_t* conn, const char* usrname, int64_t now) {
+    packet_t packet = packet_build_ping(usrname);
+
+    packet.nonce = ++conn->ping_nonce;          /* echoed back, so a late pong is not mistaken for this one */
+    conn->ping_sent = safe_time_us();
+    conn->pinged = now;
+
+    if (cconn_send(conn, &packet, 1) < 0) {
+        error_log("conn err: packet_send: ping");
+    }
+}
+
 void
 cconn_reconnect(cconn_t* conn, const cconf_t* config, const atomic_bool* retry, pthread_cond_t* cond, pthread_mutex_t* mutex) {
     if (!atomic_load(retry)) {
@@ -66,11 +168,13 @@ cconn_reconnect(cconn_t* conn, const cconf_t* config, const atomic_bool* retry,
 
     conn->sockfd = -1;
 
-    for (unsigned i = 0; i < INM_RETRIES; ++i) {
+    bool paced = cconn_pace(conn, cond, mutex);
+
+    for (unsigned i = 0; !paced && i < INM_RETRIES; ++i) {
         sockfd = get_socket_connect(config->ip, config->port);
 
         if (sockfd != -1) {
-            conn->sockfd = sockfd;
+            cconn_online(conn, config, sockfd);
             pthread_mutex_unlock(mutex);
 
             return;
@@ -83,8 +187,7 @@ cconn_reconnect(cconn_t* conn, const cconf_t* config, const atomic_bool* retry,
         sockfd = get_socket_connect(config->ip, config->port);
 
         if (sockfd != -1) {
-            conn->sockfd = sockfd;
-            atomic_store(&conn->online, true);
+            cconn_online(conn, config, sockfd);
             pthread_mutex_unlock(mutex);
 
             return;
@@ -96,16 +199,131 @@ cconn_reconnect(cconn_t* conn, const cconf_t* config, const atomic_bool* retry,
             backoff *= 2;
         }
 
-        struct timespec now, timeout;
-        clock_gettime(CLOCK_REALTIME, &now);
+        cconn_sleep(cond, mutex, backoff + jitter);
+    }
+
+    pthread_mutex_unlock(mutex);
+}
+
+static int
+cconn_encode(cconn_t* conn, const packet_t* packets, unsigned count) {
+    uint8_t buf[PACKET_BATCH_MAX * (WIRE_DEFINE_MAX + WIRE_SIZE_MAX)];
+    packet_view_t view;
+
+    int sent = 0;
+
+    for (unsigned first = 0; first < count; first += PACKET_BATCH_MAX) {
+        unsigned len = 0;
+
+        for (unsigned i = first; i < count && i < first + PACKET_BATCH_MAX; ++i) {
+            packet_view_of(&view, &packets[i]);
+
+            uint32_t sender = view.flags & (PACKET_FLAG_MSG | PACKET_FLAG_WHSP) ? CCONN_SENDER : 0;
+            uint64_t base = wire_rebase(&conn->wire, sender, view.nonce);
+
+            if (!wire_known(&conn->wire, sender, base, view.usrname)) {
+                len += wire_define(&conn->wire, sender, base, view.usrname, buf + len);
+            }
+
+            len += wire_encode(&conn->wire, &view, sender, base, buf + len);
+        }
+
+        int bytes = sendall(conn->sockfd, buf, len);
 
-        timeout.tv_sec = now.tv_sec + (now.tv_nsec + backoff + jitter) / ONE_SC;
-        timeout.tv_nsec = (now.tv_nsec + backoff + jitter) % ONE_SC;
+        if (bytes <= 0) {
+            return bytes;
+        }
 
-        pthread_cond_timedwait(cond, mutex, &timeout);
+        sent += bytes;
     }
 
-    pthread_mutex_unlock(mutex);
+    return sent;
+}
+
+int
+cconn_send(cconn_t* conn, const packet_t* packets, unsigned count) {
+    pthread_mutex_lock(&conn->lock_send);
+
+    int rv = conn->caps.version == WIRE_V2 ? cconn_encode(conn, packets, count)
+            : packet_sendv(packets, count, conn->sockfd);
+
+    pthread_mutex_unlock(&conn->lock_send);
+
+    return rv;
+}
+
+bool
+cconn_agree(cconn_t* conn, const char* usrname, const wire_caps_t* caps) {
+    packet_hello_t hello;
+
+    wire_hello(caps, &hello);
+
+    pthread_mutex_lock(&conn->lock_send);
+
+    if (!conn->offered) {                       /* answered already, or a stale one from the last socket */
+        pthread_mutex_unlock(&conn->lock_send);
+        return false;
+    }
+
+    conn->offered = false;
+
+    if (caps->version == WIRE_V2) {             /* confirmed, the server reads v2 from the frame after this one */
+        cconn_hello(conn, usrname, &hello);
+        wire_stream_init(&conn->wire, caps);
+    }
+
+    conn->caps = *caps;
+
+    pthread_mutex_unlock(&conn->lock_send);
+
+    return true;
+}
+
+void
+cconn_beat(cconn_t* conn, const char* usrname, pthread_cond_t* cond, pthread_mutex_t* mutex) {
+    cconn_sleep(cond, mutex, BEAT_MS * ONE_MS);
+
+    if (!atomic_load(&conn->online)) {          /* mid reconnect, the backoff sleeps on the same lock */
+        return;
+    }
+
+    int64_t now = safe_time_ms();
+    int64_t heard = atomic_load(&conn->heard);
+
+    if (heard >= conn->pinged) {
+        conn->missed = 0;
+    }
+
+    if (now - heard < BEAT_MS) {
+        if (now - conn->pinged >= BEAT_MS * RTT_STALE_BEATS) {
+            cconn_ping(conn, usrname, now);
+        }
+
+        return;
+    }
+
+    if (conn->missed >= MAX_MISSES) {
+        error_log("conn err: server silent for %u pings, reconnecting", conn->missed);
+        conn->missed = 0;
+        atomic_store(&conn->online, false);
+        cconn_shutdown(conn, SHUT_RDWR);        /* the listener sees a hangup and reconnects */
+        return;
+    }
+
+    conn->missed += 1;
+    cconn_ping(conn, usrname, now);
+}
+
+bool
+cconn_pong(cconn_t* conn, const packet_view_t* pong) {
+    if (conn->ping_sent == 0 || pong->nonce != conn->ping_nonce) {
+        return false;
+    }
+
+    rtt_sample(&conn->rtt, safe_time_us() - conn->ping_sent);
+    conn->ping_sent = 0;
+
+    return true;
 }
 
 void
@@ -121,5 +339,6 @@ cconn_free(cconn_t* conn) {
         close(conn->sockfd);
     }
 
+    pthread_mutex_destroy(&conn->lock_send);
     free(conn);
 }
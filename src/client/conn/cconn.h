@@ -5,15 +5,34 @@
 /*** includes ***/
 
 #include <netdb.h>
+#include <pthread.h>
 #include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 #include "../conf/cconf.h"
 
+#include "../../net/rtt/rtt.h"
+#include "../../packet/packet.h"
+#include "../../packet/wire/wire.h"
+
 /*** data ***/
 
 typedef struct cconn {
     int sockfd;
     atomic_bool online;
+    uint32_t retry_after_ms;
+    uint32_t retry_jitter_ms;                   /* both 0 unless it turned us away */
+    atomic_int_least64_t heard;                 /* safe_time_ms of the last frame from the server */
+    uint64_t ping_nonce;                        /* the rest is guarded by the conn lock */
+    int64_t ping_sent;                          /* safe_time_us, 0 when no ping is in flight */
+    int64_t pinged;                             /* safe_time_ms of the last one, answered or not */
+    unsigned missed;                            /* pings sent since the server last said anything */
+    rtt_t rtt;
+    pthread_mutex_t lock_send;                  /* every thread sends, the v2 stream state is shared */
+    wire_caps_t caps;                           /* agreed in the HELO, v1's on every new socket until then */
+    bool offered;                               /* our HELO awaits the server's answer, nothing else is taken */
+    wire_stream_t wire;                         /* under the send lock as well */
 } cconn_t;
 
 
@@ -28,6 +47,18 @@ cconn_reconnect(cconn_t* conn, const cconf_t* config, const atomic_bool* retry,
 extern int
 cconn_get_socket(cconn_t* conn);
 
+extern int
+cconn_send(cconn_t* conn, const packet_t* packets, unsigned count);
+
+extern bool
+cconn_agree(cconn_t* conn, const char* usrname, const wire_caps_t* caps);
+
+extern void
+cconn_beat(cconn_t* conn, const char* usrname, pthread_cond_t* cond, pthread_mutex_t* mutex);
+
+extern bool
+cconn_pong(cconn_t* conn, const packet_view_t* pong);
+
 extern void
 cconn_shutdown(cconn_t* conn, int flag);
 
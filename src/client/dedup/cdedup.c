@@ -0,0 +1,77 @@
+#include "cdedup.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../error/error.h"
+
+
+/*** aux ***/
+
+static bool
+cdedup_contains(const cdedup_t* dedup, packet_str_t usrname, uint64_t nonce) {
+    for (unsigned i = 0; i < dedup->len; ++i) { /* newest first, overlaps are recent */
+        const cdedup_id_t* id = &dedup->ids[(dedup->head + CDEDUP_SIZE - 1 - i) % CDEDUP_SIZE];
+
+        if (id->nonce == nonce && packet_str_eq(usrname, id->usrname)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/*** methods ***/
+
+void
+cdedup_init(cdedup_t** dedup) {
+    *dedup = calloc(1, sizeof(cdedup_t));
+
+    if (*dedup == NULL) {
+        error_shutdown("dedup err: calloc");
+    }
+}
+
+void
+cdedup_free(cdedup_t* dedup) {
+    free(dedup);
+}
+
+bool
+cdedup_mark(cdedup_t* dedup, const packet_view_t* view) {
+    if (!(view->flags & (PACKET_FLAG_MSG | PACKET_FLAG_WHSP))) {
+        return true;                            /* notices are not replayed */
+    }
+
+    if (cdedup_contains(dedup, view->usrname, view->nonce)) {
+        return false;
+    }
+
+    cdedup_id_t* id = &dedup->ids[dedup->head];
+
+    packet_str_copy(view->usrname, id->usrname);
+    id->nonce = view->nonce;
+
+    dedup->head = (dedup->head + 1) % CDEDUP_SIZE;
+    dedup->len += dedup->len < CDEDUP_SIZE;
+
+    if (view->flags & PACKET_FLAG_MSG) {        /* whispers are not in the room history */
+        dedup->last = *id;
+        dedup->positioned = true;
+    }
+
+    return true;
+}
+
+bool
+cdedup_position(const cdedup_t* dedup, char* usrname, uint64_t* nonce) {
+    if (!dedup->positioned) {
+        return false;
+    }
+
+    memcpy(usrname, dedup->last.usrname, sizeof(dedup->last.usrname));
+    *nonce = dedup->last.nonce;
+
+    return true;
+}
@@ -0,0 +1,44 @@
+#if !defined(CDEDUP_H)
+#define CDEDUP_H
+
+/*** includes ***/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../../packet/packet.h"
+
+/*** data ***/
+
+#define CDEDUP_SIZE 1024                        /* more than a catch-up can overlap with */
+
+typedef struct cdedup_id {
+    char usrname[SIZE_USRNAME + 1];
+    uint64_t nonce;
+} cdedup_id_t;
+
+/* messages already rendered, so a replay after a reconnect shows each of them once */
+typedef struct cdedup {
+    cdedup_id_t ids[CDEDUP_SIZE];               /* ring, the oldest is overwritten */
+    unsigned head;
+    unsigned len;
+    cdedup_id_t last;                           /* the newest message, where a catch-up resumes */
+    bool positioned;
+} cdedup_t;
+
+
+/*** methods ***/
+
+extern void
+cdedup_init(cdedup_t** dedup);
+
+extern void
+cdedup_free(cdedup_t* dedup);
+
+extern bool
+cdedup_mark(cdedup_t* dedup, const packet_view_t* view);
+
+extern bool
+cdedup_position(const cdedup_t* dedup, char* usrname, uint64_t* nonce);
+
+#endif /* !defined(CDEDUP_H) */
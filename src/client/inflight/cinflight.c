@@ -0,0 +1,81 @@
+#include "cinflight.h"
+
+#include <stdlib.h>
+
+#include "../../error/error.h"
+
+
+/*** aux ***/
+
+static packet_t*
+cinflight_at(cinflight_t* inflight, unsigned idx) {
+    return &inflight->packets[(inflight->head + idx) % CINFLIGHT_SIZE];
+}
+
+
+/*** methods ***/
+
+void
+cinflight_init(cinflight_t** inflight) {
+    *inflight = calloc(1, sizeof(cinflight_t));
+
+    if (*inflight == NULL) {
+        error_shutdown("inflight err: calloc");
+    }
+}
+
+void
+cinflight_free(cinflight_t* inflight) {
+    free(inflight);
+}
+
+bool
+cinflight_track(cinflight_t* inflight, const packet_t* packet) {
+    bool evicted = inflight->len == CINFLIGHT_SIZE;
+
+    if (evicted) {                              /* the oldest stays unconfirmed for good */
+        inflight->head = (inflight->head + 1) % CINFLIGHT_SIZE;
+        inflight->len -= 1;
+    }
+
+    *cinflight_at(inflight, inflight->len) = *packet;
+    inflight->len += 1;
+
+    return !evicted;
+}
+
+unsigned
+cinflight_ack(cinflight_t* inflight, const packet_ack_t* ack) {
+    unsigned kept = 0;
+
+    for (unsigned i = 0; i < inflight->len; ++i) {  /* in order, so usually a prefix, but a refused one stays */
+        packet_t* packet = cinflight_at(inflight, i);
+
+        if (packet->nonce - ack->first < ack->count) {
+            continue;
+        }
+
+        if (kept != i) {
+            *cinflight_at(inflight, kept) = *packet;
+        }
+
+        kept += 1;
+    }
+
+    unsigned acked = inflight->len - kept;
+
+    inflight->len = kept;
+
+    return acked;
+}
+
+unsigned
+cinflight_pending(const cinflight_t* inflight, packet_t* packets, unsigned max) {
+    unsigned count = inflight->len < max ? inflight->len : max;
+
+    for (unsigned i = 0; i < count; ++i) {
+        packets[i] = inflight->packets[(inflight->head + i) % CINFLIGHT_SIZE];
+    }
+
+    return count;
+}
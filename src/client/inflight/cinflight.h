@@ -0,0 +1,40 @@
+#if !defined(CINFLIGHT_H)
+#define CINFLIGHT_H
+
+/*** includes ***/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../../packet/packet.h"
+
+/*** data ***/
+
+#define CINFLIGHT_SIZE 64                       /* unacked messages kept for a resend, older ones are given up */
+
+/* messages sent but not acknowledged yet, oldest first, resent as they were after a reconnect */
+typedef struct cinflight {
+    packet_t packets[CINFLIGHT_SIZE];           /* ring */
+    unsigned head;
+    unsigned len;
+} cinflight_t;
+
+
+/*** methods ***/
+
+extern void
+cinflight_init(cinflight_t** inflight);
+
+extern void
+cinflight_free(cinflight_t* inflight);
+
+extern bool
+cinflight_track(cinflight_t* inflight, const packet_t* packet);
+
+extern unsigned
+cinflight_ack(cinflight_t* inflight, const packet_ack_t* ack);
+
+extern unsigned
+cinflight_pending(const cinflight_t* inflight, packet_t* packets, unsigned max);
+
+#endif /* !defined(CINFLIGHT_H) */
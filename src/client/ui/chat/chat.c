@@ -237,7 +237,7 @@ chat_update(chat_t* chat, const chat_layout_t* lyt) {
 }
 
 void
-chat_enqueue(chat_t* chat, const packet_t *packet, const chat_layout_t* lyt){
+chat_enqueue(chat_t* chat, const packet_view_t* view, bool pending, const chat_layout_t* lyt){
     chat_hist_t* hist = &chat->hist;
 
     hist->head = chat_prev_pos(hist->head);
@@ -248,7 +248,8 @@ chat_enqueue(chat_t* chat, const packet_t *packet, const chat_layout_t* lyt){
 
     chat_msg_t* new = &hist->buf[hist->head];
 
-    chat_msg_build(new, packet);
+    chat_msg_build(new, view);
+    new->pending = pending;
 
     if (chat->bottom) {
         chat->scroll.chr_idx = new->header_blen + new->msg_blen;
@@ -259,6 +260,23 @@ chat_enqueue(chat_t* chat, const packet_t *packet, const chat_layout_t* lyt){
     }
 }
 
+bool
+chat_ack(chat_t* chat, const packet_ack_t* ack) {
+    chat_hist_t* hist = &chat->hist;
+    bool changed = false;
+
+    for (unsigned i = 0; i < hist->len; ++i) {
+        chat_msg_t* msg = &hist->buf[chat_relative_idx(chat, i)];
+
+        if (msg->pending && msg->nonce - ack->first < ack->count) {
+            msg->pending = false;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
 unsigned
 chat_expl_up(const chat_t* chat, const chat_layout_t* lyt, chat_pos_t* bottom) {
     unsigned filled = 0;
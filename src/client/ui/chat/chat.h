@@ -32,7 +32,10 @@ extern void
 chat_free(chat_t* chat);
 
 extern void
-chat_enqueue(chat_t* chat, const packet_t* packet, const chat_layout_t* lyt);
+chat_enqueue(chat_t* chat, const packet_view_t* view, bool pending, const chat_layout_t* lyt);
+
+extern bool
+chat_ack(chat_t* chat, const packet_ack_t* ack);
 
 extern void
 chat_update(chat_t* chat, const chat_layout_t* lyt);
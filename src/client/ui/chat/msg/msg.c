@@ -13,6 +13,7 @@
 
 #define TIME_FORMAT "%H:%M"
 #define TIME_FORMAT_SIZE 5
+#define PRESENCE_MORE_SIZE 32                   /* ", " and " and <n> more" */
 
 typedef enum {
     MSG_STATUS_JOIN = 0,
@@ -32,11 +33,11 @@ static const uint8_t PALETTE[] = {
 };
 
 static uint8_t
-chat_usrname_color(const char* usrname) {
+chat_usrname_color(packet_str_t usrname) {
     unsigned hash = 0;
 
-    for (const char* chr = usrname; *chr != '\0'; ++chr) {
-        hash += (unsigned) *chr;
+    for (unsigned i = 0; i < usrname.len; ++i) {
+        hash += (unsigned) usrname.ptr[i];
     }
 
     srand(hash);
@@ -44,85 +45,157 @@ chat_usrname_color(const char* usrname) {
     return PALETTE[(size_t)rand() % sizeof(PALETTE)];
 }
 
+static unsigned
+chat_msg_ulen(const char* body, unsigned blen) {
+    unsigned ulen = 0;
+
+    for (unsigned i = 0; i < blen; ++ulen) {
+        i += input_utf8_blen((uint8_t)body[i]);
+    }
+
+    return ulen;
+}
+
 
 /*** build type ***/
 
 static void
-chat_msg_build_default(chat_msg_t* msg, const packet_t* packet, const char* time) {
-    msg->msg_blen = (unsigned) strlen(packet->payld);
-
-    msg->msg_ulen = 0;
-    for (unsigned i = 0; i < msg->msg_blen; ++msg->msg_ulen) {
-        i += input_utf8_blen((uint8_t)packet->payld[i]);
-    }
+chat_msg_build_default(chat_msg_t* msg, const packet_view_t* view, const char* time) {
+    msg->msg_blen = view->payld.len;
+    msg->msg_ulen = chat_msg_ulen(view->payld.ptr, msg->msg_blen);
 
-    msg->header_blen = snprintf(msg->buf, sizeof(msg->buf), "\x1b[1;38;5;%dm%s %sat %s%s%s",
-            chat_usrname_color(packet->usrname), packet->usrname,
+    msg->header_blen = snprintf(msg->buf, sizeof(msg->buf), "\x1b[1;38;5;%dm%.*s %sat %s%s%s",
+            chat_usrname_color(view->usrname), (int)view->usrname.len, view->usrname.ptr,
             FONT_FORMAT(COLOR_DEFAULT, THIN),
             FONT_FORMAT(COLOR_LIGHT, BOLD), time, FONT_FORMAT(COLOR_DEFAULT, THIN));
 
-    memcpy(msg->buf + msg->header_blen, packet->payld, msg->msg_blen + 1);
+    packet_str_copy(view->payld, msg->buf + msg->header_blen);
 }
 
 static void
-chat_msg_build_whisper(chat_msg_t* msg, const packet_t* packet, const char* time) {
-    msg->msg_blen = (unsigned) strlen(packet->payld);
+chat_msg_build_whisper(chat_msg_t* msg, const packet_view_t* view, const char* time) {
+    msg->msg_blen = view->payld.len;
+    msg->msg_ulen = chat_msg_ulen(view->payld.ptr, msg->msg_blen);
 
-    msg->msg_ulen = 0;
-    for (unsigned i = 0; i < msg->msg_blen; ++msg->msg_ulen) {
-        i += input_utf8_blen((uint8_t)packet->payld[i]);
-    }
-
-    msg->header_blen = snprintf(msg->buf, sizeof(msg->buf), "\x1b[1;38;5;%dm%s %swhispered%s at %s%s%s",
-            chat_usrname_color(packet->usrname), packet->usrname,
+    msg->header_blen = snprintf(msg->buf, sizeof(msg->buf), "\x1b[1;38;5;%dm%.*s %swhispered%s at %s%s%s",
+            chat_usrname_color(view->usrname), (int)view->usrname.len, view->usrname.ptr,
             FONT_FORMAT(COLOR_LIGHT, BOLD), FONT_FORMAT(COLOR_DEFAULT, THIN),
             FONT_FORMAT(COLOR_LIGHT, BOLD), time, FONT_FORMAT(COLOR_DEFAULT, THIN));
 
-    memcpy(msg->buf + msg->header_blen, packet->payld, msg->msg_blen + 1);
+    packet_str_copy(view->payld, msg->buf + msg->header_blen);
 }
 
 static void
-chat_msg_build_status(chat_msg_t* msg, const packet_t* packet, const char* time, msg_status_t st) {
+chat_msg_build_status(chat_msg_t* msg, packet_str_t usrname, const char* time, msg_status_t st) {
     msg->msg_blen = 0;
     msg->msg_ulen = 0;
 
-    msg->header_blen = snprintf(msg->buf, sizeof(msg->buf), "\x1b[1;38;5;%dm%s %s%s at %s%s",
-            chat_usrname_color(packet->usrname), packet->usrname,
+    msg->header_blen = snprintf(msg->buf, sizeof(msg->buf), "\x1b[1;38;5;%dm%.*s %s%s at %s%s",
+            chat_usrname_color(usrname), (int)usrname.len, usrname.ptr,
             FONT_FORMAT(COLOR_DEFAULT, THIN), msg_status_str[st],
             FONT_FORMAT(COLOR_LIGHT, BOLD), time);
 }
 
+static void
+chat_msg_build_presence(chat_msg_t* msg, const packet_view_t* view, const char* time) {
+    char payld[SIZE_PAYLD + 1];
+    char body[SIZE_PAYLD + 1] = {0};
+    unsigned long joined = 0;
+    unsigned long left = 0;
+    unsigned long listed = 0;
+    size_t used = 0;
+    int off = 0;
+
+    packet_str_copy(view->payld, payld);        /* terminated, for sscanf */
+
+    bool snapshot = sscanf(payld, "=%lu%n", &joined, &off) == 1;
+
+    if (!snapshot && sscanf(payld, "+%lu -%lu%n", &joined, &left, &off) != 2) {
+        error_log("msg err: malformed presence");
+        off = (int)strlen(payld);
+    }
+
+    const char* names = payld + off;            /* "\n" before every name */
+
+    if (!snapshot && joined + left == 1 && names[0] == '\n' && strchr(names + 1, '\n') == NULL) {
+        packet_str_t single = {
+            .ptr = names + 2,
+            .len = (unsigned)strnlen(names + 2, SIZE_USRNAME),
+        };
+
+        chat_msg_build_status(msg, single, time, joined ? MSG_STATUS_JOIN : MSG_STATUS_EXIT);
+
+        return;
+    }
+
+    for (const char* name = names; *name == '\n'; ++listed) {
+        size_t len = strcspn(name + 1, "\n");
+
+        if (used + len + PRESENCE_MORE_SIZE >= sizeof(body)) {
+            break;
+        }
+
+        used += (size_t)snprintf(body + used, sizeof(body) - used, "%s%.*s", listed > 0 ? ", " : "", (int)len, name + 1);
+        name += 1 + len;
+    }
+
+    if (listed < joined + left) {               /* the counts are exact, the names need not be */
+        snprintf(body + used, sizeof(body) - used, "%s%lu more", listed > 0 ? " and " : "", joined + left - listed);
+    }
+
+    msg->msg_blen = (unsigned) strlen(body);
+    msg->msg_ulen = chat_msg_ulen(body, msg->msg_blen);
+
+    if (snapshot) {
+        msg->header_blen = snprintf(msg->buf, sizeof(msg->buf), "%s%lu here %sat %s%s%s",
+                FONT_FORMAT(COLOR_LIGHT, BOLD), joined, FONT_FORMAT(COLOR_DEFAULT, THIN),
+                FONT_FORMAT(COLOR_LIGHT, BOLD), time, FONT_FORMAT(COLOR_DEFAULT, THIN));
+    } else {
+        msg->header_blen = snprintf(msg->buf, sizeof(msg->buf), "%s+%lu -%lu %sat %s%s%s",
+                FONT_FORMAT(COLOR_LIGHT, BOLD), joined, left, FONT_FORMAT(COLOR_DEFAULT, THIN),
+                FONT_FORMAT(COLOR_LIGHT, BOLD), time, FONT_FORMAT(COLOR_DEFAULT, THIN));
+    }
+
+    memcpy(msg->buf + msg->header_blen, body, msg->msg_blen + 1);
+}
+
 /*** build ***/
 
 void
-chat_msg_build(chat_msg_t* msg, const packet_t* packet) {
+chat_msg_build(chat_msg_t* msg, const packet_view_t* view) {
     char time[TIME_FORMAT_SIZE + 1];
 
     struct tm tm_info;
 
-    if (localtime_r((const time_t*)&packet->timestamp, &tm_info) == NULL) {
+    if (localtime_r((const time_t*)&view->timestamp, &tm_info) == NULL) {
         error_shutdown("chat msg err: localtime_r");
     }
 
     strftime(time, sizeof(time), TIME_FORMAT, &tm_info);
 
-    switch (packet->flags) {
+    msg->nonce = view->nonce;
+    msg->pending = false;
+
+    switch (view->flags) {
         case PACKET_FLAG_MSG:
-            chat_msg_build_default(msg, packet, time);
+            chat_msg_build_default(msg, view, time);
             break;
         case PACKET_FLAG_WHSP:
-            chat_msg_build_whisper(msg, packet, time);
+            chat_msg_build_whisper(msg, view, time);
             break;
         case PACKET_FLAG_JOIN:
-            chat_msg_build_status(msg, packet, time, MSG_STATUS_JOIN);
+            chat_msg_build_status(msg, view->usrname, time, MSG_STATUS_JOIN);
             break;
         case PACKET_FLAG_EXIT:
-            chat_msg_build_status(msg, packet, time, MSG_STATUS_EXIT);
+            chat_msg_build_status(msg, view->usrname, time, MSG_STATUS_EXIT);
             break;
         case PACKET_FLAG_DISC:
-            chat_msg_build_status(msg, packet, time, MSG_STATUS_DISC);
+            chat_msg_build_status(msg, view->usrname, time, MSG_STATUS_DISC);
+            break;
+        case PACKET_FLAG_ROST:
+            chat_msg_build_presence(msg, view, time);
             break;
         default:
-            error_shutdown("msg err: invalid packet flag (%u)", packet->flags);
+            error_shutdown("msg err: invalid packet flag (%u)", view->flags);
     }
 }
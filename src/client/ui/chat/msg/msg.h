@@ -2,6 +2,7 @@
 #define MSG_H 
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "../../../../packet/packet.h"
 
@@ -16,12 +17,14 @@ typedef struct {
     unsigned header_blen;
     unsigned msg_blen;
     unsigned msg_ulen;
+    uint64_t nonce;
+    bool pending;                               /* ours and not acknowledged by the server yet */
 } chat_msg_t;
 
 
 /*** build ***/
 
 void
-chat_msg_build(chat_msg_t* msg, const packet_t* packet);
+chat_msg_build(chat_msg_t* msg, const packet_view_t* view);
 
 #endif /* !defined(MSG_H) */
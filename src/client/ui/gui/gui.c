@@ -96,10 +96,16 @@ gui_draw_frame(printer_t* printer, const term_layout_t* lyt) {
 }
 
 void
-gui_draw_header(printer_t* printer, const term_layout_t* lyt, unsigned status_idx, int64_t tick) {
-    const char* status = CONN_STR[status_idx];
+gui_draw_header(printer_t* printer, const term_layout_t* lyt, unsigned status_idx, int64_t rtt_us, int64_t tick) {
+    char status[sizeof("online 99999.9ms")];
     const unsigned dots = status_idx == 0 ? 0 : (unsigned)(tick % 4);
 
+    if (status_idx == 0 && rtt_us >= 0 && rtt_us < 100000000) {  /* once the server answered a ping */
+        (void)snprintf(status, sizeof(status), "%s %.1fms", CONN_STR[status_idx], (double)rtt_us / 1000.0);
+    } else {
+        (void)snprintf(status, sizeof(status), "%s", CONN_STR[status_idx]);
+    }
+
     printer_append(printer, "\x1b[2;%dH%s%srooms\x1b[%dC%sstatus %s%s%.*s\x1b[2;%dH%sesc %shelp",
             SCREEN_PADDING + 1, CLEAR_RIGHT,
             FONT_FORMAT(COLOR_LIGHT, BOLD),
@@ -234,7 +240,8 @@ gui_draw_chat(printer_t* printer, const chat_t* chat, const chat_layout_t* chat_
             curr.msg_idx -= 1;
             curr.chr_idx = 0;
         } else if (curr.chr_idx == 0 && msg->header_blen != 0) {
-            printer_append(printer, "%s%.*s\n\r", CURSOR_RIGHT(SCREEN_PADDING), msg->header_blen, msg->buf);
+            printer_append(printer, "%s%.*s%s%s\n\r", CURSOR_RIGHT(SCREEN_PADDING), msg->header_blen, msg->buf,
+                    msg->pending ? FONT_FORMAT(COLOR_DARK, THIN) : "", msg->pending ? " sending" : "");
 
             msg_count += 1;
             curr.chr_idx += msg->header_blen;
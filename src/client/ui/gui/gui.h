@@ -33,7 +33,7 @@ extern void
 gui_draw_frame(printer_t* printer, const term_layout_t* lyt);
 
 extern void
-gui_draw_header(printer_t* printer, const term_layout_t* lyt, unsigned status_idx, int64_t tick);
+gui_draw_header(printer_t* printer, const term_layout_t* lyt, unsigned status_idx, int64_t rtt_us, int64_t tick);
 
 extern void
 gui_draw_help(printer_t* printer, const term_layout_t* lyt);
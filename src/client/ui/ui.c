@@ -55,6 +55,7 @@ typedef struct {
     ui_mode_t prev_mode;
     ui_mode_t curr_mode;
     ui_conn_t conn;
+    int64_t rtt_us;                             /* smoothed, -1 until the first pong */
 } ui_status_t; 
 
 typedef struct {
@@ -159,6 +160,7 @@ status_init(ui_status_t* st) {
         .prev_mode = MODE_ROOM,
         .curr_mode = MODE_ROOM,
         .conn      = CONN_ONLINE,
+        .rtt_us    = -1,
     };
 
     struct sigaction sa;
@@ -255,7 +257,7 @@ ui_refresh_room(ui_t* ui) {
     }
 
     if (FLAG_TEST_AND_CLEAR(EVENT_HEADER)) {
-        gui_draw_header(ui->printer, &lyt->term_lyt, ui->status.conn, ui->clock.tick);
+        gui_draw_header(ui->printer, &lyt->term_lyt, ui->status.conn, ui->status.rtt_us, ui->clock.tick);
     }
 
     if (FLAG_TEST_AND_CLEAR(EVENT_CHAT)) {
@@ -269,9 +271,7 @@ ui_refresh_room(ui_t* ui) {
     unsigned row = lyt->prompt_lyt.row;
     unsigned col = prompt_get_cursor_col(ui->prompt) + SCREEN_PADDING + 1;
 
-    if (ui->status.conn == CONN_ONLINE) {
-        gui_draw_cursor(ui->printer, row, col);
-    }
+    gui_draw_cursor(ui->printer, row, col);
 }
 
 
@@ -282,11 +282,6 @@ ui_handle_keypress_room(ui_t* ui, int key, char* msg_buf) {
     ui_layout_t* lyt = &ui->layout;
     ui_status_t* st = &ui->status;
 
-    // TODO remove this and manage unsent packets
-    if (st->conn != CONN_ONLINE) {
-        return SIGNAL_CONT;
-    }
-
     if (input_ctrlchr(key) || input_navchr(key)) {
         if (key == ESCAPE) {
             mode_change(st, MODE_HELP);
@@ -537,11 +532,24 @@ ui_handle_keypress(ui_t* ui, char* msg_buf) {
 }
 
 void
-ui_handle_msg(ui_t* ui, const packet_t *packet) {
-    chat_enqueue(ui->chat, packet, &ui->layout.chat_lyt);
+ui_handle_msg(ui_t* ui, const packet_view_t* view) {
+    chat_enqueue(ui->chat, view, false, &ui->layout.chat_lyt);
     FLAG_SET(EVENT_CHAT);
 }
 
+void
+ui_handle_sent(ui_t* ui, const packet_view_t* view) {
+    chat_enqueue(ui->chat, view, true, &ui->layout.chat_lyt);
+    FLAG_SET(EVENT_CHAT);
+}
+
+void
+ui_handle_ack(ui_t* ui, const packet_ack_t* ack) {
+    if (chat_ack(ui->chat, ack)) {
+        FLAG_SET(EVENT_CHAT);
+    }
+}
+
 void
 ui_toggle_conn(ui_t *ui) {
     ui_status_t* st = &ui->status;
@@ -551,3 +559,10 @@ ui_toggle_conn(ui_t *ui) {
 
     (void)FLAG_SET(EVENT_HEADER);
 }
+
+void
+ui_set_rtt(ui_t* ui, int64_t rtt_us) {
+    ui->status.rtt_us = rtt_us;
+
+    (void)FLAG_SET(EVENT_HEADER);
+}
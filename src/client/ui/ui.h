@@ -3,6 +3,7 @@
 #define UI_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "../../packet/packet.h"
 
@@ -33,9 +34,18 @@ extern ui_signal_t
 ui_handle_keypress(ui_t* ui, char* msg_buf);
 
 extern void
-ui_handle_msg(ui_t* ui, const packet_t* packet);
+ui_handle_msg(ui_t* ui, const packet_view_t* view);
+
+extern void
+ui_handle_sent(ui_t* ui, const packet_view_t* view);
+
+extern void
+ui_handle_ack(ui_t* ui, const packet_ack_t* ack);
 
 extern void
 ui_toggle_conn(ui_t* ui);
 
+extern void
+ui_set_rtt(ui_t* ui, int64_t rtt_us);
+
 #endif /* !defined(UI_H) */
@@ -0,0 +1,106 @@
+#include "siphash.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "../../syscall/syscall.h"
+
+/*** data ***/
+
+/* SipHash-2-4: keyed, so names picked by a client cannot be made to collide */
+
+#define SIPHASH_C_ROUNDS 2
+#define SIPHASH_D_ROUNDS 4
+
+#define SIPHASH_ROTL(value, bits) (((value) << (bits)) | ((value) >> (64 - (bits))))
+
+typedef struct {
+    uint64_t v0;
+    uint64_t v1;
+    uint64_t v2;
+    uint64_t v3;
+} siphash_state_t;
+
+
+/*** aux ***/
+
+static void
+siphash_round(siphash_state_t* s) {
+    s->v0 += s->v1;
+    s->v1 = SIPHASH_ROTL(s->v1, 13);
+    s->v1 ^= s->v0;
+    s->v0 = SIPHASH_ROTL(s->v0, 32);
+
+    s->v2 += s->v3;
+    s->v3 = SIPHASH_ROTL(s->v3, 16);
+    s->v3 ^= s->v2;
+
+    s->v0 += s->v3;
+    s->v3 = SIPHASH_ROTL(s->v3, 21);
+    s->v3 ^= s->v0;
+
+    s->v2 += s->v1;
+    s->v1 = SIPHASH_ROTL(s->v1, 17);
+    s->v1 ^= s->v2;
+    s->v2 = SIPHASH_ROTL(s->v2, 32);
+}
+
+static void
+siphash_compress(siphash_state_t* s, uint64_t word) {
+    s->v3 ^= word;
+
+    for (int i = 0; i < SIPHASH_C_ROUNDS; ++i) {
+        siphash_round(s);
+    }
+
+    s->v0 ^= word;
+}
+
+static uint64_t
+siphash_load(const char* data, size_t size) {
+    uint64_t word = 0;
+
+    for (size_t i = 0; i < size; ++i) {         /* little endian, whatever the host is */
+        word |= (uint64_t)(uint8_t)data[i] << (8 * i);
+    }
+
+    return word;
+}
+
+
+/*** generate ***/
+
+siphash_key_t
+siphash_key_random(void) {
+    return (siphash_key_t) {
+        .k0 = (uint64_t)safe_rand(),
+        .k1 = (uint64_t)safe_rand(),
+    };
+}
+
+uint64_t
+siphash_generate(const siphash_key_t* key, const char* data, size_t size) {
+    siphash_state_t s = {
+        .v0 = key->k0 ^ 0x736f6d6570736575ULL,
+        .v1 = key->k1 ^ 0x646f72616e646f6dULL,
+        .v2 = key->k0 ^ 0x6c7967656e657261ULL,
+        .v3 = key->k1 ^ 0x7465646279746573ULL,
+    };
+
+    size_t tail = size % sizeof(uint64_t);
+    const char* end = data + size - tail;
+
+    for (const char* block = data; block != end; block += sizeof(uint64_t)) {
+        siphash_compress(&s, siphash_load(block, sizeof(uint64_t)));
+    }
+
+    siphash_compress(&s, siphash_load(end, tail) | ((uint64_t)size << 56));
+
+    s.v2 ^= 0xff;
+
+    for (int i = 0; i < SIPHASH_D_ROUNDS; ++i) {
+        siphash_round(&s);
+    }
+
+    return s.v0 ^ s.v1 ^ s.v2 ^ s.v3;
+}
@@ -0,0 +1,22 @@
+#if !defined(SIPHASH_H)
+#define SIPHASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*** data ***/
+
+typedef struct siphash_key {
+    uint64_t k0;
+    uint64_t k1;
+} siphash_key_t;
+
+/*** generate ***/
+
+extern siphash_key_t
+siphash_key_random(void);
+
+extern uint64_t
+siphash_generate(const siphash_key_t* key, const char* data, size_t size);
+
+#endif /* !defined(SIPHASH_H) */
@@ -15,8 +15,8 @@ typedef enum role {
 #define MODE_CLIENT "join"
 #define MODE_SERVER "host"
 
-#define ARGC_CLIENT(argc) ((argc) == 4 || (argc) == 5)
-#define ARGC_SERVER(argc) ((argc) == 2)
+#define ARGC_CLIENT(argc) ((argc) >= 4 && (argc) <= 6)
+#define ARGC_SERVER(argc) ((argc) >= 2 && (argc) % 2 == 0)
 
 rooms_role_t
 get_role(int argc, const char** argv) {
@@ -30,7 +30,7 @@ get_role(int argc, const char** argv) {
         return ROLE_HOST;
     }
 
-    fprintf(stderr, "usage:\nrooms host\nrooms join <usrname> <ip>\n");
+    fprintf(stderr, "usage:\nrooms host [--port <port>] [--queue <frames>] [--overflow disconnect|drop-oldest|drop-new]\n           [--threads <n>] [--pin on|off] [--io poll|epoll|uring]\n           [--zerocopy on|off] [--checksum crc32|none]\n           [--history <frames>] [--history-bytes <bytes>]\n           [--presence-window <ms>] [--grace <secs>]\n           [--accept-rate <n/s>] [--max-conns <n>]\n           [--heartbeat <secs>] [--max-misses <pings>] [--stats <secs>]\n           [--log <dir>] [--log-sync none|every:<n>|interval:<ms>] [--log-segment <MiB>]\n           [--log-retain-mb <MiB>] [--log-retain-secs <secs>]\nrooms join <usrname> <ip> [port [room]]\n");
 
     exit(EXIT_FAILURE);
 }
@@ -38,5 +38,5 @@ get_role(int argc, const char** argv) {
 
 int
 main(int argc, const char** argv) {
-    return get_role(argc, argv) == ROLE_HOST ? server() : client(argv);
+    return get_role(argc, argv) == ROLE_HOST ? server(argv) : client(argv);
 }
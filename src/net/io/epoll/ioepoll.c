@@ -0,0 +1,191 @@
+#include "ioepoll.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "../../../error/error.h"
+
+
+/*** data ***/
+
+#define IOEPOLL_IN (EPOLLIN | EPOLLHUP | EPOLLRDHUP | EPOLLERR)
+
+typedef struct {
+    int epfd;
+    io_handle_t* ready;                         /* handles with readiness not yet served */
+    struct epoll_event events[IO_MAX_EVENTS];
+    uint8_t bufs[IO_MAX_EVENTS][IO_RECV_SIZE];
+} ioepoll_t;
+
+
+/*** aux ***/
+
+static void
+ioepoll_link(ioepoll_t* impl, io_handle_t* handle) {
+    handle->prev = NULL;
+    handle->next = impl->ready;
+
+    if (impl->ready != NULL) {
+        impl->ready->prev = handle;
+    }
+
+    impl->ready = handle;
+}
+
+static void
+ioepoll_unlink(ioepoll_t* impl, io_handle_t* handle) {
+    if (handle->prev != NULL) {
+        handle->prev->next = handle->next;
+    } else {
+        impl->ready = handle->next;
+    }
+
+    if (handle->next != NULL) {
+        handle->next->prev = handle->prev;
+    }
+
+    handle->prev = NULL;
+    handle->next = NULL;
+}
+
+
+/*** ops ***/
+
+static int
+ioepoll_init(io_t* io) {
+    ioepoll_t* impl = malloc(sizeof(ioepoll_t));
+
+    if (impl == NULL) {
+        error_shutdown("ioepoll err: malloc");
+    }
+
+    impl->epfd = epoll_create1(EPOLL_CLOEXEC);
+    impl->ready = NULL;
+
+    if (impl->epfd == -1) {
+        error_log("ioepoll err: epoll_create1");
+        free(impl);
+        return -1;
+    }
+
+    io->impl = impl;
+
+    return 0;
+}
+
+static void
+ioepoll_free(io_t* io) {
+    ioepoll_t* impl = io->impl;
+
+    close(impl->epfd);
+    free(impl);
+}
+
+static int
+ioepoll_add(io_t* io, io_handle_t* handle) {
+    ioepoll_t* impl = io->impl;
+    struct epoll_event ev = {
+        .events = EPOLLIN | EPOLLET,            /* edge triggered, every edge is drained by io_serve */
+        .data.ptr = handle,
+    };
+
+    if (handle->kind == IO_KIND_CONN) {         /* EPOLLOUT only fires once a full socket drains */
+        ev.events |= EPOLLOUT | EPOLLRDHUP;
+    }
+
+    if (epoll_ctl(impl->epfd, EPOLL_CTL_ADD, handle->fd, &ev) == -1) {
+        error_log("ioepoll err: epoll_ctl (fd = %d)", handle->fd);
+        return -1;
+    }
+
+    return 0;
+}
+
+static bool
+ioepoll_del(io_t* io, io_handle_t* handle) {
+    ioepoll_t* impl = io->impl;
+
+    if (epoll_ctl(impl->epfd, EPOLL_CTL_DEL, handle->fd, NULL) == -1) {
+        error_log("ioepoll err: epoll_ctl del (fd = %d)", handle->fd);
+    }
+
+    if (handle->ready != 0) {
+        ioepoll_unlink(impl, handle);
+    }
+
+    return true;
+}
+
+static ssize_t
+ioepoll_send(io_t* io, io_handle_t* handle, struct iovec* iov, int iovcnt, bool* zerocopy) {
+    (void)io;
+
+    return io_send_ready(handle, iov, iovcnt, zerocopy);
+}
+
+static int
+ioepoll_wait(io_t* io, io_event_t* events, int max_events, int timeout_ms) {
+    ioepoll_t* impl = io->impl;
+    int count = epoll_wait(impl->epfd, impl->events, IO_MAX_EVENTS, impl->ready != NULL ? 0 : timeout_ms);
+
+    if (count == -1) {
+        if (errno != EINTR) {
+            error_log("ioepoll err: epoll_wait");
+            return -1;
+        }
+
+        count = 0;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        io_handle_t* handle = impl->events[i].data.ptr;
+        unsigned ready = 0;
+
+        ready |= impl->events[i].events & IOEPOLL_IN ? IO_READY_IN : 0;
+        ready |= impl->events[i].events & EPOLLOUT ? IO_READY_OUT : 0;
+        ready |= impl->events[i].events & EPOLLERR ? IO_READY_ERR : 0;
+
+        if (handle->ready == 0 && ready != 0) {
+            ioepoll_link(impl, handle);
+        }
+
+        handle->ready |= ready;
+    }
+
+    int served = 0;
+
+    /* one event per handle and pass, so a busy socket cannot starve the rest */
+    while (impl->ready != NULL && served < max_events) {
+        io_handle_t* next = NULL;
+
+        for (io_handle_t* handle = impl->ready; handle != NULL && served < max_events; handle = next) {
+            next = handle->next;
+
+            if (io_serve(handle, impl->bufs[served], &events[served])) {
+                served += 1;
+            }
+
+            if (handle->ready == 0) {
+                ioepoll_unlink(impl, handle);
+            }
+        }
+    }
+
+    return served;
+}
+
+
+/*** data ***/
+
+const io_ops_t ioepoll_ops = {
+    .name = "epoll",
+    .zerocopy = true,
+    .init = ioepoll_init,
+    .free = ioepoll_free,
+    .add  = ioepoll_add,
+    .del  = ioepoll_del,
+    .send = ioepoll_send,
+    .wait = ioepoll_wait,
+};
@@ -0,0 +1,10 @@
+#if !defined(IOEPOLL_H)
+#define IOEPOLL_H
+
+#include "../iobackend.h"
+
+/*** data ***/
+
+extern const io_ops_t ioepoll_ops;
+
+#endif /* !defined(IOEPOLL_H) */
@@ -0,0 +1,430 @@
+#define _GNU_SOURCE                             /* accept4 */
+
+#include "io.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+
+#include "iobackend.h"
+#include "epoll/ioepoll.h"
+#include "poll/iopoll.h"
+#include "uring/iouring.h"
+
+#include "../net.h"
+#include "../../error/error.h"
+
+
+/*** data ***/
+
+#define IO_ERRQUEUE_CONTROL 128                 /* sock_extended_err plus the offender address */
+
+static const io_ops_t* const io_backends[] = {
+    [IO_BACKEND_POLL]  = &iopoll_ops,
+    [IO_BACKEND_EPOLL] = &ioepoll_ops,
+    [IO_BACKEND_URING] = &iouring_ops,
+};
+
+/* what to try next when a backend is missing from the running kernel */
+static const io_backend_t io_fallback[] = {
+    [IO_BACKEND_POLL]  = IO_BACKEND_POLL,
+    [IO_BACKEND_EPOLL] = IO_BACKEND_POLL,
+    [IO_BACKEND_URING] = IO_BACKEND_EPOLL,
+};
+
+
+/*** aux ***/
+
+static io_handle_t*
+io_add(io_t* io, io_kind_t kind, int fd, void* data) {
+    io_handle_t* handle = calloc(1, sizeof(io_handle_t));
+
+    if (handle == NULL) {
+        error_shutdown("io err: calloc");
+    }
+
+    handle->kind = kind;
+    handle->fd = fd;
+    handle->data = data;
+
+    if (io->ops->add(io, handle) == -1) {
+        free(handle);
+        return NULL;
+    }
+
+    return handle;
+}
+
+static bool
+io_serve_accept(io_handle_t* handle, io_event_t* event) {
+    while (true) {
+        int sockfd = accept4(handle->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (sockfd != -1) {
+            event->type = IO_EV_ACCEPT;
+            event->fd = sockfd;
+            return true;
+        }
+
+        if (errno == EINTR || errno == ECONNABORTED) {
+            continue;
+        }
+
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            error_log("io err: accept4 (fd = %d)", handle->fd);
+        }
+
+        handle->ready &= ~IO_READY_IN;
+        return false;
+    }
+}
+
+static bool
+io_serve_recv(io_handle_t* handle, uint8_t* buf, io_event_t* event) {
+    while (true) {
+        ssize_t nbytes = recv(handle->fd, buf, IO_RECV_SIZE, 0);
+
+        if (nbytes > 0) {
+            if (nbytes < IO_RECV_SIZE) {        /* a short read means the socket is dry */
+                handle->ready &= ~IO_READY_IN;
+            }
+
+            event->type = IO_EV_RECV;
+            event->buf = buf;
+            event->len = (size_t)nbytes;
+            return true;
+        }
+
+        if (nbytes == -1 && errno == EINTR) {
+            continue;
+        }
+
+        handle->ready &= ~IO_READY_IN;
+
+        if (nbytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return false;
+        }
+
+        event->type = IO_EV_HUP;
+        event->res = nbytes == 0 ? 0 : -errno;
+        return true;
+    }
+}
+
+static unsigned
+io_zerocopy_mark(io_handle_t* handle, uint32_t lo, uint32_t hi) {
+    for (uint32_t id = lo; id - lo <= hi - lo; ++id) {  /* ranges may be squashed or out of order */
+        uint32_t bit = id - handle->zc_done;
+
+        if (bit < IO_ZEROCOPY_WINDOW) {
+            handle->zc_early |= (uint64_t)1 << bit;
+        }
+    }
+
+    unsigned done = 0;
+
+    while (handle->zc_early & 1) {              /* only report a contiguous prefix */
+        handle->zc_early >>= 1;
+        handle->zc_done += 1;
+        done += 1;
+    }
+
+    return done;
+}
+
+static bool
+io_serve_errqueue(io_handle_t* handle, io_event_t* event) {
+    unsigned done = 0;
+
+    while (true) {
+        uint8_t control[IO_ERRQUEUE_CONTROL];
+        struct msghdr msg = {
+            .msg_control = control,
+            .msg_controllen = sizeof(control),
+        };
+
+        if (recvmsg(handle->fd, &msg, MSG_ERRQUEUE) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            break;                              /* drained, a real socket error shows up on recv */
+        }
+
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            bool v4 = cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR;
+            bool v6 = cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR;
+            struct sock_extended_err err;
+
+            if (!v4 && !v6) {
+                continue;
+            }
+
+            memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+
+            if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+
+            if (err.ee_code == SO_EE_CODE_ZEROCOPY_COPIED) {   /* loopback and friends copy anyway */
+                handle->zerocopy = false;
+            }
+
+            done += io_zerocopy_mark(handle, err.ee_info, err.ee_data);
+        }
+    }
+
+    if (done == 0) {
+        return false;
+    }
+
+    event->type = IO_EV_ZEROCOPY;
+    event->res = (int)done;
+
+    return true;
+}
+
+static ssize_t
+io_sendmsg(int fd, struct iovec* iov, int iovcnt, int flags) {
+    struct msghdr msg = {
+        .msg_iov = iov,
+        .msg_iovlen = (size_t)iovcnt,
+    };
+
+    ssize_t n;
+
+    do {
+        n = sendmsg(fd, &msg, MSG_NOSIGNAL | flags);
+    } while (n == -1 && errno == EINTR);
+
+    return n;
+}
+
+
+/*** handles ***/
+
+void
+io_handle_free(io_handle_t* handle) {
+    free(handle->msgs);
+    free(handle);
+}
+
+
+/*** readiness ***/
+
+bool
+io_serve(io_handle_t* handle, uint8_t* buf, io_event_t* event) {
+    *event = (io_event_t) {
+        .data = handle->data,
+        .fd = -1,
+    };
+
+    if (handle->ready & IO_READY_ERR) {         /* hand pinned buffers back before anything else */
+        handle->ready &= ~IO_READY_ERR;
+
+        if (handle->kind == IO_KIND_CONN && handle->zc_next != handle->zc_done
+                && io_serve_errqueue(handle, event)) {
+            return true;
+        }
+    }
+
+    if (handle->ready & IO_READY_OUT) {
+        handle->ready &= ~IO_READY_OUT;
+        event->type = IO_EV_WRITABLE;
+        return true;
+    }
+
+    if (!(handle->ready & IO_READY_IN)) {
+        return false;
+    }
+
+    switch (handle->kind) {
+        case IO_KIND_LISTEN:
+            return io_serve_accept(handle, event);
+        case IO_KIND_CONN:
+            return io_serve_recv(handle, buf, event);
+        case IO_KIND_WAKE:
+            handle->ready &= ~IO_READY_IN;
+            event->type = IO_EV_WAKE;
+            return true;
+    }
+
+    return false;
+}
+
+ssize_t
+io_send_ready(io_handle_t* handle, struct iovec* iov, int iovcnt, bool* zerocopy) {
+    ssize_t sent = 0;
+    bool want = *zerocopy;
+
+    *zerocopy = false;
+
+    while (iovcnt > 0) {
+        int count = iovcnt < IO_IOV_MAX ? iovcnt : IO_IOV_MAX;
+        size_t total = 0;
+
+        for (int i = 0; i < count; ++i) {
+            total += iov[i].iov_len;
+        }
+
+        /* one pinning send per call, so the caller can tell which bytes wait for IO_EV_ZEROCOPY */
+        bool pin = want && !*zerocopy && handle->zerocopy
+                && handle->zc_next - handle->zc_done < IO_ZEROCOPY_WINDOW;
+
+        ssize_t nbytes = io_sendmsg(handle->fd, iov, count, pin ? MSG_ZEROCOPY : 0);
+
+        if (nbytes == -1 && pin && errno == ENOBUFS) {  /* out of optmem for pinned pages, copy */
+            want = false;
+            continue;
+        }
+
+        if (nbytes == -1) {
+            return errno == EAGAIN || errno == EWOULDBLOCK ? sent : -1;
+        }
+
+        if (pin) {
+            handle->zc_next += 1;
+            *zerocopy = true;
+        }
+
+        sent += nbytes;
+
+        if (pin && (size_t)nbytes < total) {    /* out of pinnable memory midway, copy the rest */
+            struct iovec rest[IO_IOV_MAX];      /* advanced here, callers size what is left from their own */
+            struct iovec* at = rest;
+            int left = count;
+
+            memcpy(rest, iov, (size_t)count * sizeof(*rest));
+            iov_advance(&at, &left, (size_t)nbytes);
+
+            ssize_t more = io_sendmsg(handle->fd, at, left, 0);
+
+            if (more == -1) {
+                return errno == EAGAIN || errno == EWOULDBLOCK ? sent : -1;
+            }
+
+            sent += more;
+            nbytes += more;
+        }
+
+        if ((size_t)nbytes < total) {
+            break;
+        }
+
+        iov += count;
+        iovcnt -= count;
+    }
+
+    return sent;
+}
+
+
+/*** methods ***/
+
+void
+io_init(io_t** io, io_backend_t backend) {
+    *io = malloc(sizeof(io_t));
+
+    if (*io == NULL) {
+        error_shutdown("io err: malloc");
+    }
+
+    while (true) {
+        (*io)->ops = io_backends[backend];
+        (*io)->impl = NULL;
+
+        if ((*io)->ops->init(*io) == 0) {
+            return;
+        }
+
+        if (io_fallback[backend] == backend) {
+            error_shutdown("io err: no usable backend");
+        }
+
+        error_log("io err: %s unavailable, falling back to %s",
+                (*io)->ops->name, io_backends[io_fallback[backend]]->name);
+
+        backend = io_fallback[backend];
+    }
+}
+
+void
+io_free(io_t* io) {
+    io->ops->free(io);
+    free(io);
+}
+
+const char*
+io_get_name(const io_t* io) {
+    return io->ops->name;
+}
+
+io_handle_t*
+io_listen(io_t* io, int fd, void* data) {
+    return io_add(io, IO_KIND_LISTEN, fd, data);
+}
+
+io_handle_t*
+io_watch(io_t* io, int fd, void* data) {
+    return io_add(io, IO_KIND_CONN, fd, data);
+}
+
+io_handle_t*
+io_watch_wake(io_t* io, int fd, void* data) {
+    return io_add(io, IO_KIND_WAKE, fd, data);
+}
+
+int
+io_zerocopy(io_t* io, io_handle_t* handle) {
+    int on = 1;
+
+    if (!io->ops->zerocopy || handle->kind != IO_KIND_CONN) {
+        return -1;
+    }
+
+    if (setsockopt(handle->fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == -1) {
+        return -1;
+    }
+
+    handle->zerocopy = true;
+
+    return 0;
+}
+
+bool
+io_forget(io_t* io, io_handle_t* handle) {
+    handle->forgotten = true;
+
+    if (handle->zc_next != handle->zc_done) {   /* pages still pinned: reset rather than send stale bytes */
+        struct linger abort = {.l_onoff = 1, .l_linger = 0};
+
+        (void)setsockopt(handle->fd, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+    }
+
+    if (!io->ops->del(io, handle)) {            /* the backend frees it and reports IO_EV_RELEASED */
+        return false;
+    }
+
+    io_handle_free(handle);
+
+    return true;
+}
+
+ssize_t
+io_send(io_t* io, io_handle_t* handle, struct iovec* iov, int iovcnt, bool* zerocopy_nullable) {
+    bool zerocopy = false;
+
+    return io->ops->send(io, handle, iov, iovcnt, zerocopy_nullable != NULL ? zerocopy_nullable : &zerocopy);
+}
+
+int
+io_wait(io_t* io, io_event_t* events, int max_events, int timeout_ms) {
+    if (max_events > IO_MAX_EVENTS) {
+        max_events = IO_MAX_EVENTS;
+    }
+
+    return io->ops->wait(io, events, max_events, timeout_ms);
+}
@@ -0,0 +1,80 @@
+#if !defined(IO_H)
+#define IO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/*** data ***/
+
+#define IO_MAX_EVENTS 64
+#define IO_RECV_SIZE 4096
+#define IO_IOV_MAX 1024                         /* UIO_MAXIOV, io_send slices longer lists */
+#define IO_SEND_QUEUED (-2)                     /* iov and buffers stay put until IO_EV_SENT */
+#define IO_ZEROCOPY_WINDOW 64                   /* zero copy sends in flight per socket, then io_send copies */
+
+typedef enum {
+    IO_BACKEND_POLL,                            /* portable, scans every fd on each wait */
+    IO_BACKEND_EPOLL,                           /* edge triggered readiness */
+    IO_BACKEND_URING,                           /* completions, falls back to epoll */
+} io_backend_t;
+
+typedef enum {
+    IO_EV_ACCEPT,                               /* fd is a new non blocking socket */
+    IO_EV_RECV,                                 /* buf holds len bytes, valid until the next io_wait */
+    IO_EV_HUP,                                  /* peer closed (res = 0) or the socket failed (res = -errno) */
+    IO_EV_WRITABLE,                             /* a socket that blocked a send can take more */
+    IO_EV_SENT,                                 /* a queued send finished, res = bytes or -errno */
+    IO_EV_WAKE,                                 /* a watched eventfd was signalled */
+    IO_EV_RELEASED,                             /* a forgotten fd has nothing in flight anymore */
+    IO_EV_ZEROCOPY,                             /* the oldest res zero copy sends no longer pin their buffers */
+} io_ev_type_t;
+
+typedef struct {
+    io_ev_type_t type;
+    void* data;                                 /* as given when the fd was watched */
+    int fd;
+    int res;
+    const uint8_t* buf;
+    size_t len;
+} io_event_t;
+
+typedef struct io io_t;
+typedef struct io_handle io_handle_t;
+
+
+/*** methods ***/
+
+extern void
+io_init(io_t** io, io_backend_t backend);
+
+extern void
+io_free(io_t* io);
+
+extern const char*
+io_get_name(const io_t* io);
+
+extern io_handle_t*
+io_listen(io_t* io, int fd, void* data);
+
+extern io_handle_t*
+io_watch(io_t* io, int fd, void* data);
+
+extern io_handle_t*
+io_watch_wake(io_t* io, int fd, void* data);
+
+extern int
+io_zerocopy(io_t* io, io_handle_t* handle);
+
+extern bool
+io_forget(io_t* io, io_handle_t* handle);
+
+extern ssize_t
+io_send(io_t* io, io_handle_t* handle, struct iovec* iov, int iovcnt, bool* zerocopy_nullable);
+
+extern int
+io_wait(io_t* io, io_event_t* events, int max_events, int timeout_ms);
+
+#endif /* !defined(IO_H) */
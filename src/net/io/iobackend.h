@@ -0,0 +1,77 @@
+#if !defined(IOBACKEND_H)
+#define IOBACKEND_H
+
+/* shared by the backends only, the rest of the tree goes through io.h */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "io.h"
+
+/*** data ***/
+
+typedef enum {
+    IO_KIND_LISTEN,
+    IO_KIND_CONN,
+    IO_KIND_WAKE,
+} io_kind_t;
+
+typedef enum {
+    IO_READY_IN  = 1 << 0,
+    IO_READY_OUT = 1 << 1,
+    IO_READY_ERR = 1 << 2,                      /* the error queue may hold zero copy completions */
+} io_ready_t;
+
+struct io_handle {
+    io_kind_t kind;
+    int fd;
+    void* data;
+    bool forgotten;                             /* released by the caller, events are swallowed */
+    bool zerocopy;                              /* SO_ZEROCOPY is on and the route really pins pages */
+    uint32_t zc_next;                           /* kernel id of the next zero copy send */
+    uint32_t zc_done;                           /* every id below this one completed */
+    uint64_t zc_early;                          /* completions past zc_done, bit i is zc_done + i */
+    unsigned ready;                             /* readiness not yet turned into events */
+    size_t idx;                                 /* poll: slot in the pollfd array */
+    unsigned pending;                           /* uring: operations in flight */
+    size_t sending;                             /* uring: bytes in the linked send chain */
+    struct msghdr* msgs;                        /* uring: one per send in the chain */
+    unsigned msgs_size;
+    struct io_handle* prev;                     /* epoll ready list, uring rearm list */
+    struct io_handle* next;
+};
+
+typedef struct io_ops {
+    const char* name;
+    bool zerocopy;                              /* sends are plain sendmsg, errors are watched */
+    int (*init)(io_t* io);                      /* -1 when the kernel lacks the backend */
+    void (*free)(io_t* io);
+    int (*add)(io_t* io, io_handle_t* handle);
+    bool (*del)(io_t* io, io_handle_t* handle); /* true once nothing references the handle */
+    ssize_t (*send)(io_t* io, io_handle_t* handle, struct iovec* iov, int iovcnt, bool* zerocopy);
+    int (*wait)(io_t* io, io_event_t* events, int max_events, int timeout_ms);
+} io_ops_t;
+
+struct io {
+    const io_ops_t* ops;
+    void* impl;
+};
+
+
+/*** handles ***/
+
+extern void
+io_handle_free(io_handle_t* handle);
+
+
+/*** readiness ***/
+
+extern bool
+io_serve(io_handle_t* handle, uint8_t* buf, io_event_t* event);
+
+extern ssize_t
+io_send_ready(io_handle_t* handle, struct iovec* iov, int iovcnt, bool* zerocopy);
+
+#endif /* !defined(IOBACKEND_H) */
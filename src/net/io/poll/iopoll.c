@@ -0,0 +1,183 @@
+#include "iopoll.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+
+#include "../../../error/error.h"
+
+
+/*** data ***/
+
+#define INIT_FDS_SIZE 16
+#define IOPOLL_IN (POLLIN | POLLHUP | POLLERR | POLLNVAL)
+
+typedef struct {
+    struct pollfd* fds;
+    io_handle_t** handles;                      /* parallel to fds */
+    size_t len;
+    size_t size;
+    size_t start;                               /* rotates so low slots cannot starve the rest */
+    uint8_t bufs[IO_MAX_EVENTS][IO_RECV_SIZE];
+} iopoll_t;
+
+
+/*** aux ***/
+
+static void
+iopoll_grow(iopoll_t* impl) {
+    size_t size = impl->size == 0 ? INIT_FDS_SIZE : impl->size * 2;
+
+    impl->fds = realloc(impl->fds, sizeof(struct pollfd) * size);
+    impl->handles = realloc(impl->handles, sizeof(io_handle_t*) * size);
+
+    if (impl->fds == NULL || impl->handles == NULL) {
+        error_shutdown("iopoll err: realloc");
+    }
+
+    impl->size = size;
+}
+
+
+/*** ops ***/
+
+static int
+iopoll_init(io_t* io) {
+    iopoll_t* impl = malloc(sizeof(iopoll_t));
+
+    if (impl == NULL) {
+        error_shutdown("iopoll err: malloc");
+    }
+
+    impl->fds = NULL;
+    impl->handles = NULL;
+    impl->len = 0;
+    impl->size = 0;
+    impl->start = 0;
+
+    io->impl = impl;
+
+    return 0;
+}
+
+static void
+iopoll_free(io_t* io) {
+    iopoll_t* impl = io->impl;
+
+    free(impl->fds);
+    free(impl->handles);
+    free(impl);
+}
+
+static int
+iopoll_add(io_t* io, io_handle_t* handle) {
+    iopoll_t* impl = io->impl;
+
+    if (impl->len == impl->size) {
+        iopoll_grow(impl);
+    }
+
+    impl->fds[impl->len] = (struct pollfd) {
+        .fd = handle->fd,
+        .events = POLLIN,                       /* POLLOUT only while a send is blocked */
+        .revents = 0,
+    };
+
+    impl->handles[impl->len] = handle;
+    handle->idx = impl->len++;
+
+    return 0;
+}
+
+static bool
+iopoll_del(io_t* io, io_handle_t* handle) {
+    iopoll_t* impl = io->impl;
+    size_t last = --impl->len;
+
+    impl->fds[handle->idx] = impl->fds[last];
+    impl->handles[handle->idx] = impl->handles[last];
+    impl->handles[handle->idx]->idx = handle->idx;
+
+    return true;
+}
+
+static ssize_t
+iopoll_send(io_t* io, io_handle_t* handle, struct iovec* iov, int iovcnt, bool* zerocopy) {
+    iopoll_t* impl = io->impl;
+    size_t total = 0;
+
+    for (int i = 0; i < iovcnt; ++i) {
+        total += iov[i].iov_len;
+    }
+
+    ssize_t nbytes = io_send_ready(handle, iov, iovcnt, zerocopy);
+
+    if (nbytes >= 0 && (size_t)nbytes < total) {
+        impl->fds[handle->idx].events |= POLLOUT;
+    }
+
+    return nbytes;
+}
+
+static int
+iopoll_wait(io_t* io, io_event_t* events, int max_events, int timeout_ms) {
+    iopoll_t* impl = io->impl;
+    int count = poll(impl->fds, impl->len, timeout_ms);
+
+    if (count == -1) {
+        if (errno == EINTR) {
+            return 0;
+        }
+
+        error_log("iopoll err: poll");
+        return -1;
+    }
+
+    int served = 0;
+    size_t len = impl->len;
+
+    for (size_t k = 0; k < len && count > 0 && served < max_events; ++k) {
+        size_t i = (impl->start + k) % len;
+        struct pollfd* pfd = &impl->fds[i];
+        io_handle_t* handle = impl->handles[i];
+
+        if (pfd->revents == 0) {
+            continue;
+        }
+
+        count -= 1;
+
+        handle->ready = 0;
+        handle->ready |= pfd->revents & IOPOLL_IN ? IO_READY_IN : 0;
+        handle->ready |= pfd->revents & POLLOUT ? IO_READY_OUT : 0;
+        handle->ready |= pfd->revents & POLLERR ? IO_READY_ERR : 0;
+
+        if (pfd->revents & POLLOUT) {
+            pfd->events &= ~POLLOUT;
+        }
+
+        while (served < max_events && io_serve(handle, impl->bufs[served], &events[served])) {
+            served += 1;
+        }
+
+        handle->ready = 0;                      /* level triggered, whatever is left shows up again */
+    }
+
+    impl->start = len > 0 ? (impl->start + 1) % len : 0;
+
+    return served;
+}
+
+
+/*** data ***/
+
+const io_ops_t iopoll_ops = {
+    .name = "poll",
+    .zerocopy = true,
+    .init = iopoll_init,
+    .free = iopoll_free,
+    .add  = iopoll_add,
+    .del  = iopoll_del,
+    .send = iopoll_send,
+    .wait = iopoll_wait,
+};
@@ -0,0 +1,10 @@
+#if !defined(IOPOLL_H)
+#define IOPOLL_H
+
+#include "../iobackend.h"
+
+/*** data ***/
+
+extern const io_ops_t iopoll_ops;
+
+#endif /* !defined(IOPOLL_H) */
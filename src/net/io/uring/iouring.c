@@ -0,0 +1,655 @@
+#include "iouring.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include "../../net.h"
+#include "../../../error/error.h"
+
+
+/*** data ***/
+
+#define IOURING_ENTRIES 256
+#define IOURING_CQ_ENTRIES 4096
+#define IOURING_BUFS 128                        /* provided buffers, a power of two */
+#define IOURING_BUF_SIZE 1024                   /* small, so read ahead stays within what fan-out can queue */
+#define IOURING_BGID 0
+#define IOURING_PROBE_OPS 256
+#define IOURING_MSG_IOV IO_IOV_MAX
+
+#define IOURING_MIN_MAJOR 6                     /* multishot recv landed in 6.0, the rest is older */
+
+#define IOURING_SETUP_FAST (IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN \
+        | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN)
+#define IOURING_FEATURES (IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG \
+        | IORING_FEAT_CQE_SKIP)
+
+/* tag in the low bits of user_data, handles come from calloc so they are 8 byte aligned */
+typedef enum {
+    IOURING_OP_ACCEPT,
+    IOURING_OP_RECV,
+    IOURING_OP_WAKE,
+    IOURING_OP_SEND,                            /* inside a chain, only posts on failure */
+    IOURING_OP_SEND_LAST,                       /* closes a chain, always posts */
+    IOURING_OP_CANCEL,
+} iouring_op_t;
+
+#define IOURING_OP_MASK 7u
+
+static const uint8_t iouring_required_ops[] = {
+    IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SENDMSG, IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL,
+};
+
+typedef struct {
+    int fd;
+    void* ring;                                 /* sq and cq share one mapping */
+    size_t ring_size;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sq_local;                          /* tail including sqes not yet published */
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+    struct io_uring_buf_ring* br;               /* provided buffers the kernel picks from */
+    size_t br_size;
+    uint16_t br_tail;
+    uint8_t* bufs;
+    uint16_t recycle[IOURING_BUFS];             /* buffers handed out in the last batch */
+    unsigned recycle_len;
+    io_handle_t* rearm;                         /* multishot requests that ended early */
+} iouring_t;
+
+
+/*** aux ***/
+
+static int
+iouring_setup(unsigned entries, struct io_uring_params* params) {
+    return (int)syscall(SYS_io_uring_setup, entries, params);
+}
+
+static int
+iouring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return (int)syscall(SYS_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static bool
+iouring_kernel_ok(void) {
+    struct utsname uts;
+    unsigned major = 0;
+
+    if (uname(&uts) == -1 || sscanf(uts.release, "%u.", &major) != 1) {
+        return false;
+    }
+
+    return major >= IOURING_MIN_MAJOR;
+}
+
+static bool
+iouring_probe(int fd) {
+    struct io_uring_probe* probe = calloc(1, sizeof(struct io_uring_probe)
+            + IOURING_PROBE_OPS * sizeof(struct io_uring_probe_op));
+
+    if (probe == NULL) {
+        error_shutdown("iouring err: calloc");
+    }
+
+    bool ok = iouring_register(fd, IORING_REGISTER_PROBE, probe, IOURING_PROBE_OPS) == 0;
+
+    for (size_t i = 0; ok && i < sizeof(iouring_required_ops); ++i) {
+        uint8_t op = iouring_required_ops[i];
+
+        ok = op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    free(probe);
+
+    return ok;
+}
+
+static int
+iouring_enter(iouring_t* impl, unsigned min_complete, unsigned flags, const void* arg, size_t argsz) {
+    unsigned submit = impl->sq_local - __atomic_load_n(impl->sq_head, __ATOMIC_ACQUIRE);
+
+    __atomic_store_n(impl->sq_tail, impl->sq_local, __ATOMIC_RELEASE);
+
+    int rv = (int)syscall(SYS_io_uring_enter, impl->fd, submit, min_complete, flags, arg, argsz);
+
+    return rv == -1 ? -errno : rv;
+}
+
+static unsigned
+iouring_space(const iouring_t* impl) {
+    return impl->sq_entries - (impl->sq_local - __atomic_load_n(impl->sq_head, __ATOMIC_ACQUIRE));
+}
+
+static struct io_uring_sqe*
+iouring_sqe(iouring_t* impl, io_handle_t* handle, iouring_op_t op) {
+    if (iouring_space(impl) == 0) {             /* without SQPOLL the kernel takes every sqe at once */
+        (void)iouring_enter(impl, 0, 0, NULL, 0);
+    }
+
+    struct io_uring_sqe* sqe = &impl->sqes[impl->sq_local & impl->sq_mask];
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->user_data = (uint64_t)(uintptr_t)handle | op;
+
+    impl->sq_local += 1;
+
+    return sqe;
+}
+
+static void
+iouring_buf_put(iouring_t* impl, uint16_t bid) {
+    struct io_uring_buf* buf = &impl->br->bufs[impl->br_tail & (IOURING_BUFS - 1)];
+
+    buf->addr = (uint64_t)(uintptr_t)(impl->bufs + (size_t)bid * IOURING_BUF_SIZE);
+    buf->len = IOURING_BUF_SIZE;
+    buf->bid = bid;
+
+    impl->br_tail += 1;
+}
+
+static void
+iouring_recycle(iouring_t* impl) {
+    if (impl->recycle_len == 0) {
+        return;
+    }
+
+    for (unsigned i = 0; i < impl->recycle_len; ++i) {
+        iouring_buf_put(impl, impl->recycle[i]);
+    }
+
+    impl->recycle_len = 0;
+
+    __atomic_store_n(&impl->br->tail, impl->br_tail, __ATOMIC_RELEASE);
+}
+
+static void
+iouring_arm(iouring_t* impl, io_handle_t* handle) {
+    struct io_uring_sqe* sqe;
+
+    switch (handle->kind) {
+        case IO_KIND_LISTEN:
+            sqe = iouring_sqe(impl, handle, IOURING_OP_ACCEPT);
+            sqe->opcode = IORING_OP_ACCEPT;
+            sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+            sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+            break;
+        case IO_KIND_CONN:                      /* the kernel picks a buffer per completion */
+            sqe = iouring_sqe(impl, handle, IOURING_OP_RECV);
+            sqe->opcode = IORING_OP_RECV;
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = IOURING_BGID;
+            break;
+        case IO_KIND_WAKE:
+            sqe = iouring_sqe(impl, handle, IOURING_OP_WAKE);
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->poll32_events = POLLIN;
+            sqe->len = IORING_POLL_ADD_MULTI;
+            break;
+        default:
+            return;
+    }
+
+    sqe->fd = handle->fd;
+
+    handle->pending += 1;
+}
+
+static void
+iouring_link(iouring_t* impl, io_handle_t* handle) {
+    handle->prev = NULL;
+    handle->next = impl->rearm;
+
+    if (impl->rearm != NULL) {
+        impl->rearm->prev = handle;
+    }
+
+    impl->rearm = handle;
+}
+
+static void
+iouring_unlink(iouring_t* impl, io_handle_t* handle) {
+    if (handle->prev != NULL) {
+        handle->prev->next = handle->next;
+    } else if (impl->rearm == handle) {
+        impl->rearm = handle->next;
+    } else {
+        return;
+    }
+
+    if (handle->next != NULL) {
+        handle->next->prev = handle->prev;
+    }
+
+    handle->prev = NULL;
+    handle->next = NULL;
+}
+
+static void
+iouring_rearm(iouring_t* impl) {
+    while (impl->rearm != NULL) {
+        io_handle_t* handle = impl->rearm;
+
+        iouring_unlink(impl, handle);
+        iouring_arm(impl, handle);
+    }
+}
+
+static bool
+iouring_complete(iouring_t* impl, const struct io_uring_cqe* cqe, io_event_t* event) {
+    io_handle_t* handle = (io_handle_t*)(uintptr_t)(cqe->user_data & ~(uint64_t)IOURING_OP_MASK);
+    iouring_op_t op = (iouring_op_t)(cqe->user_data & IOURING_OP_MASK);
+    bool chained = op == IOURING_OP_SEND || op == IOURING_OP_SEND_LAST;
+    bool ended = !chained && !(cqe->flags & IORING_CQE_F_MORE);
+
+    if (op == IOURING_OP_CANCEL) {
+        return false;
+    }
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {     /* hand it back once the batch is processed */
+        impl->recycle[impl->recycle_len++] = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    }
+
+    if (ended || op == IOURING_OP_SEND_LAST) {
+        handle->pending -= 1;
+    }
+
+    if (handle->forgotten) {
+        if (handle->pending > 0) {
+            return false;
+        }
+
+        *event = (io_event_t) {
+            .type = IO_EV_RELEASED,
+            .data = handle->data,
+            .fd = -1,
+        };
+
+        io_handle_free(handle);
+        return true;
+    }
+
+    *event = (io_event_t) {
+        .data = handle->data,
+        .fd = -1,
+        .res = cqe->res,
+    };
+
+    switch (op) {
+        case IOURING_OP_ACCEPT:
+            if (ended) {
+                iouring_link(impl, handle);
+            }
+
+            if (cqe->res < 0) {
+                if (cqe->res != -EAGAIN && cqe->res != -ECONNABORTED) {
+                    error_log("iouring err: accept (fd = %d, res = %d)", handle->fd, cqe->res);
+                }
+
+                return false;
+            }
+
+            event->type = IO_EV_ACCEPT;
+            event->fd = cqe->res;
+            return true;
+        case IOURING_OP_WAKE:
+            if (ended) {
+                iouring_link(impl, handle);
+            }
+
+            event->type = IO_EV_WAKE;
+            return cqe->res >= 0;
+        case IOURING_OP_RECV:
+            if (cqe->res > 0) {
+                if (ended) {                    /* the kernel may stop a multishot at any time */
+                    iouring_link(impl, handle);
+                }
+
+                uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+
+                event->type = IO_EV_RECV;
+                event->buf = impl->bufs + (size_t)bid * IOURING_BUF_SIZE;
+                event->len = (size_t)cqe->res;
+                return true;
+            }
+
+            if (cqe->res == -ENOBUFS) {         /* ran dry, restart once buffers come back */
+                iouring_link(impl, handle);
+                return false;
+            }
+
+            event->type = IO_EV_HUP;
+            return true;
+        case IOURING_OP_SEND:
+            event->type = IO_EV_SENT;
+            event->res = cqe->res < 0 ? cqe->res : -EPIPE;
+            return true;
+        case IOURING_OP_SEND_LAST:
+            event->type = IO_EV_SENT;
+            event->res = cqe->res < 0 ? cqe->res : (int)handle->sending;
+            return true;
+        case IOURING_OP_CANCEL:
+            break;
+    }
+
+    return false;
+}
+
+static void
+iouring_teardown(iouring_t* impl) {
+    if (impl->br != NULL && impl->br != MAP_FAILED) {
+        munmap(impl->br, impl->br_size);
+    }
+
+    if (impl->sqes != NULL && impl->sqes != MAP_FAILED) {
+        munmap(impl->sqes, impl->sqes_size);
+    }
+
+    if (impl->ring != NULL && impl->ring != MAP_FAILED) {
+        munmap(impl->ring, impl->ring_size);
+    }
+
+    if (impl->fd != -1) {
+        close(impl->fd);
+    }
+
+    free(impl->bufs);
+    free(impl);
+}
+
+static int
+iouring_map(iouring_t* impl, const struct io_uring_params* params) {
+    size_t sq_size = params->sq_off.array + params->sq_entries * sizeof(unsigned);
+    size_t cq_size = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+
+    impl->ring_size = sq_size > cq_size ? sq_size : cq_size;
+    impl->ring = mmap(NULL, impl->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            impl->fd, IORING_OFF_SQ_RING);
+
+    impl->sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+    impl->sqes = mmap(NULL, impl->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            impl->fd, IORING_OFF_SQES);
+
+    if (impl->ring == MAP_FAILED || impl->sqes == MAP_FAILED) {
+        error_log("iouring err: mmap");
+        return -1;
+    }
+
+    uint8_t* ring = impl->ring;
+
+    impl->sq_head = (unsigned*)(ring + params->sq_off.head);
+    impl->sq_tail = (unsigned*)(ring + params->sq_off.tail);
+    impl->sq_array = (unsigned*)(ring + params->sq_off.array);
+    impl->sq_mask = *(unsigned*)(ring + params->sq_off.ring_mask);
+    impl->sq_entries = *(unsigned*)(ring + params->sq_off.ring_entries);
+    impl->sq_local = *impl->sq_tail;
+
+    impl->cq_head = (unsigned*)(ring + params->cq_off.head);
+    impl->cq_tail = (unsigned*)(ring + params->cq_off.tail);
+    impl->cq_mask = *(unsigned*)(ring + params->cq_off.ring_mask);
+    impl->cqes = (struct io_uring_cqe*)(ring + params->cq_off.cqes);
+
+    for (unsigned i = 0; i < impl->sq_entries; ++i) {   /* sqes are always used in ring order */
+        impl->sq_array[i] = i;
+    }
+
+    return 0;
+}
+
+static int
+iouring_provide(iouring_t* impl) {
+    impl->br_size = IOURING_BUFS * sizeof(struct io_uring_buf);
+    impl->br = mmap(NULL, impl->br_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    impl->bufs = malloc((size_t)IOURING_BUFS * IOURING_BUF_SIZE);
+
+    if (impl->br == MAP_FAILED || impl->bufs == NULL) {
+        error_log("iouring err: failed to allocate provided buffers");
+        return -1;
+    }
+
+    struct io_uring_buf_reg reg = {
+        .ring_addr = (uint64_t)(uintptr_t)impl->br,
+        .ring_entries = IOURING_BUFS,
+        .bgid = IOURING_BGID,
+    };
+
+    if (iouring_register(impl->fd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1) {
+        error_log("iouring err: failed to register provided buffer ring");
+        return -1;
+    }
+
+    impl->br_tail = 0;
+
+    for (uint16_t bid = 0; bid < IOURING_BUFS; ++bid) {
+        iouring_buf_put(impl, bid);
+    }
+
+    __atomic_store_n(&impl->br->tail, impl->br_tail, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+
+/*** ops ***/
+
+static int
+iouring_init(io_t* io) {
+    if (!iouring_kernel_ok()) {
+        error_log("iouring err: kernel too old for multishot recv");
+        return -1;
+    }
+
+    iouring_t* impl = calloc(1, sizeof(iouring_t));
+
+    if (impl == NULL) {
+        error_shutdown("iouring err: calloc");
+    }
+
+    struct io_uring_params params = {
+        .flags = IOURING_SETUP_FAST,            /* one thread owns the ring, completions run on enter */
+        .cq_entries = IOURING_CQ_ENTRIES,
+    };
+
+    impl->fd = iouring_setup(IOURING_ENTRIES, &params);
+
+    if (impl->fd == -1 && errno == EINVAL) {
+        params = (struct io_uring_params) {
+            .flags = IORING_SETUP_CQSIZE,
+            .cq_entries = IOURING_CQ_ENTRIES,
+        };
+
+        impl->fd = iouring_setup(IOURING_ENTRIES, &params);
+    }
+
+    if (impl->fd == -1) {
+        error_log("iouring err: io_uring_setup");
+        iouring_teardown(impl);
+        return -1;
+    }
+
+    if ((params.features & IOURING_FEATURES) != IOURING_FEATURES || !iouring_probe(impl->fd)) {
+        error_log("iouring err: kernel lacks a required feature");
+        iouring_teardown(impl);
+        return -1;
+    }
+
+    if (iouring_map(impl, &params) == -1 || iouring_provide(impl) == -1) {
+        iouring_teardown(impl);
+        return -1;
+    }
+
+    io->impl = impl;
+
+    return 0;
+}
+
+static void
+iouring_free(io_t* io) {
+    iouring_teardown(io->impl);
+}
+
+static int
+iouring_add(io_t* io, io_handle_t* handle) {
+    iouring_arm(io->impl, handle);
+
+    return 0;
+}
+
+static bool
+iouring_del(io_t* io, io_handle_t* handle) {
+    iouring_t* impl = io->impl;
+
+    iouring_unlink(impl, handle);
+
+    if (handle->pending == 0) {
+        return true;
+    }
+
+    /* every request on the fd completes with -ECANCELED, the last one releases the handle */
+    struct io_uring_sqe* sqe = iouring_sqe(impl, NULL, IOURING_OP_CANCEL);
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = handle->fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+
+    return false;
+}
+
+static struct msghdr*
+iouring_msgs(io_handle_t* handle, unsigned count) {
+    if (count > handle->msgs_size) {            /* only grows, nothing is in flight at this point */
+        handle->msgs = realloc(handle->msgs, sizeof(struct msghdr) * count);
+
+        if (handle->msgs == NULL) {
+            error_shutdown("iouring err: realloc");
+        }
+
+        handle->msgs_size = count;
+    }
+
+    return handle->msgs;
+}
+
+static ssize_t
+iouring_send(io_t* io, io_handle_t* handle, struct iovec* iov, int iovcnt, bool* zerocopy) {
+    iouring_t* impl = io->impl;
+    size_t total = 0;
+
+    for (int i = 0; i < iovcnt; ++i) {
+        total += iov[i].iov_len;
+    }
+
+    /* inline first: waiting a completion round trip per flush lets multishot recv outrun the queues */
+    ssize_t nbytes = io_send_ready(handle, iov, iovcnt, zerocopy);
+
+    if (nbytes == -1 || (size_t)nbytes == total) {
+        return nbytes;
+    }
+
+    iov_advance(&iov, &iovcnt, (size_t)nbytes);
+
+    unsigned count = ((unsigned)iovcnt + IOURING_MSG_IOV - 1) / IOURING_MSG_IOV;
+    struct msghdr* msgs = iouring_msgs(handle, count);
+
+    if (iouring_space(impl) < count) {          /* a chain must not straddle two submissions */
+        (void)iouring_enter(impl, 0, 0, NULL, 0);
+    }
+
+    /* linked so the rest hits the socket in order, only the last one posts on success */
+    for (unsigned i = 0; i < count; ++i) {
+        bool last = i == count - 1;
+        unsigned first = i * IOURING_MSG_IOV;
+        struct io_uring_sqe* sqe = iouring_sqe(impl, handle, last ? IOURING_OP_SEND_LAST : IOURING_OP_SEND);
+
+        msgs[i] = (struct msghdr) {
+            .msg_iov = iov + first,
+            .msg_iovlen = last ? (size_t)iovcnt - first : IOURING_MSG_IOV,
+        };
+
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = handle->fd;
+        sqe->addr = (uint64_t)(uintptr_t)&msgs[i];
+        sqe->len = 1;
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;    /* short only when the socket is broken */
+        sqe->flags = last ? 0 : IOSQE_IO_LINK | IOSQE_CQE_SKIP_SUCCESS;
+    }
+
+    handle->sending = total;                    /* reported as a whole, the inline part included */
+    handle->pending += 1;
+
+    return IO_SEND_QUEUED;
+}
+
+static int
+iouring_wait(io_t* io, io_event_t* events, int max_events, int timeout_ms) {
+    iouring_t* impl = io->impl;
+
+    iouring_recycle(impl);                      /* the caller is done with the last batch */
+    iouring_rearm(impl);
+
+    unsigned head = *impl->cq_head;
+    bool ready = __atomic_load_n(impl->cq_tail, __ATOMIC_ACQUIRE) != head;
+    struct __kernel_timespec ts = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_nsec = (long long)(timeout_ms % 1000) * 1000000,
+    };
+    struct io_uring_getevents_arg arg = {
+        .ts = (uint64_t)(uintptr_t)&ts,
+    };
+
+    int rv = ready || timeout_ms < 0
+        ? iouring_enter(impl, ready ? 0 : 1, IORING_ENTER_GETEVENTS, NULL, 0)
+        : iouring_enter(impl, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+
+    if (rv < 0 && rv != -EINTR && rv != -ETIME && rv != -EBUSY && rv != -EAGAIN) {
+        errno = -rv;
+        error_log("iouring err: io_uring_enter");
+        return -1;
+    }
+
+    unsigned tail = __atomic_load_n(impl->cq_tail, __ATOMIC_ACQUIRE);
+    int served = 0;
+
+    while (head != tail && served < max_events) {
+        if (iouring_complete(impl, &impl->cqes[head & impl->cq_mask], &events[served])) {
+            served += 1;
+        }
+
+        head += 1;
+    }
+
+    __atomic_store_n(impl->cq_head, head, __ATOMIC_RELEASE);
+
+    return served;
+}
+
+
+/*** data ***/
+
+const io_ops_t iouring_ops = {
+    .name = "io_uring",
+    .zerocopy = false,                          /* SEND_ZC notifies through its own CQEs, not wired up */
+    .init = iouring_init,
+    .free = iouring_free,
+    .add  = iouring_add,
+    .del  = iouring_del,
+    .send = iouring_send,
+    .wait = iouring_wait,
+};
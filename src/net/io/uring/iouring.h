@@ -0,0 +1,10 @@
+#if !defined(IOURING_H)
+#define IOURING_H
+
+#include "../iobackend.h"
+
+/*** data ***/
+
+extern const io_ops_t iouring_ops;
+
+#endif /* !defined(IOURING_H) */
@@ -2,6 +2,7 @@
 #include "net.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdatomic.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -75,6 +76,58 @@ recvall(int sockfd, uint8_t* buf, unsigned len) {
 }
 
 
+/*** vectored ***/
+
+ssize_t
+sendv(int sockfd, const struct iovec* iov, int iovcnt) {
+    struct msghdr msg = {
+        .msg_iov = (struct iovec*)iov,
+        .msg_iovlen = (size_t)iovcnt,
+    };
+
+    ssize_t n;
+
+    do {
+        n = sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+    } while (n == -1 && errno == EINTR);
+
+    return n;
+}
+
+int
+sendallv(int sockfd, struct iovec* iov, int iovcnt) {
+    ssize_t sent = 0;
+
+    while (iovcnt > 0) {
+        ssize_t n = sendv(sockfd, iov, iovcnt);
+
+        if (n <= 0) {
+            return (int)n;
+        }
+
+        sent += n;
+        iov_advance(&iov, &iovcnt, (size_t)n);
+    }
+
+    return (int)sent;
+}
+
+void
+iov_advance(struct iovec** iov, int* iovcnt, size_t bytes) {
+    while (*iovcnt > 0 && bytes >= (*iov)->iov_len) {
+        bytes -= (*iov)->iov_len;
+
+        *iov += 1;
+        *iovcnt -= 1;
+    }
+
+    if (*iovcnt > 0) {
+        (*iov)->iov_base = (uint8_t*)(*iov)->iov_base + bytes;
+        (*iov)->iov_len -= bytes;
+    }
+}
+
+
 /*** connection ***/
 
 int
@@ -113,7 +166,7 @@ get_socket_connect(const char* ip, const char* port) {
 }
 
 int
-get_socket_listen(const char* port) {
+get_socket_listen(const char* port, bool shared) {
     struct addrinfo hints, *ai, *p;
     int rv, sockfd;
 
@@ -139,6 +192,11 @@ get_socket_listen(const char* port) {
             error_shutdown("net err: setsockopt");
         }
 
+        /* several listeners on one port, the kernel balances connections across them */
+        if (shared && setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(int)) == -1) {
+            error_shutdown("net err: setsockopt reuseport");
+        }
+
         if (bind(sockfd, p->ai_addr, p->ai_addrlen) == 0) {
             break;
         }
@@ -166,6 +224,20 @@ get_socket_listen(const char* port) {
 }
 
 
+/*** options ***/
+
+int
+set_socket_nonblock(int sockfd) {
+    int flags = fcntl(sockfd, F_GETFL, 0);
+
+    if (flags == -1 || fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        error_log("net err: fcntl");
+        return -1;
+    }
+
+    return 0;
+}
+
 
 /*** methods ***/
 
@@ -2,8 +2,11 @@
 #if !defined(NET_H)
 #define NET_H 
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <netdb.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 /*** communicate ***/
 
@@ -14,15 +17,33 @@ extern int
 recvall(int sockfd, uint8_t* buf, unsigned len);
 
 
+/*** vectored ***/
+
+extern ssize_t
+sendv(int sockfd, const struct iovec* iov, int iovcnt);
+
+extern int
+sendallv(int sockfd, struct iovec* iov, int iovcnt);
+
+extern void
+iov_advance(struct iovec** iov, int* iovcnt, size_t bytes);
+
+
 /*** connect ***/
 
 extern int
-get_socket_listen(const char* port);
+get_socket_listen(const char* port, bool shared);
 
 extern int
 get_socket_connect(const char* ip, const char* port);
 
 
+/*** options ***/
+
+extern int
+set_socket_nonblock(int sockfd);
+
+
 /*** validate ***/
 
 extern int
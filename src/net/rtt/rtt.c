@@ -0,0 +1,40 @@
+#include "rtt.h"
+
+
+/*** data ***/
+
+#define RTT_ALPHA 8                             /* srtt moves 1/8 of the way to each sample */
+#define RTT_BETA 4                              /* rttvar 1/4 */
+
+
+/*** methods ***/
+
+void
+rtt_init(rtt_t* rtt) {
+    *rtt = (rtt_t) {
+        .srtt_us = 0,
+        .rttvar_us = 0,
+        .last_us = 0,
+        .samples = 0,
+    };
+}
+
+void
+rtt_sample(rtt_t* rtt, int64_t sample_us) {
+    if (sample_us < 0) {
+        sample_us = 0;
+    }
+
+    rtt->last_us = sample_us;
+
+    if (rtt->samples++ == 0) {
+        rtt->srtt_us = sample_us;
+        rtt->rttvar_us = sample_us / 2;
+        return;
+    }
+
+    int64_t err = sample_us - rtt->srtt_us;
+
+    rtt->rttvar_us += ((err < 0 ? -err : err) - rtt->rttvar_us) / RTT_BETA;
+    rtt->srtt_us += err / RTT_ALPHA;
+}
@@ -0,0 +1,25 @@
+#if !defined(RTT_H)
+#define RTT_H
+
+#include <stdint.h>
+
+/*** data ***/
+
+/* a smoothed round trip estimate, the same filter tcp uses for its retransmit timer */
+typedef struct rtt {
+    int64_t srtt_us;                            /* smoothed, meaningless until there are samples */
+    int64_t rttvar_us;                          /* mean deviation around it */
+    int64_t last_us;
+    unsigned samples;
+} rtt_t;
+
+
+/*** methods ***/
+
+extern void
+rtt_init(rtt_t* rtt);
+
+extern void
+rtt_sample(rtt_t* rtt, int64_t sample_us);
+
+#endif /* !defined(RTT_H) */
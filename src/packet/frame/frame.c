@@ -0,0 +1,278 @@
+#include "frame.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../error/error.h"
+
+
+/*** data ***/
+
+#define FRAME_CLASS_LEN 4
+#define FRAME_POOL_CAP 1024                     /* buffers kept per class, the rest go to free() */
+
+/* exclusive bounds, the last class holds the largest frame of either version */
+static const unsigned frame_class_size[FRAME_CLASS_LEN] = {64, 128, 192, WIRE_SIZE_MAX + 1};
+
+_Static_assert((int)WIRE_SIZE_MAX >= (int)PACKET_SIZE_MAX, "a v2 frame may carry a longer header than v1");
+
+typedef struct {
+    frame_t* head;
+    unsigned len;
+} frame_list_t;
+
+struct frame_pool {
+    pthread_t owner;                            /* only the owner pops the free lists */
+    frame_list_t free[FRAME_CLASS_LEN];
+    _Atomic(frame_t*) remote[FRAME_CLASS_LEN];  /* frames released by other threads */
+    atomic_uint remote_len[FRAME_CLASS_LEN];    /* held to the cap as well, counted before the push */
+};
+
+
+/*** aux ***/
+
+static unsigned
+frame_class(unsigned len) {
+    for (unsigned cls = 0; cls < FRAME_CLASS_LEN; ++cls) {
+        if (len < frame_class_size[cls]) {
+            return cls;
+        }
+    }
+
+    error_shutdown("frame err: frame too large (%u bytes)", len);
+
+    return FRAME_CLASS_LEN;
+}
+
+static void
+frame_adopt(frame_pool_t* pool, unsigned cls) {
+    frame_list_t* list = &pool->free[cls];
+    frame_t* head = atomic_exchange_explicit(&pool->remote[cls], NULL, memory_order_acquire);
+    unsigned len = 0;
+
+    for (const frame_t* frame = head; frame != NULL; frame = frame->next) {
+        len += 1;
+    }
+
+    atomic_fetch_sub_explicit(&pool->remote_len[cls], len, memory_order_relaxed);
+
+    list->head = head;
+    list->len += len;
+}
+
+static frame_t*
+frame_alloc(frame_pool_t* pool, unsigned len) {
+    unsigned cls = frame_class(len);
+    frame_list_t* list = &pool->free[cls];
+
+    if (list->head == NULL) {
+        frame_adopt(pool, cls);
+    }
+
+    frame_t* frame = list->head;
+
+    if (frame != NULL) {
+        list->head = frame->next;
+        list->len -= 1;
+    } else {
+        frame = malloc(sizeof(frame_t) + frame_class_size[cls]);
+
+        if (frame == NULL) {
+            error_shutdown("frame err: malloc");
+        }
+    }
+
+    frame->pool = pool;
+    frame->next = NULL;
+    atomic_init(&frame->refs, 1);
+    frame->len = len;
+    frame->cls = cls;
+    frame->sender = 0;
+    frame->base = 0;
+    frame->keep = false;
+    atomic_init(&frame->wire[0], NULL);
+    atomic_init(&frame->wire[1], NULL);
+
+    return frame;
+}
+
+static void
+frame_list_free(frame_t* frame) {
+    while (frame != NULL) {
+        frame_t* next = frame->next;
+
+        free(frame);
+        frame = next;
+    }
+}
+
+static void
+frame_release_remote(frame_t* frame) {
+    _Atomic(frame_t*)* remote = &frame->pool->remote[frame->cls];
+    atomic_uint* remote_len = &frame->pool->remote_len[frame->cls];
+
+    if (atomic_fetch_add_explicit(remote_len, 1, memory_order_relaxed) >= FRAME_POOL_CAP) {
+        atomic_fetch_sub_explicit(remote_len, 1, memory_order_relaxed);
+        free(frame);
+        return;
+    }
+
+    frame->next = atomic_load_explicit(remote, memory_order_relaxed);
+
+    /* push only, the owner takes the whole list at once, so there is no ABA */
+    while (!atomic_compare_exchange_weak_explicit(remote, &frame->next, frame,
+                memory_order_release, memory_order_relaxed)) {}
+}
+
+
+/*** pool ***/
+
+void
+frame_pool_init(frame_pool_t** pool) {
+    *pool = calloc(1, sizeof(frame_pool_t));
+
+    if (*pool == NULL) {
+        error_shutdown("frame err: calloc");
+    }
+
+    (*pool)->owner = pthread_self();
+
+    for (unsigned cls = 0; cls < FRAME_CLASS_LEN; ++cls) {
+        atomic_init(&(*pool)->remote[cls], NULL);
+        atomic_init(&(*pool)->remote_len[cls], 0);
+    }
+}
+
+void
+frame_pool_free(frame_pool_t* pool) {
+    for (unsigned cls = 0; cls < FRAME_CLASS_LEN; ++cls) {
+        frame_list_free(pool->free[cls].head);
+        frame_list_free(atomic_load(&pool->remote[cls]));
+    }
+
+    free(pool);
+}
+
+
+/*** frames ***/
+
+frame_t*
+frame_encode(frame_pool_t* pool, const packet_t* packet) {
+    frame_t* frame = frame_alloc(pool, PACKET_SIZE_MIN + packet->payld_len);
+
+    packet_encode(packet, frame->buf);         /* writes every byte of the header */
+
+    return frame;
+}
+
+frame_t*
+frame_copy(frame_pool_t* pool, const uint8_t* buf, unsigned len) {
+    frame_t* frame = frame_alloc(pool, len);
+
+    memcpy(frame->buf, buf, len);
+
+    return frame;
+}
+
+frame_t*
+frame_view(frame_pool_t* pool, const packet_view_t* view) {
+    if (view->frame != NULL) {
+        return frame_copy(pool, view->frame, view->len);
+    }
+
+    packet_t packet;
+
+    packet_view_copy(view, &packet);            /* decoded from v2, frames are kept in v1 */
+
+    return frame_encode(pool, &packet);
+}
+
+bool
+frame_known(const frame_t* frame, const wire_stream_t* stream) {
+    packet_view_t view;
+
+    if (frame->sender == 0) {
+        return true;
+    }
+
+    packet_view_load(&view, frame->buf);
+
+    return wire_known(stream, frame->sender, frame->base, view.usrname);
+}
+
+frame_t*
+frame_define(frame_pool_t* pool, wire_stream_t* stream, const frame_t* frame) {
+    uint8_t buf[WIRE_DEFINE_MAX];
+    packet_view_t view;
+
+    packet_view_load(&view, frame->buf);
+
+    frame_t* define = frame_copy(pool, buf, wire_define(stream, frame->sender, frame->base, view.usrname, buf));
+
+    define->keep = true;
+
+    return define;
+}
+
+frame_t*
+frame_transcode(frame_pool_t* pool, const wire_stream_t* stream, frame_t* frame) {
+    _Atomic(frame_t*)* slot = &frame->wire[stream->checked];
+    frame_t* wire = atomic_load_explicit(slot, memory_order_acquire);
+
+    if (wire == NULL) {                         /* the first v2 recipient on any shard encodes it */
+        uint8_t buf[WIRE_SIZE_MAX];
+        packet_view_t view;
+
+        packet_view_load(&view, frame->buf);
+
+        frame_t* made = frame_copy(pool, buf, wire_encode(stream, &view, frame->sender, frame->base, buf));
+
+        if (atomic_compare_exchange_strong_explicit(slot, &wire, made, memory_order_acq_rel, memory_order_acquire)) {
+            wire = made;
+        } else {
+            frame_unref(made);                  /* another shard got there first, with the same bytes */
+        }
+    }
+
+    return frame_ref(wire);
+}
+
+frame_t*
+frame_ref(frame_t* frame) {
+    atomic_fetch_add_explicit(&frame->refs, 1, memory_order_relaxed);
+
+    return frame;
+}
+
+void
+frame_unref(frame_t* frame) {
+    if (atomic_fetch_sub_explicit(&frame->refs, 1, memory_order_acq_rel) > 1) {
+        return;
+    }
+
+    for (unsigned i = 0; i < 2; ++i) {
+        frame_t* wire = atomic_load_explicit(&frame->wire[i], memory_order_acquire);
+
+        if (wire != NULL) {
+            frame_unref(wire);
+        }
+    }
+
+    if (!pthread_equal(frame->pool->owner, pthread_self())) {
+        frame_release_remote(frame);
+        return;
+    }
+
+    frame_list_t* list = &frame->pool->free[frame->cls];
+
+    if (list->len == FRAME_POOL_CAP) {
+        free(frame);
+        return;
+    }
+
+    frame->next = list->head;
+    list->head = frame;
+    list->len += 1;
+}
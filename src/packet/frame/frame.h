@@ -0,0 +1,64 @@
+#if !defined(FRAME_H)
+#define FRAME_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../packet.h"
+#include "../wire/wire.h"
+
+/*** data ***/
+
+typedef struct frame_pool frame_pool_t;
+
+typedef struct frame {
+    frame_pool_t* pool;                         /* where the buffer goes back on the last unref */
+    struct frame* next;                         /* free list link while pooled */
+    atomic_uint refs;                           /* frames may be shared across server shards */
+    unsigned len;
+    unsigned cls;
+    uint32_t sender;                            /* its sender's id on v2 streams, 0 when it names itself */
+    uint64_t base;                              /* the sender's nonce base there */
+    bool keep;                                  /* a v2 definition, frames queued after it need it */
+    _Atomic(struct frame*) wire[2];             /* its v2 encodings, bare and with a crc, made on first use */
+    uint8_t buf[];                              /* immutable once handed out */
+} frame_t;
+
+
+/*** pool ***/
+
+extern void
+frame_pool_init(frame_pool_t** pool);
+
+extern void
+frame_pool_free(frame_pool_t* pool);
+
+
+/*** frames ***/
+
+extern frame_t*
+frame_encode(frame_pool_t* pool, const packet_t* packet);
+
+extern frame_t*
+frame_copy(frame_pool_t* pool, const uint8_t* buf, unsigned len);
+
+extern frame_t*
+frame_view(frame_pool_t* pool, const packet_view_t* view);
+
+extern bool
+frame_known(const frame_t* frame, const wire_stream_t* stream);
+
+extern frame_t*
+frame_define(frame_pool_t* pool, wire_stream_t* stream, const frame_t* frame);
+
+extern frame_t*
+frame_transcode(frame_pool_t* pool, const wire_stream_t* stream, frame_t* frame);
+
+extern frame_t*
+frame_ref(frame_t* frame);
+
+extern void
+frame_unref(frame_t* frame);
+
+#endif /* !defined(FRAME_H) */
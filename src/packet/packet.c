@@ -7,11 +7,14 @@
 #include <string.h>
 #include <sys/errno.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <time.h>
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <ctype.h>
 
 #include "../crypto/crc/crc32.h"
 #include "../error/error.h"
@@ -21,52 +24,116 @@
 
 /*** data ***/
 
-static const char* const PACKET_MAGIC = "rooms";
+static const char PACKET_MAGIC[SIZE_MAGIC] = "rooms";
 
+static const char* const PACKET_CHECKSUM_NAMES[] = {"none", "crc32"};  /* by bit, as in packet_checksum_t */
+static const char* const PACKET_COMPRESS_NAMES[] = {"none"};
 
-/*** encoding ***/
+#define PACKET_NAMES_LEN(names) (sizeof(names) / sizeof((names)[0]))
 
-static void
-packet_encode(const packet_t* packet, uint8_t* buf) {
-    pack_str(buf, PACKET_MAGIC);                        buf += SIZE_MAGIC;
-    pack_str(buf, packet->usrname);                     buf += SIZE_USRNAME;
 
-    pack_chr(buf, packet->payld_len);                   buf += SIZE_PAYLD_LEN;
-    pack_chr(buf, packet->flags);                       buf += SIZE_FLAGS;
-    pack_u32(buf, packet->crc);                         buf += SIZE_CRC;
-    pack_str(buf, packet->options);                     buf += SIZE_OPTIONS;
+/*** strings ***/
 
-    pack_u64(buf, packet->nonce);                       buf += SIZE_NONCE;
-    pack_u64(buf, packet->timestamp);                   buf += SIZE_TIMESTAMP;
+static packet_str_t
+packet_str_at(const uint8_t* buf, unsigned size) {
+    const char* ptr = (const char*)buf;
 
-    pack_str(buf, packet->payld);
+    return (packet_str_t) {.ptr = ptr, .len = (unsigned)strnlen(ptr, size)};
+}
+
+static packet_str_t
+packet_str_of(const char* cstr) {
+    return (packet_str_t) {.ptr = cstr, .len = (unsigned)strlen(cstr)};
 }
 
 static void
-packet_decode(packet_t* packet, const uint8_t* buf) {
-                                                        buf += SIZE_MAGIC;
-    unpack_str(packet->usrname, buf);                   buf += SIZE_USRNAME;
+packet_str_put(uint8_t* buf, const char* str, unsigned size) {
+    size_t len = strnlen(str, size);            /* a full field has no NUL on the wire */
+
+    memcpy(buf, str, len);
+    memset(buf + len, 0, size - len);
+}
+
+
+/*** kinds ***/
+
+/* what a field of each kind does, PACKET_HEAD in packet.h says which field is of which kind */
+
+#define PACKET_STORE_MAGIC(buf, src, size)  memcpy((buf), PACKET_MAGIC, (size))
+#define PACKET_STORE_STR(buf, src, size)    packet_str_put((buf), (src), (size))
+#define PACKET_STORE_U8(buf, src, size)     pack_chr((buf), (src))
+#define PACKET_STORE_U32(buf, src, size)    pack_u32((buf), (src))
+#define PACKET_STORE_U64(buf, src, size)    pack_u64((buf), (src))
+
+#define PACKET_LOAD_MAGIC(dst, buf, size)                                          /* checked when found */
+#define PACKET_LOAD_STR(dst, buf, size)     ((dst) = packet_str_at((buf), (size)))
+#define PACKET_LOAD_U8(dst, buf, size)      unpack_chr(&(dst), (buf))
+#define PACKET_LOAD_U32(dst, buf, size)     unpack_u32(&(dst), (buf))
+#define PACKET_LOAD_U64(dst, buf, size)     unpack_u64(&(dst), (buf))
+
+#define PACKET_COPY_MAGIC(dst, src)
+#define PACKET_COPY_STR(dst, src)           packet_str_copy((src), (dst))
+#define PACKET_COPY_U8(dst, src)            ((dst) = (src))
+#define PACKET_COPY_U32(dst, src)           ((dst) = (src))
+#define PACKET_COPY_U64(dst, src)           ((dst) = (src))
+
+#define PACKET_CHECK_MAGIC(src, size, name) true
+#define PACKET_CHECK_STR(src, size, name)   packet_valstr((src), (size), (name))
+#define PACKET_CHECK_U8(src, size, name)    true
+#define PACKET_CHECK_U32(src, size, name)   true
+#define PACKET_CHECK_U64(src, size, name)   true
 
-    unpack_chr(&packet->payld_len, buf);                buf += SIZE_PAYLD_LEN;
-    unpack_chr(&packet->flags, buf);                    buf += SIZE_FLAGS;
-    unpack_u32(&packet->crc, buf);                      buf += SIZE_CRC;
-    unpack_str(packet->options, buf);                   buf += SIZE_OPTIONS;
+#define PACKET_FITS_MAGIC(field, size)      (sizeof(PACKET_MAGIC) == (size))
+#define PACKET_FITS_STR(field, size)        (sizeof(((packet_t*)0)->field) == (size) + 1)
+#define PACKET_FITS_U8(field, size)         (sizeof(((packet_t*)0)->field) == (size))
+#define PACKET_FITS_U32(field, size)        (sizeof(((packet_t*)0)->field) == (size))
+#define PACKET_FITS_U64(field, size)        (sizeof(((packet_t*)0)->field) == (size))
 
-    unpack_u64(&packet->nonce, buf);                    buf += SIZE_NONCE;
-    unpack_u64(&packet->timestamp, buf);                buf += SIZE_TIMESTAMP;
+
+/*** layout ***/
+
+#define PACKET_LAYOUT(NAME, field, size, kind)                                                          \
+    _Static_assert(OFFSET_##NAME + SIZE_##NAME <= PACKET_SIZE_MIN, #NAME " runs past the header");     \
+    _Static_assert(PACKET_FITS_##kind(field, size), #NAME " does not fit where it is kept");
+#define PACKET_SUM(NAME, field, size, kind) + (size)
+
+PACKET_HEAD(PACKET_LAYOUT)
+
+_Static_assert(PACKET_SIZE_MIN == 0 PACKET_HEAD(PACKET_SUM), "the header has no padding");
+_Static_assert(_Alignof(packet_head_layout_t) == 1, "offsets are byte offsets");
+_Static_assert(PACKET_SIZE_MIN == 48, "the header is what every peer already speaks");
+
+#undef PACKET_LAYOUT
+#undef PACKET_SUM
+
+
+/*** encoding ***/
+
+static void
+packet_encode_head(const packet_t* packet, uint8_t* buf) {
+#define PACKET_ENCODE(NAME, field, size, kind) PACKET_STORE_##kind(buf + OFFSET_##NAME, packet->field, SIZE_##NAME);
+    PACKET_HEAD(PACKET_ENCODE)
+#undef PACKET_ENCODE
+}
+
+void
+packet_encode(const packet_t* packet, uint8_t* buf) {
+    packet_encode_head(packet, buf);
+    memcpy(buf + PACKET_SIZE_MIN, packet->payld, packet->payld_len);    /* exactly the frame, no NUL */
 }
 
 
 /*** validation ***/
 
 #define PACKET_HAS_PAYLD(packet) ((packet)->flags & (PACKET_FLAG_MSG | PACKET_FLAG_WHSP))
+#define PACKET_MAY_PAYLD(packet) ((packet)->flags & (PACKET_FLAG_MSG | PACKET_FLAG_WHSP | PACKET_FLAG_JOIN | PACKET_FLAG_DISC | PACKET_FLAG_ACK) \
+        || (packet)->flags == PACKET_FLAG_HELO)
 
 static bool
-packet_valstr(const char* str) {
-    size_t len = strlen(str);
-
-    for (size_t i = len; i < sizeof(str); ++i) {
-        if (str[i] != '\0') {
+packet_valstr(packet_str_t str, unsigned size, const char* name) {
+    for (unsigned i = str.len; i < size; ++i) {
+        if (str.ptr[i] != '\0') {
+            error_log("packet err: corrupt %s (not sanitized)", name);
             return false;
         }
     }
@@ -74,61 +141,122 @@ packet_valstr(const char* str) {
     return true;
 }
 
-static bool
-packet_valhead(packet_t* packet) {
-    if (strlen(packet->usrname) == 0) {
+bool
+packet_view_valid(const packet_view_t* view) {
+    if (view->usrname.len == 0) {
         error_log("packet err: empty usrname");
         return false;
     }
 
-    if (__builtin_popcount(packet->flags) != 1) {
-        error_log("packet err: corrupt flags 0x%02x", packet->flags);
+    if (__builtin_popcount(view->flags) != 1 && view->flags != PACKET_FLAG_ROST && view->flags != PACKET_FLAG_HELO) {
+        error_log("packet err: corrupt flags 0x%02x", view->flags);
         return false;
     }
 
-    if (PACKET_HAS_PAYLD(packet) && (packet->payld_len == 0 || packet->crc == 0)) {
+    if (PACKET_HAS_PAYLD(view) && (view->payld.len == 0 || (view->crc == 0 && !view->unchecked))) {
         error_log("packet err: incoherent contents (type = MSG/WHSP and PAYLD_LEN = 0)");
         return false;
     }
 
-    if (!PACKET_HAS_PAYLD(packet) && (packet->payld_len != 0 || packet->crc != 0)) {
-        error_log("packet err: incoherent contents (type != MSG/WHSP and PAYLD_LEN != 0)");
+    if (!PACKET_MAY_PAYLD(view) && (view->payld.len != 0 || view->crc != 0)) {
+        error_log("packet err: incoherent contents (type != MSG/WHSP/JOIN/DISC/ACK/HELO and PAYLD_LEN != 0)");
         return false;
     }
 
-    if (packet->flags & PACKET_FLAG_WHSP && strlen(packet->options) == 0) {
-        error_log("packet err: incoherent contents (type = WHSP and OPTIONS_LEN = 0)");
+    if (view->payld.len == 0 && view->crc != 0) {    /* a plain JOIN */
+        error_log("packet err: incoherent contents (PAYLD_LEN = 0 and CRC != 0)");
         return false;
     }
 
-    if (!(packet->flags & PACKET_FLAG_WHSP) && strlen(packet->options) != 0) {
-        error_log("packet err: incoherent contents (type != WHSP and OPTIONS_LEN != 0)");
+    if (view->flags & PACKET_FLAG_WHSP && view->options.len == 0) {
+        error_log("packet err: incoherent contents (type = WHSP and OPTIONS_LEN = 0)");
         return false;
     }
 
-    if (!packet_valstr(packet->usrname)) {
-        error_log("packet err: corrupt usrname (not sanitized)");
+    if (!(view->flags & (PACKET_FLAG_WHSP | PACKET_FLAG_JOIN)) && view->options.len != 0) {
+        error_log("packet err: incoherent contents (type != WHSP/JOIN and OPTIONS_LEN != 0)");
         return false;
     }
 
-    if (!packet_valstr(packet->options)) {
-        error_log("packet err: corrupt options (not sanitized)");
+#define PACKET_SANITIZED(NAME, field, size, kind) && PACKET_CHECK_##kind(view->field, SIZE_##NAME, #field)
+    return true PACKET_HEAD(PACKET_SANITIZED);
+#undef PACKET_SANITIZED
+}
+
+
+/*** view ***/
+
+void
+packet_view_load(packet_view_t* view, const uint8_t* buf) {
+#define PACKET_DECODE(NAME, field, size, kind) PACKET_LOAD_##kind(view->field, buf + OFFSET_##NAME, SIZE_##NAME);
+    PACKET_HEAD(PACKET_DECODE)
+#undef PACKET_DECODE
+
+    view->frame = buf;
+    view->unchecked = false;
+    view->len = PACKET_SIZE_MIN + view->payld_len;
+    view->payld = (packet_str_t) {.ptr = (const char*)buf + PACKET_SIZE_MIN, .len = view->payld_len};  /* may not be there yet */
+}
+
+bool
+packet_view_head(packet_view_t* view, const uint8_t* buf) {
+    packet_view_load(view, buf);
+
+    return packet_view_valid(view);
+}
+
+bool
+packet_view_payld(const packet_view_t* view) {
+    uint32_t crc = crc32_generate(view->payld.ptr, view->payld.len);
+
+    if (view->crc != crc) {
+        error_log("packet err: corrupt crc, (expected %08x, got %08x)", crc, view->crc);
         return false;
     }
 
     return true;
 }
 
-static bool
-packet_valpayld(packet_t* packet) {
-    uint32_t crc = crc32_generate(packet->payld, packet->payld_len);
+void
+packet_view_of(packet_view_t* view, const packet_t* packet) {
+    *view = (packet_view_t) {
+        .frame = NULL,
+        .len = PACKET_SIZE_MIN + packet->payld_len,
+        .payld_len = packet->payld_len,
+        .flags = packet->flags,
+        .crc = packet->crc,
+        .nonce = packet->nonce,
+        .timestamp = packet->timestamp,
+        .usrname = packet_str_of(packet->usrname),
+        .options = packet_str_of(packet->options),
+        .payld = {.ptr = packet->payld, .len = packet->payld_len},
+    };
+}
 
-    if (packet->crc != crc) {
-        error_log("packet err: corrupt crc, (expected %08x, got %08x)");
-        return false;
+void
+packet_view_copy(const packet_view_t* view, packet_t* packet) {
+    *packet = (packet_t) {0};                   /* zeroed, names are copied around whole */
+
+#define PACKET_COPY(NAME, field, size, kind) PACKET_COPY_##kind(packet->field, view->field);
+    PACKET_HEAD(PACKET_COPY)
+#undef PACKET_COPY
+
+    packet_str_copy(view->payld, packet->payld);
+
+    if (view->unchecked && view->payld.len > 0) {   /* a v1 frame carries one, so it is worked out now */
+        packet->crc = crc32_generate(packet->payld, packet->payld_len);
     }
+}
 
-    return true;
+bool
+packet_str_eq(packet_str_t str, const char* cstr) {
+    return strncmp(str.ptr, cstr, str.len) == 0 && cstr[str.len] == '\0';
+}
+
+void
+packet_str_copy(packet_str_t str, char* dst) {
+    memcpy(dst, str.ptr, str.len);
+    dst[str.len] = '\0';
 }
 
 /*** recv ***/
@@ -148,6 +276,11 @@ magic_find(const uint8_t* noise, const uint8_t* magic, unsigned noise_size, unsi
     return NULL;
 }
 
+const uint8_t*
+packet_find_magic(const uint8_t* buf, unsigned len) {
+    return magic_find(buf, (const uint8_t*)PACKET_MAGIC, len, SIZE_MAGIC);
+}
+
 static int
 packet_recvhead(int sockfd, uint8_t* packet_buf, int max_resyncs) {
     int bytes = 0;
@@ -160,7 +293,7 @@ packet_recvhead(int sockfd, uint8_t* packet_buf, int max_resyncs) {
         return bytes;
     }
 
-    magic_pos = magic_find(packet_buf, (const uint8_t*)PACKET_MAGIC, PACKET_SIZE_MIN, SIZE_MAGIC);
+    magic_pos = packet_find_magic(packet_buf, PACKET_SIZE_MIN);
 
     for (int resync = 0; magic_pos == NULL; ++resync) {
         if (max_resyncs >= 0 && resync > max_resyncs) {
@@ -175,7 +308,7 @@ packet_recvhead(int sockfd, uint8_t* packet_buf, int max_resyncs) {
             return bytes;
         }
 
-        magic_pos = magic_find(packet_buf, (const uint8_t*)PACKET_MAGIC, PACKET_SIZE_MIN, SIZE_MAGIC);
+        magic_pos = packet_find_magic(packet_buf, PACKET_SIZE_MIN);
     }
 
     unsigned noise_size = (unsigned)(magic_pos - packet_buf);
@@ -219,7 +352,7 @@ packet_seal(packet_t* packet, uint8_t flags) {
     packet->nonce += 1;
     packet->timestamp = (uint64_t)tm;
 
-    if (flags & PACKET_FLAG_MSG) {
+    if (flags & (PACKET_FLAG_MSG | PACKET_FLAG_JOIN | PACKET_FLAG_DISC | PACKET_FLAG_ACK) || flags == PACKET_FLAG_HELO) {  /* the crc of nothing is 0 */
         packet->payld_len = (uint8_t)strlen(packet->payld);
         packet->crc = crc32_generate(packet->payld, packet->payld_len);
     } else {
@@ -230,47 +363,75 @@ packet_seal(packet_t* packet, uint8_t flags) {
 
 int
 packet_send(const packet_t* packet, int sockfd) {
-    uint8_t packet_buf[PACKET_SIZE_MAX] = {0};
+    return packet_sendv(packet, 1, sockfd);
+}
 
-    packet_encode(packet, packet_buf);
+int
+packet_sendv(const packet_t* packets, unsigned count, int sockfd) {
+    uint8_t heads[PACKET_BATCH_MAX][PACKET_SIZE_MIN];
+    struct iovec iov[PACKET_BATCH_MAX * 2];
+
+    int sent = 0;
+
+    for (unsigned base = 0; base < count; base += PACKET_BATCH_MAX) {
+        unsigned batch = count - base < PACKET_BATCH_MAX ? count - base : PACKET_BATCH_MAX;
+        int iovcnt = 0;
+
+        for (unsigned i = 0; i < batch; ++i) {  /* headers are encoded, payloads are sent in place */
+            const packet_t* packet = &packets[base + i];
 
-    return sendall(sockfd, packet_buf, PACKET_SIZE_MIN + packet_buf[OFFSET_PAYLD_LEN]);
+            packet_encode_head(packet, heads[i]);
+
+            iov[iovcnt++] = (struct iovec) {.iov_base = heads[i], .iov_len = PACKET_SIZE_MIN};
+
+            if (packet->payld_len > 0) {
+                iov[iovcnt++] = (struct iovec) {.iov_base = (char*)packet->payld, .iov_len = packet->payld_len};
+            }
+        }
+
+        int bytes = sendallv(sockfd, iov, iovcnt);
+
+        if (bytes <= 0) {
+            return bytes;
+        }
+
+        sent += bytes;
+    }
+
+    return sent;
 }
 
 int
 packet_recv(packet_t* packet, int sockfd, int max_resyncs) {
-    uint8_t packet_buf[PACKET_SIZE_MIN] = {0};
+    uint8_t packet_buf[PACKET_SIZE_MAX] = {0};
+    packet_view_t view;
 
     int bytes_head = 0;
     int bytes_payld = 0;
 
-    memset(packet, 0, sizeof(packet_t));
-
     bytes_head = packet_recvhead(sockfd, packet_buf, max_resyncs);
 
     if (bytes_head <= 0) {
         return bytes_head;
     }
 
-    packet_decode(packet, packet_buf);
-
-    if (!packet_valhead(packet)) {
+    if (!packet_view_head(&view, packet_buf)) {
         return RECV_INVAL;
     }
 
-    if (packet->payld_len == 0) {
-        return bytes_head;
-    }
+    if (view.payld.len > 0) {
+        bytes_payld = recvall(sockfd, packet_buf + PACKET_SIZE_MIN, view.payld.len);
 
-    bytes_payld = recvall(sockfd, (uint8_t*)packet->payld, packet->payld_len);
+        if (bytes_payld <= 0) {
+            return bytes_payld;
+        }
 
-    if (bytes_payld <= 0) {
-        return bytes_payld;
+        if (!packet_view_payld(&view)) {
+            return RECV_INVAL;
+        }
     }
 
-    if (!packet_valpayld(packet)) {
-        return RECV_INVAL;
-    }
+    packet_view_copy(&view, packet);
 
     return bytes_head + bytes_payld;
 }
@@ -290,6 +451,187 @@ packet_build_pong(packet_t* ping) {
     ping->flags = PACKET_FLAG_PONG;
 }
 
+void
+packet_set_resume(packet_t* packet, const packet_resume_t* resume) {
+    snprintf(packet->payld, sizeof(packet->payld), "%016" PRIx64 " %016" PRIx64 " %s",
+            resume->token, resume->nonce, resume->usrname);
+}
+
+static bool
+packet_get_hex(const char** str, uint64_t* value) {
+    char* end;
+
+    if (strlen(*str) < SIZE_NONCE * 2 + 1 || (*str)[SIZE_NONCE * 2] != ' ') {
+        return false;
+    }
+
+    errno = 0;
+    *value = strtoull(*str, &end, 16);
+
+    if (errno != 0 || end != *str + SIZE_NONCE * 2) {
+        return false;
+    }
+
+    *str = end + 1;
+
+    return true;
+}
+
+bool
+packet_get_resume(const packet_t* packet, packet_resume_t* resume) {
+    const char* str = packet->payld;
+
+    if (packet->payld_len == 0) {
+        return false;
+    }
+
+    if (!packet_get_hex(&str, &resume->token) || !packet_get_hex(&str, &resume->nonce)) {
+        return false;
+    }
+
+    size_t len = strlen(str);                   /* usernames may hold spaces, so it goes last */
+
+    if (len > SIZE_USRNAME) {
+        return false;
+    }
+
+    memcpy(resume->usrname, str, len + 1);
+
+    return true;
+}
+
+void
+packet_set_retry(packet_t* packet, const packet_retry_t* retry) {
+    snprintf(packet->payld, sizeof(packet->payld), "%" PRIu32 " %" PRIu32, retry->after_ms, retry->jitter_ms);
+}
+
+static bool
+packet_get_dec(const char** str, char end, uint32_t* value) {
+    char* stop;
+
+    if (**str < '0' || **str > '9') {           /* strtoul would take a sign or spaces */
+        return false;
+    }
+
+    errno = 0;
+    unsigned long dec = strtoul(*str, &stop, 10);
+
+    if (errno != 0 || *stop != end || dec > UINT32_MAX) {
+        return false;
+    }
+
+    *value = (uint32_t)dec;
+    *str = stop + 1;
+
+    return true;
+}
+
+bool
+packet_get_retry(const packet_t* packet, packet_retry_t* retry) {
+    const char* str = packet->payld;
+
+    if (packet->flags != PACKET_FLAG_DISC || packet->payld_len == 0) {
+        return false;
+    }
+
+    return packet_get_dec(&str, ' ', &retry->after_ms) && packet_get_dec(&str, '\0', &retry->jitter_ms);
+}
+
+static void
+packet_put_names(char* buf, size_t size, uint32_t mask, const char* const* names, unsigned count) {
+    size_t used = 0;
+
+    buf[0] = '\0';
+
+    for (unsigned i = 0; i < count; ++i) {
+        if (mask & (1u << i)) {
+            used += (size_t)snprintf(buf + used, size - used, "%s%s", used > 0 ? "," : "", names[i]);
+        }
+    }
+}
+
+void
+packet_set_hello(packet_t* packet, const packet_hello_t* hello) {
+    char checksum[32];
+    char compress[32];
+
+    packet_put_names(checksum, sizeof(checksum), hello->checksum, PACKET_CHECKSUM_NAMES, PACKET_NAMES_LEN(PACKET_CHECKSUM_NAMES));
+    packet_put_names(compress, sizeof(compress), hello->compress, PACKET_COMPRESS_NAMES, PACKET_NAMES_LEN(PACKET_COMPRESS_NAMES));
+
+    snprintf(packet->payld, sizeof(packet->payld), "version=%" PRIu32 " frame=%" PRIu32 " checksum=%s compress=%s batch=%" PRIu32,
+            hello->version, hello->frame_max, checksum, compress, hello->batch);
+}
+
+static const char*
+packet_get_key(const char* str, const char* key) {
+    size_t len = strlen(key);
+
+    while (*str != '\0') {
+        if (strncmp(str, key, len) == 0 && str[len] == '=') {
+            return str + len + 1;
+        }
+
+        str += strcspn(str, " ");               /* a newer peer's key, skipped */
+        str += strspn(str, " ");
+    }
+
+    return NULL;
+}
+
+static bool
+packet_get_num(const char* payld, const char* key, uint32_t* value) {
+    const char* str = packet_get_key(payld, key);
+
+    return str == NULL || packet_get_dec(&str, str[strcspn(str, " ")], value);
+}
+
+static void
+packet_get_names(const char* payld, const char* key, const char* const* names, unsigned count, uint32_t* mask) {
+    const char* str = packet_get_key(payld, key);
+
+    if (str == NULL) {
+        return;
+    }
+
+    *mask = 0;
+
+    while (*str != '\0' && *str != ' ') {
+        size_t len = strcspn(str, ", ");
+
+        for (unsigned i = 0; i < count; ++i) {
+            if (strlen(names[i]) == len && strncmp(str, names[i], len) == 0) {
+                *mask |= 1u << i;
+            }
+        }
+
+        str += len;
+        str += *str == ',';
+    }
+}
+
+bool
+packet_get_hello(const packet_t* packet, packet_hello_t* hello) {
+    const char* payld = packet->payld;
+
+    if (packet->flags != PACKET_FLAG_HELO || packet_get_key(payld, "version") == NULL) {
+        return false;
+    }
+
+    *hello = (packet_hello_t) {                 /* what a peer that does not say otherwise speaks */
+        .version = 0,
+        .frame_max = PACKET_SIZE_MAX,
+        .checksum = PACKET_CHECKSUM_CRC32,
+        .compress = PACKET_COMPRESS_NONE,
+        .batch = PACKET_ACK_MAX,
+    };
+
+    packet_get_names(payld, "checksum", PACKET_CHECKSUM_NAMES, PACKET_NAMES_LEN(PACKET_CHECKSUM_NAMES), &hello->checksum);
+    packet_get_names(payld, "compress", PACKET_COMPRESS_NAMES, PACKET_NAMES_LEN(PACKET_COMPRESS_NAMES), &hello->compress);
+
+    return packet_get_num(payld, "version", &hello->version) && packet_get_num(payld, "frame", &hello->frame_max)
+            && packet_get_num(payld, "batch", &hello->batch) && hello->version > 0;
+}
+
 void
 packet_build_ack(packet_t* packet) {
     packet->flags = PACKET_FLAG_ACK;
@@ -299,3 +641,57 @@ packet_build_ack(packet_t* packet) {
     memset(packet->payld, 0, sizeof(packet->payld));
 }
 
+void
+packet_set_acks(packet_t* packet, const packet_ack_t* acks, unsigned count) {
+    size_t used = 0;
+
+    memset(packet->payld, 0, sizeof(packet->payld));
+
+    for (unsigned i = 0; i < count && i < PACKET_ACK_MAX; ++i) {
+        used += (size_t)snprintf(packet->payld + used, sizeof(packet->payld) - used, "%s%" PRIx64 " %" PRIx32,
+                i > 0 ? " " : "", acks[i].first, acks[i].count);
+    }
+}
+
+static bool
+packet_get_run(const char** str, packet_ack_t* ack) {
+    char* end;
+
+    if (!isxdigit((unsigned char)**str)) {
+        return false;
+    }
+
+    errno = 0;
+    ack->first = strtoull(*str, &end, 16);
+
+    if (errno != 0 || *end != ' ' || !isxdigit((unsigned char)end[1])) {
+        return false;
+    }
+
+    unsigned long long count = strtoull(end + 1, &end, 16);
+
+    if (errno != 0 || count == 0 || count > UINT32_MAX || (*end != ' ' && *end != '\0')) {
+        return false;
+    }
+
+    ack->count = (uint32_t)count;
+    *str = *end == ' ' ? end + 1 : end;
+
+    return true;
+}
+
+unsigned
+packet_get_acks(const packet_t* packet, packet_ack_t* acks, unsigned max) {
+    const char* str = packet->payld;
+    unsigned count = 0;
+
+    if (packet->flags != PACKET_FLAG_ACK) {
+        return 0;
+    }
+
+    while (*str != '\0' && count < max && packet_get_run(&str, &acks[count])) {
+        count += 1;
+    }
+
+    return count;
+}
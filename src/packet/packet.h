@@ -2,12 +2,17 @@
 #if !defined(PACKET_H)
 #define PACKET_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <time.h>
 
 #include "../net/net.h"
 
 #define RESYNC_NOLIMIT -1
+#define PACKET_BATCH_MAX 32
+#define PACKET_ACK_MAX 8                        /* runs in one ACK, each at most 26 bytes of payload */
+#define PACKET_SERVER_USRNAME "*"               /* presence and pacing speak for the server, yet a frame needs a name */
 
 typedef enum {
     RECV_DISCONN =  0,
@@ -16,30 +21,40 @@ typedef enum {
     RECV_DESYNC  = -3,
 } packet_recv_err_t;
 
+/* the header in wire order, its sizes, offsets, codec and checks are all generated from here:
+ * X(NAME, field, size, kind), kind is MAGIC, STR (NUL padded), U8, U32 or U64 (big endian) */
+#define PACKET_HEAD(X)                                  \
+    X(MAGIC,     magic,      6, MAGIC)                  \
+    X(USRNAME,   usrname,   10, STR)                    \
+    X(PAYLD_LEN, payld_len,  1, U8)                     \
+    X(FLAGS,     flags,      1, U8)                     \
+    X(CRC,       crc,        4, U32)                    \
+    X(OPTIONS,   options,   10, STR)                    \
+    X(NONCE,     nonce,      8, U64)                    \
+    X(TIMESTAMP, timestamp,  8, U64)
+
+#define PACKET_HEAD_SIZE(NAME, field, size, kind) SIZE_##NAME = (size),
+#define PACKET_HEAD_BYTES(NAME, field, size, kind) uint8_t field[size];
+#define PACKET_HEAD_OFFSET(NAME, field, size, kind) OFFSET_##NAME = offsetof(packet_head_layout_t, field),
+
 typedef enum {
-    SIZE_MAGIC     = 6,
-    SIZE_USRNAME   = 10,
-    SIZE_PAYLD_LEN = 1,
-    SIZE_FLAGS     = 1,
-    SIZE_CRC       = 4,
-    SIZE_OPTIONS   = 10,
-    SIZE_NONCE     = 8,
-    SIZE_TIMESTAMP = 8,
+    PACKET_HEAD(PACKET_HEAD_SIZE)
     SIZE_PAYLD     = 255,
 } packet_field_size_t;
 
+typedef struct packet_head_layout {             /* only ever measured, bytes so it has no padding */
+    PACKET_HEAD(PACKET_HEAD_BYTES)
+} packet_head_layout_t;
+
 typedef enum {
-    OFFSET_MAGIC     = 0,
-    OFFSET_USRNAME   = OFFSET_MAGIC     + SIZE_MAGIC,
-    OFFSET_PAYLD_LEN = OFFSET_USRNAME   + SIZE_USRNAME,
-    OFFSET_FLAGS     = OFFSET_PAYLD_LEN + SIZE_PAYLD_LEN,
-    OFFSET_CRC       = OFFSET_FLAGS     + SIZE_FLAGS,
-    OFFSET_OPTIONS   = OFFSET_CRC       + SIZE_CRC,
-    OFFSET_NONCE     = OFFSET_OPTIONS   + SIZE_OPTIONS,
-    OFFSET_TIMESTAMP = OFFSET_NONCE     + SIZE_NONCE,
-    OFFSET_PAYLD     = OFFSET_TIMESTAMP + SIZE_TIMESTAMP,
+    PACKET_HEAD(PACKET_HEAD_OFFSET)
+    OFFSET_PAYLD     = sizeof(packet_head_layout_t),
 } packet_field_offset_t;
 
+#undef PACKET_HEAD_SIZE
+#undef PACKET_HEAD_BYTES
+#undef PACKET_HEAD_OFFSET
+
 typedef enum {
     PACKET_SIZE_MIN = OFFSET_PAYLD,
     PACKET_SIZE_MAX = (int)PACKET_SIZE_MIN + (int)SIZE_PAYLD,
@@ -54,6 +69,8 @@ typedef enum {
     PACKET_FLAG_DISC = 1 << 5,
     PACKET_FLAG_PING = 1 << 6,
     PACKET_FLAG_PONG = 1 << 7,
+    PACKET_FLAG_ROST = PACKET_FLAG_JOIN | PACKET_FLAG_EXIT, /* presence, only ever from the server */
+    PACKET_FLAG_HELO = PACKET_FLAG_PING | PACKET_FLAG_PONG, /* version negotiation, hop by hop like a ping */
 } packet_flags_t;
 
 typedef struct packet {
@@ -67,6 +84,71 @@ typedef struct packet {
     char payld[SIZE_PAYLD + 1];
 } packet_t;
 
+/* a run of bytes inside a frame, not NUL terminated */
+typedef struct packet_str {
+    const char* ptr;
+    unsigned len;
+} packet_str_t;
+
+/* a frame validated where it lies, nothing is copied out of the buffer it points into */
+typedef struct packet_view {
+    const uint8_t* frame;                       /* v1 header then payload, NULL for a packet_t or a v2 frame */
+    unsigned len;                               /* of the whole frame */
+    uint8_t payld_len;
+    uint8_t flags;
+    uint32_t crc;
+    bool unchecked;                             /* from a v2 frame without one, crc is 0 until packet_view_copy */
+    uint64_t nonce;
+    uint64_t timestamp;
+    packet_str_t usrname;
+    packet_str_t options;
+    packet_str_t payld;
+} packet_view_t;
+
+/* a ROST payload is "=<members>" for a room snapshot or "+<joined> -<left>" for a delta, then
+ * "\n<name>", or "\n+<name>" and "\n-<name>", for as many as fit, the counts are always exact */
+
+/* a JOIN payload: from a client resuming and catching up, from the server handing out a token */
+typedef struct packet_resume {
+    uint64_t token;                             /* from the server's last notice, 0 when none */
+    uint64_t nonce;                             /* of the last message rendered */
+    char usrname[SIZE_USRNAME + 1];             /* its sender, empty when nothing was */
+} packet_resume_t;
+
+/* an ACK payload: "<first> <count>" per run of messages accepted, in hex and space separated */
+typedef struct packet_ack {
+    uint64_t first;                             /* nonce of the first message accepted */
+    uint32_t count;                             /* and how many consecutive nonces follow from it */
+} packet_ack_t;
+
+/* a DISC payload: the server turning a connection away, "<after_ms> <jitter_ms>" in decimal */
+typedef struct packet_retry {
+    uint32_t after_ms;                          /* do not reconnect before this */
+    uint32_t jitter_ms;                         /* and spread the attempt over this much more */
+} packet_retry_t;
+
+
+typedef enum {
+    PACKET_CHECKSUM_NONE  = 1 << 0,             /* tcp's own, nothing in the frame */
+    PACKET_CHECKSUM_CRC32 = 1 << 1,
+} packet_checksum_t;
+
+typedef enum {
+    PACKET_COMPRESS_NONE = 1 << 0,
+} packet_compress_t;
+
+/* a HELO payload: "version=<n> frame=<bytes> checksum=<names> compress=<names> batch=<runs>", names
+ * comma separated, keys and names one end does not know are skipped, a missing key means what v1 does;
+ * a client offers what it speaks on every new socket, the server answers with what both will, the
+ * client confirms by sending it back */
+typedef struct packet_hello {
+    uint32_t version;                           /* the highest offered, or the one picked */
+    uint32_t frame_max;                         /* the largest frame it takes, in bytes */
+    uint32_t checksum;                          /* packet_checksum_t bits offered, exactly one once picked */
+    uint32_t compress;                          /* packet_compress_t bits, likewise */
+    uint32_t batch;                             /* ACK runs it parses out of one frame */
+} packet_hello_t;
+
 
 /*** make ***/
 
@@ -76,6 +158,42 @@ packet_build(const char* usrname);
 extern void
 packet_seal(packet_t* packet, uint8_t flags);
 
+/*** codec ***/
+
+extern void
+packet_encode(const packet_t* packet, uint8_t* buf);
+
+/*** view ***/
+
+extern void
+packet_view_load(packet_view_t* view, const uint8_t* buf);
+
+extern bool
+packet_view_head(packet_view_t* view, const uint8_t* buf);
+
+extern bool
+packet_view_valid(const packet_view_t* view);
+
+extern bool
+packet_view_payld(const packet_view_t* view);
+
+extern void
+packet_view_of(packet_view_t* view, const packet_t* packet);
+
+extern void
+packet_view_copy(const packet_view_t* view, packet_t* packet);
+
+extern bool
+packet_str_eq(packet_str_t str, const char* cstr);
+
+extern void
+packet_str_copy(packet_str_t str, char* dst);
+
+/*** validation ***/
+
+extern const uint8_t*
+packet_find_magic(const uint8_t* buf, unsigned len);
+
 /*** send/recv ***/
 
 extern int
@@ -84,6 +202,9 @@ packet_recv(packet_t* packet, int sockfd, int max_resyncs);
 extern int
 packet_send(const packet_t* packet, int sockfd);
 
+extern int
+packet_sendv(const packet_t* packets, unsigned count, int sockfd);
+
 /*** ping ***/
 
 extern packet_t
@@ -92,9 +213,39 @@ packet_build_ping(const char* usrname);
 extern void
 packet_build_pong(packet_t* ping);
 
+/*** resume ***/
+
+extern void
+packet_set_resume(packet_t* packet, const packet_resume_t* resume);
+
+extern bool
+packet_get_resume(const packet_t* packet, packet_resume_t* resume);
+
+/*** retry ***/
+
+extern void
+packet_set_retry(packet_t* packet, const packet_retry_t* retry);
+
+extern bool
+packet_get_retry(const packet_t* packet, packet_retry_t* retry);
+
+/*** hello ***/
+
+extern void
+packet_set_hello(packet_t* packet, const packet_hello_t* hello);
+
+extern bool
+packet_get_hello(const packet_t* packet, packet_hello_t* hello);
+
 /*** ack ***/
 
 extern void
 packet_build_ack(packet_t* packet);
 
+extern void
+packet_set_acks(packet_t* packet, const packet_ack_t* acks, unsigned count);
+
+extern unsigned
+packet_get_acks(const packet_t* packet, packet_ack_t* acks, unsigned max);
+
 #endif /* !defined(PACKET_H) */
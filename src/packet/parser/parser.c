@@ -0,0 +1,168 @@
+#include "parser.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+
+/*** aux ***/
+
+static void
+parser_reset(packet_parser_t* parser) {
+    parser->len = 0;
+    parser->need = PACKET_SIZE_MIN;
+    parser->state = PARSER_STATE_MAGIC;
+}
+
+static void
+parser_discard(packet_parser_t* parser, unsigned bytes) {
+    memmove(parser->buf, parser->buf + bytes, parser->len - bytes);
+
+    parser->len -= bytes;
+    parser->need = PACKET_SIZE_MIN;
+}
+
+static int
+parser_inplace(const uint8_t* data, size_t len, size_t* used, packet_view_t* view) {
+    if (!packet_view_head(view, data)) {        /* skip this magic, as the buffered path would */
+        *used = 1;
+        return PARSE_INVAL;
+    }
+
+    if (view->len > len) {
+        return PARSE_MORE;                      /* split across reads, it gets buffered */
+    }
+
+    *used = view->len;
+
+    return packet_view_payld(view) ? PARSE_FRAME : PARSE_INVAL;
+}
+
+
+/*** states ***/
+
+static void
+parser_step_magic(packet_parser_t* parser) {
+    const uint8_t* magic = packet_find_magic(parser->buf, parser->len);
+
+    if (magic == parser->buf) {
+        parser->state = PARSER_STATE_HEAD;
+        return;
+    }
+
+    parser->resyncs += 1;
+
+    if (magic == NULL) {                        /* keep a possible magic prefix at the tail */
+        parser_discard(parser, parser->len - (SIZE_MAGIC - 1));
+        return;
+    }
+
+    parser_discard(parser, (unsigned)(magic - parser->buf));
+    parser->state = PARSER_STATE_HEAD;
+}
+
+static int
+parser_step_head(packet_parser_t* parser, packet_view_t* view) {
+    if (!packet_view_head(view, parser->buf)) { /* skip this magic and look for the next one */
+        parser_discard(parser, 1);
+        parser->state = PARSER_STATE_MAGIC;
+
+        return PARSE_INVAL;
+    }
+
+    if (view->payld.len == 0) {
+        parser->state = PARSER_STATE_DONE;
+        return PARSE_FRAME;
+    }
+
+    parser->need = view->len;
+    parser->state = PARSER_STATE_PAYLD;
+
+    return PARSE_MORE;
+}
+
+static int
+parser_step_payld(packet_parser_t* parser, packet_view_t* view) {
+    if (!packet_view_head(view, parser->buf) || !packet_view_payld(view)) {  /* the caller's view is a new one */
+        parser_reset(parser);
+        return PARSE_INVAL;
+    }
+
+    parser->state = PARSER_STATE_DONE;
+
+    return PARSE_FRAME;
+}
+
+
+/*** methods ***/
+
+void
+packet_parser_init(packet_parser_t* parser) {
+    parser_reset(parser);
+    parser->resyncs = 0;
+}
+
+int
+packet_parser_feed(packet_parser_t* parser, const uint8_t* data, size_t len, size_t* used, packet_view_t* view) {
+    size_t off = 0;
+
+    if (parser->state == PARSER_STATE_DONE) {
+        parser_reset(parser);
+    }
+
+    if (parser->len == 0 && len >= PACKET_SIZE_MIN && packet_find_magic(data, SIZE_MAGIC) == data) {
+        int rv = parser_inplace(data, len, used, view);
+
+        if (rv == PARSE_FRAME) {
+            parser->resyncs = 0;
+        }
+
+        if (rv != PARSE_MORE) {
+            return rv;
+        }
+    }
+
+    while (true) {
+        if (parser->len < parser->need) {
+            size_t chunk = parser->need - parser->len;
+
+            if (chunk > len - off) {
+                chunk = len - off;
+            }
+
+            memcpy(parser->buf + parser->len, data + off, chunk);
+
+            parser->len += (unsigned)chunk;
+            off += chunk;
+
+            if (parser->len < parser->need) {
+                *used = off;
+                return PARSE_MORE;
+            }
+        }
+
+        int rv = PARSE_MORE;
+
+        switch (parser->state) {
+            case PARSER_STATE_MAGIC:
+                parser_step_magic(parser);
+                break;
+            case PARSER_STATE_HEAD:
+                rv = parser_step_head(parser, view);
+                break;
+            case PARSER_STATE_PAYLD:
+                rv = parser_step_payld(parser, view);
+                break;
+            case PARSER_STATE_DONE:
+                break;
+        }
+
+        if (rv == PARSE_FRAME) {
+            parser->resyncs = 0;
+        }
+
+        if (rv != PARSE_MORE) {
+            *used = off;
+            return rv;
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#if !defined(PARSER_H)
+#define PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../packet.h"
+
+/*** data ***/
+
+typedef enum {
+    PARSE_INVAL = RECV_INVAL,                   /* a corrupt frame was dropped, keep feeding */
+    PARSE_MORE  = 0,                            /* input exhausted before a frame completed */
+    PARSE_FRAME = 1,                            /* a complete and valid frame is viewed, until the next feed */
+} packet_parse_t;
+
+typedef enum {
+    PARSER_STATE_MAGIC,                         /* hunting for the magic number */
+    PARSER_STATE_HEAD,                          /* buffer starts with magic, reading the header */
+    PARSER_STATE_PAYLD,                         /* header validated, reading the payload */
+    PARSER_STATE_DONE,                          /* a frame sits in the buffer until the next feed */
+} packet_parser_state_t;
+
+typedef struct packet_parser {
+    uint8_t buf[PACKET_SIZE_MAX];
+    unsigned len;
+    unsigned need;                              /* bytes the current state waits for */
+    unsigned resyncs;                           /* noise windows discarded since the last frame */
+    packet_parser_state_t state;
+} packet_parser_t;
+
+
+/*** methods ***/
+
+extern void
+packet_parser_init(packet_parser_t* parser);
+
+extern int
+packet_parser_feed(packet_parser_t* parser, const uint8_t* data, size_t len, size_t* used, packet_view_t* view);
+
+#endif /* !defined(PARSER_H) */
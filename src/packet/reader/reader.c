@@ -0,0 +1,101 @@
+#include "reader.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+
+#include "../../error/error.h"
+
+
+/*** aux ***/
+
+static int
+reader_fill(packet_reader_t* reader, int sockfd) {
+    ssize_t n;
+
+    do {
+        n = recv(sockfd, reader->buf, sizeof(reader->buf), 0);
+    } while (n == -1 && errno == EINTR);
+
+    if (n == 0) {
+        return RECV_DISCONN;
+    }
+
+    if (n < 0) {
+        return RECV_ERROR;
+    }
+
+    reader->off = 0;
+    reader->len = (size_t)n;
+
+    return (int)n;
+}
+
+
+/*** methods ***/
+
+void
+packet_reader_init(packet_reader_t** reader, int max_resyncs) {
+    *reader = malloc(sizeof(packet_reader_t));
+
+    if (*reader == NULL) {
+        error_shutdown("reader err: malloc");
+    }
+
+    (*reader)->max_resyncs = max_resyncs;
+
+    packet_reader_reset(*reader);
+}
+
+void
+packet_reader_free(packet_reader_t* reader) {
+    free(reader);
+}
+
+void
+packet_reader_reset(packet_reader_t* reader) {
+    reader->off = 0;
+    reader->len = 0;
+
+    packet_parser_init(&reader->parser);        /* a new socket starts at a frame boundary */
+    reader->version = WIRE_V1;
+}
+
+void
+packet_reader_upgrade(packet_reader_t* reader, const wire_caps_t* caps) {
+    reader->version = caps->version;            /* what is still buffered is past the HELO, so v2 already */
+    wire_decoder_init(&reader->wire, caps);
+}
+
+int
+packet_reader_next(packet_reader_t* reader, packet_view_t* view, int sockfd) {
+    while (true) {
+        if (reader->off == reader->len) {       /* one recv for as many frames as arrived */
+            int rv = reader_fill(reader, sockfd);
+
+            if (rv <= 0) {
+                return rv;
+            }
+        }
+
+        size_t used = 0;
+        const uint8_t* data = reader->buf + reader->off;
+        int rv = reader->version == WIRE_V2 ? wire_feed(&reader->wire, data, reader->len - reader->off, &used, view)
+                : packet_parser_feed(&reader->parser, data, reader->len - reader->off, &used, view);
+
+        reader->off += used;
+
+        if (rv == PARSE_FRAME) {                /* in buf, or the parser's when split across reads */
+            return (int)view->len;
+        }
+
+        if (rv == PARSE_INVAL) {                /* a v2 stream has no magic to resync on */
+            return reader->version == WIRE_V2 ? RECV_DESYNC : RECV_INVAL;
+        }
+
+        if (reader->max_resyncs >= 0 && reader->parser.resyncs > (unsigned)reader->max_resyncs) {
+            packet_parser_init(&reader->parser);
+            return RECV_DESYNC;
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#if !defined(READER_H)
+#define READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../packet.h"
+#include "../parser/parser.h"
+#include "../wire/wire.h"
+
+/*** data ***/
+
+#define PACKET_READER_SIZE (1 << 16)            /* a backfill burst is a couple hundred frames per recv */
+
+/* a blocking socket read in bulk, handed out one view at a time, each valid until the next call */
+typedef struct packet_reader {
+    uint8_t buf[PACKET_READER_SIZE];
+    size_t off;                                 /* bytes already fed to the parser */
+    size_t len;
+    int max_resyncs;                            /* RESYNC_NOLIMIT, or noise windows skipped before giving up */
+    packet_parser_t parser;                     /* keeps a frame split across two reads */
+    wire_version_t version;                     /* v1 on every new socket, until a HELO settles on v2 */
+    wire_decoder_t wire;                        /* the parser's counterpart once it has */
+} packet_reader_t;
+
+
+/*** methods ***/
+
+extern void
+packet_reader_init(packet_reader_t** reader, int max_resyncs);
+
+extern void
+packet_reader_free(packet_reader_t* reader);
+
+extern void
+packet_reader_reset(packet_reader_t* reader);
+
+extern void
+packet_reader_upgrade(packet_reader_t* reader, const wire_caps_t* caps);
+
+extern int
+packet_reader_next(packet_reader_t* reader, packet_view_t* view, int sockfd);
+
+#endif /* !defined(READER_H) */
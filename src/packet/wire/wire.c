@@ -0,0 +1,483 @@
+#include "wire.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "../parser/parser.h"
+#include "../../error/error.h"
+#include "../../serialize/serialize.h"
+
+_Static_assert(WIRE_EXT_MAX < 0x80, "ext_len always fits a one byte varint");
+_Static_assert(WIRE_SIZE_MAX < 0x4000, "len always fits a two byte varint");
+_Static_assert(WIRE_DEFINE_MAX < 0x80, "a definition's len always fits a one byte varint");
+
+#define WIRE_REBASE (1u << 14)                  /* a nonce delta from here on takes a third byte */
+
+
+/*** varints ***/
+
+static unsigned
+wire_put_varint(uint8_t* buf, uint64_t value) {
+    unsigned len = 0;
+
+    while (value >= 0x80) {
+        buf[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+
+    buf[len++] = (uint8_t)value;
+
+    return len;
+}
+
+static bool
+wire_get_varint(const uint8_t** buf, const uint8_t* end, uint64_t* value) {
+    *value = 0;
+
+    for (unsigned shift = 0; shift < 7 * WIRE_VARINT64_MAX && *buf < end; shift += 7) {
+        uint8_t byte = *(*buf)++;
+
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static uint64_t
+wire_zigzag(uint64_t delta) {
+    return (delta << 1) ^ (0 - (delta >> 63));
+}
+
+static uint64_t
+wire_unzigzag(uint64_t value) {
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+
+/*** aux ***/
+
+static unsigned
+wire_put_ext(uint8_t* buf, wire_ext_t tag, packet_str_t str) {
+    buf[0] = (uint8_t)tag;
+    buf[1] = (uint8_t)str.len;
+    memcpy(buf + 2, str.ptr, str.len);
+
+    return 2 + str.len;
+}
+
+static bool
+wire_get_str(const uint8_t* value, unsigned len, unsigned size, char* dst) {
+    if (len > size || memchr(value, '\0', len) != NULL) {
+        return false;
+    }
+
+    memset(dst, 0, size + 1);                   /* padded as on a v1 wire, the sanitization checks hold */
+    memcpy(dst, value, len);
+
+    return true;
+}
+
+static bool
+wire_get_ext(wire_stream_t* stream, const uint8_t* buf, const uint8_t* end, bool* named) {
+    *named = false;
+
+    memset(stream->usrname, 0, sizeof(stream->usrname));
+    memset(stream->options, 0, sizeof(stream->options));
+
+    while (buf < end) {
+        if (end - buf < 2 || buf[1] > end - buf - 2) {
+            return false;
+        }
+
+        const uint8_t* value = buf + 2;
+        unsigned len = buf[1];
+
+        switch (buf[0]) {
+            case WIRE_EXT_NAME:
+                if (len == 0 || !wire_get_str(value, len, SIZE_USRNAME, stream->usrname)) {
+                    return false;
+                }
+
+                *named = true;
+                break;
+            case WIRE_EXT_OPTIONS:
+                if (!wire_get_str(value, len, SIZE_OPTIONS, stream->options)) {
+                    return false;
+                }
+                break;
+            default:                            /* from a newer peer, meaningless here */
+                break;
+        }
+
+        buf = value + len;
+    }
+
+    return true;
+}
+
+static int
+wire_learn(wire_stream_t* stream, uint32_t sender, uint64_t base, bool named, bool bare) {
+    if (sender == 0 || !named || !bare) {
+        error_log("wire err: malformed definition of sender %u", sender);
+        return PARSE_INVAL;
+    }
+
+    wire_slot_t* slot = &stream->slots[sender % WIRE_SLOTS];
+
+    *slot = (wire_slot_t) {.sender = sender, .used = true, .base = base};
+    memcpy(slot->usrname, stream->usrname, sizeof(slot->usrname));
+
+    return PARSE_MORE;                          /* consumed, but nothing to hand out */
+}
+
+static int
+wire_frame(const uint8_t* buf, size_t len, unsigned frame_max, unsigned* need) {
+    const uint8_t* ptr = buf;
+    uint64_t body;
+
+    if (!wire_get_varint(&ptr, buf + (len < 2 ? len : 2), &body)) {
+        return len < 2 ? PARSE_MORE : PARSE_INVAL;
+    }
+
+    if (body == 0 || body > frame_max - (unsigned)(ptr - buf)) {
+        error_log("wire err: frame of %llu bytes", (unsigned long long)body);
+        return PARSE_INVAL;
+    }
+
+    *need = (unsigned)(ptr - buf) + (unsigned)body;
+
+    return PARSE_FRAME;
+}
+
+static inline int
+wire_decode_with(wire_stream_t* stream, const uint8_t* buf, unsigned len, packet_view_t* view, bool checked) {
+    const uint8_t* end = buf + len;
+    uint64_t body, sender, nonce, timestamp, ext;
+    bool named;
+
+    (void)wire_get_varint(&buf, end, &body);    /* measured by wire_frame */
+
+    if (buf == end) {
+        return PARSE_INVAL;
+    }
+
+    uint8_t type = *buf++;
+
+    if (!wire_get_varint(&buf, end, &sender) || sender > UINT32_MAX
+            || !wire_get_varint(&buf, end, &nonce)
+            || !wire_get_varint(&buf, end, &timestamp)
+            || !wire_get_varint(&buf, end, &ext) || ext > (uint64_t)(end - buf)
+            || !wire_get_ext(stream, buf, buf + ext, &named)) {
+        error_log("wire err: malformed header");
+        return PARSE_INVAL;
+    }
+
+    buf += ext;
+
+    if (type == WIRE_DEFINE) {
+        return wire_learn(stream, (uint32_t)sender, wire_unzigzag(nonce), named, buf == end);
+    }
+
+    const wire_slot_t* slot = &stream->slots[sender % WIRE_SLOTS];
+    bool defined = slot->used && slot->sender == sender;
+
+    if (sender == 0 ? !named : named || !defined) {
+        error_log("wire err: sender %u was never defined", (unsigned)sender);
+        return PARSE_INVAL;
+    }
+
+    unsigned payld_len = (unsigned)(end - buf);
+    uint32_t crc = 0;
+
+    if (checked && payld_len > 0) {
+        if (payld_len <= SIZE_CRC) {
+            error_log("wire err: payload of %u bytes", payld_len);
+            return PARSE_INVAL;
+        }
+
+        unpack_u32(&crc, buf);
+
+        buf += SIZE_CRC;
+        payld_len -= SIZE_CRC;
+    }
+
+    if (payld_len > SIZE_PAYLD) {
+        error_log("wire err: payload of %u bytes", payld_len);
+        return PARSE_INVAL;
+    }
+
+    const char* usrname = sender == 0 ? stream->usrname : slot->usrname;
+
+    *view = (packet_view_t) {
+        .frame = NULL,
+        .len = len,
+        .payld_len = (uint8_t)payld_len,
+        .flags = type,
+        .crc = crc,
+        .unchecked = !checked,
+        .nonce = (sender == 0 ? 0 : slot->base) + wire_unzigzag(nonce),
+        .timestamp = WIRE_EPOCH + wire_unzigzag(timestamp),
+        .usrname = {.ptr = usrname, .len = (unsigned)strlen(usrname)},
+        .options = {.ptr = stream->options, .len = (unsigned)strlen(stream->options)},
+        .payld = {.ptr = (const char*)buf, .len = payld_len},
+    };
+
+    if (!packet_view_valid(view) || (checked && payld_len > 0 && !packet_view_payld(view))) {
+        return PARSE_INVAL;
+    }
+
+    return PARSE_FRAME;
+}
+
+static int
+wire_decode_crc32(wire_stream_t* stream, const uint8_t* buf, unsigned len, packet_view_t* view) {
+    return wire_decode_with(stream, buf, len, view, true);
+}
+
+static int
+wire_decode_bare(wire_stream_t* stream, const uint8_t* buf, unsigned len, packet_view_t* view) {
+    return wire_decode_with(stream, buf, len, view, false);
+}
+
+static inline unsigned
+wire_encode_with(const packet_view_t* view, uint32_t sender, uint64_t base, uint8_t* buf, bool checked) {
+    uint8_t head[WIRE_HEAD_MAX];
+    bool named = sender == 0;
+    unsigned ext = (named ? 2 + view->usrname.len : 0) + (view->options.len > 0 ? 2 + view->options.len : 0);
+    unsigned len = 0;
+
+    head[len++] = view->flags;
+    len += wire_put_varint(head + len, sender);
+    len += wire_put_varint(head + len, wire_zigzag(view->nonce - (named ? 0 : base)));
+    len += wire_put_varint(head + len, wire_zigzag(view->timestamp - WIRE_EPOCH));
+    len += wire_put_varint(head + len, ext);
+
+    if (named) {
+        len += wire_put_ext(head + len, WIRE_EXT_NAME, view->usrname);
+    }
+
+    if (view->options.len > 0) {
+        len += wire_put_ext(head + len, WIRE_EXT_OPTIONS, view->options);
+    }
+
+    if (checked && view->payld.len > 0) {       /* the crc of nothing is 0, it is left out */
+        pack_u32(head + len, view->crc);
+        len += SIZE_CRC;
+    }
+
+    unsigned off = wire_put_varint(buf, len + view->payld.len);
+
+    memcpy(buf + off, head, len);
+    memcpy(buf + off + len, view->payld.ptr, view->payld.len);
+
+    return off + len + view->payld.len;
+}
+
+static unsigned
+wire_encode_crc32(const packet_view_t* view, uint32_t sender, uint64_t base, uint8_t* buf) {
+    return wire_encode_with(view, sender, base, buf, true);
+}
+
+static unsigned
+wire_encode_bare(const packet_view_t* view, uint32_t sender, uint64_t base, uint8_t* buf) {
+    return wire_encode_with(view, sender, base, buf, false);
+}
+
+
+/*** caps ***/
+
+wire_caps_t
+wire_caps_v1(void) {
+    return (wire_caps_t) {                      /* the fixed layout, for peers that never say HELO */
+        .version = WIRE_V1,
+        .frame_max = PACKET_SIZE_MAX,
+        .checksum = PACKET_CHECKSUM_CRC32,
+        .compress = PACKET_COMPRESS_NONE,
+        .batch = PACKET_ACK_MAX,
+    };
+}
+
+void
+wire_offer(packet_hello_t* offer) {
+    *offer = (packet_hello_t) {
+        .version = WIRE_V2,
+        .frame_max = WIRE_SIZE_MAX,
+        .checksum = PACKET_CHECKSUM_NONE | PACKET_CHECKSUM_CRC32,
+        .compress = PACKET_COMPRESS_NONE,
+        .batch = PACKET_ACK_MAX,
+    };
+}
+
+bool
+wire_pick(const packet_hello_t* offer, packet_checksum_t prefer, wire_caps_t* caps) {
+    packet_hello_t ours;
+
+    wire_offer(&ours);
+
+    *caps = wire_caps_v1();
+
+    if (offer->batch > 0 && offer->batch < caps->batch) {
+        caps->batch = offer->batch;
+    }
+
+    uint32_t checksum = offer->checksum & ours.checksum;
+    uint32_t compress = offer->compress & ours.compress;
+
+    if (offer->version < WIRE_V2 || offer->frame_max < WIRE_SIZE_MAX || checksum == 0 || compress == 0) {
+        return false;
+    }
+
+    caps->version = WIRE_V2;
+    caps->frame_max = WIRE_SIZE_MAX;
+    caps->checksum = checksum & prefer ? prefer : (checksum & PACKET_CHECKSUM_CRC32 ? PACKET_CHECKSUM_CRC32 : checksum);
+    caps->compress = PACKET_COMPRESS_NONE;
+
+    return true;
+}
+
+bool
+wire_accept(const packet_hello_t* choice, wire_caps_t* caps) {
+    packet_hello_t ours;
+
+    wire_offer(&ours);
+
+    bool single = __builtin_popcount(choice->checksum) == 1 && __builtin_popcount(choice->compress) == 1;
+    bool offered = (choice->checksum & ~ours.checksum) == 0 && (choice->compress & ~ours.compress) == 0
+            && choice->version <= ours.version && choice->frame_max <= ours.frame_max;
+    bool v1 = choice->version == WIRE_V1 && choice->checksum == PACKET_CHECKSUM_CRC32;
+
+    if (!single || !offered || choice->batch == 0 || choice->batch > ours.batch
+            || (!v1 && (choice->version != WIRE_V2 || choice->frame_max < WIRE_SIZE_MAX))) {
+        error_log("wire err: the server picked what was never offered");
+        return false;
+    }
+
+    *caps = (wire_caps_t) {
+        .version = (wire_version_t)choice->version,
+        .frame_max = choice->frame_max,
+        .checksum = (packet_checksum_t)choice->checksum,
+        .compress = (packet_compress_t)choice->compress,
+        .batch = choice->batch,
+    };
+
+    return true;
+}
+
+void
+wire_hello(const wire_caps_t* caps, packet_hello_t* hello) {
+    *hello = (packet_hello_t) {
+        .version = caps->version,
+        .frame_max = caps->frame_max,
+        .checksum = caps->checksum,
+        .compress = caps->compress,
+        .batch = caps->batch,
+    };
+}
+
+
+/*** methods ***/
+
+void
+wire_stream_init(wire_stream_t* stream, const wire_caps_t* caps) {
+    memset(stream, 0, sizeof(*stream));
+
+    stream->checked = caps->checksum == PACKET_CHECKSUM_CRC32;
+    stream->encode = stream->checked ? wire_encode_crc32 : wire_encode_bare;
+    stream->decode = stream->checked ? wire_decode_crc32 : wire_decode_bare;
+    stream->frame_max = caps->frame_max;
+}
+
+bool
+wire_known(const wire_stream_t* stream, uint32_t sender, uint64_t base, packet_str_t usrname) {
+    const wire_slot_t* slot = &stream->slots[sender % WIRE_SLOTS];
+
+    return sender == 0 || (slot->used && slot->sender == sender && slot->base == base
+            && packet_str_eq(usrname, slot->usrname));
+}
+
+uint64_t
+wire_rebase(const wire_stream_t* stream, uint32_t sender, uint64_t nonce) {
+    const wire_slot_t* slot = &stream->slots[sender % WIRE_SLOTS];
+    bool near = slot->used && slot->sender == sender && wire_zigzag(nonce - slot->base) < WIRE_REBASE;
+
+    return near ? slot->base : nonce;
+}
+
+unsigned
+wire_define(wire_stream_t* stream, uint32_t sender, uint64_t base, packet_str_t usrname, uint8_t* buf) {
+    wire_slot_t* slot = &stream->slots[sender % WIRE_SLOTS];
+    unsigned len = 1;                           /* a definition's length always fits one byte */
+
+    *slot = (wire_slot_t) {.sender = sender, .used = true, .base = base};
+    packet_str_copy(usrname, slot->usrname);
+
+    buf[len++] = WIRE_DEFINE;
+    len += wire_put_varint(buf + len, sender);
+    len += wire_put_varint(buf + len, wire_zigzag(base));
+    buf[len++] = 0;
+    buf[len++] = (uint8_t)(2 + usrname.len);
+    len += wire_put_ext(buf + len, WIRE_EXT_NAME, usrname);
+
+    buf[0] = (uint8_t)(len - 1);
+
+    return len;
+}
+
+unsigned
+wire_encode(const wire_stream_t* stream, const packet_view_t* view, uint32_t sender, uint64_t base, uint8_t* buf) {
+    return stream->encode(view, sender, base, buf);
+}
+
+void
+wire_decoder_init(wire_decoder_t* decoder, const wire_caps_t* caps) {
+    wire_stream_init(&decoder->stream, caps);
+    decoder->len = 0;
+}
+
+int
+wire_feed(wire_decoder_t* decoder, const uint8_t* data, size_t len, size_t* used, packet_view_t* view) {
+    unsigned need = 0;
+
+    if (decoder->len == 0) {
+        int rv = wire_frame(data, len, decoder->stream.frame_max, &need);
+
+        if (rv == PARSE_INVAL) {
+            return rv;
+        }
+
+        if (rv == PARSE_FRAME && need <= len) {
+            *used = need;
+            return decoder->stream.decode(&decoder->stream, data, need, view);
+        }
+    }
+
+    size_t chunk = sizeof(decoder->buf) - decoder->len;
+
+    if (chunk > len) {
+        chunk = len;
+    }
+
+    memcpy(decoder->buf + decoder->len, data, chunk);
+
+    int rv = wire_frame(decoder->buf, decoder->len + chunk, decoder->stream.frame_max, &need);
+
+    if (rv == PARSE_INVAL) {
+        return rv;
+    }
+
+    if (rv == PARSE_MORE || need > decoder->len + chunk) {
+        decoder->len += (unsigned)chunk;
+        *used = chunk;
+
+        return PARSE_MORE;
+    }
+
+    *used = need - decoder->len;                /* the rest of the chunk belongs to the next frame */
+    decoder->len = 0;
+
+    return decoder->stream.decode(&decoder->stream, decoder->buf, need, view);
+}
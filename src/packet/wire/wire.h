@@ -0,0 +1,127 @@
+#if !defined(WIRE_H)
+#define WIRE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../packet.h"
+
+/*** data ***/
+
+/* a v2 frame, spoken only once both ends agreed to with a HELO, fields in order:
+ *   varint len          of everything after it
+ *   u8 type             the v1 flags, WIRE_DEFINE for a sender definition
+ *   varint sender       0 for a frame that names its sender itself
+ *   zigzag varint       nonce, a delta against the sender's base, 0's for sender 0
+ *   zigzag varint       timestamp, a delta against WIRE_EPOCH
+ *   varint ext_len      then (u8 tag, u8 len, value) extensions, tags this end does not know are skipped
+ *   u32 crc             big endian, only when a payload follows and crc32 was agreed
+ *   payload             whatever len leaves
+ * nothing in a frame depends on the frames before it, so one encoding serves every stream; a sender
+ * other than 0 must have been defined on the stream first, by a WIRE_DEFINE frame carrying its name
+ * in a NAME extension and its base in the nonce field */
+
+typedef enum {
+    WIRE_V1 = 1,
+    WIRE_V2 = 2,
+} wire_version_t;
+
+typedef enum {
+    WIRE_EXT_NAME    = 1,
+    WIRE_EXT_OPTIONS = 2,                       /* the room or the whisper recipient */
+} wire_ext_t;
+
+#define WIRE_DEFINE 0                           /* a v1 frame always has a flag set */
+#define WIRE_EPOCH 1700000000                   /* keeps a current timestamp to 4 bytes */
+#define WIRE_SLOTS 32                           /* senders defined per stream, a miss costs a definition */
+#define WIRE_VARINT32_MAX 5
+#define WIRE_VARINT64_MAX 10
+
+typedef enum {
+    WIRE_EXT_MAX    = 2 + SIZE_USRNAME + 2 + SIZE_OPTIONS,
+    WIRE_HEAD_MAX   = 2 + 1 + WIRE_VARINT32_MAX + 2 * WIRE_VARINT64_MAX + 1 + WIRE_EXT_MAX + SIZE_CRC,
+    WIRE_SIZE_MAX   = (int)WIRE_HEAD_MAX + (int)SIZE_PAYLD,
+    WIRE_DEFINE_MAX = 1 + 1 + WIRE_VARINT32_MAX + WIRE_VARINT64_MAX + 1 + 1 + 2 + SIZE_USRNAME,
+} wire_size_t;
+
+/* what both ends of one connection agreed to in the HELO, fixed from then on */
+typedef struct wire_caps {
+    wire_version_t version;
+    unsigned frame_max;                         /* the largest frame either end may send */
+    packet_checksum_t checksum;                 /* exactly one, v1 always carries a crc */
+    packet_compress_t compress;
+    unsigned batch;                             /* ACK runs per frame, at most PACKET_ACK_MAX */
+} wire_caps_t;
+
+typedef struct wire_slot {
+    uint32_t sender;
+    bool used;
+    uint64_t base;
+    char usrname[SIZE_USRNAME + 1];             /* NUL padded, decoded views point into it */
+} wire_slot_t;
+
+typedef struct wire_stream wire_stream_t;
+
+typedef unsigned (*wire_encode_t)(const packet_view_t* view, uint32_t sender, uint64_t base, uint8_t* buf);
+typedef int (*wire_decode_t)(wire_stream_t* stream, const uint8_t* buf, unsigned len, packet_view_t* view);
+
+/* one direction of one connection, the senders defined on it as both ends see them */
+struct wire_stream {
+    bool checked;                               /* crc32 was agreed */
+    wire_encode_t encode;
+    wire_decode_t decode;
+    unsigned frame_max;
+    char usrname[SIZE_USRNAME + 1];             /* the last decoded frame's, when it named itself */
+    char options[SIZE_OPTIONS + 1];
+    wire_slot_t slots[WIRE_SLOTS];              /* by sender id modulo WIRE_SLOTS */
+};
+
+typedef struct wire_decoder {
+    wire_stream_t stream;
+    uint8_t buf[WIRE_SIZE_MAX];                 /* a frame split across reads */
+    unsigned len;
+} wire_decoder_t;
+
+
+/*** caps ***/
+
+extern wire_caps_t
+wire_caps_v1(void);
+
+extern void
+wire_offer(packet_hello_t* offer);
+
+extern bool
+wire_pick(const packet_hello_t* offer, packet_checksum_t prefer, wire_caps_t* caps);
+
+extern bool
+wire_accept(const packet_hello_t* choice, wire_caps_t* caps);
+
+extern void
+wire_hello(const wire_caps_t* caps, packet_hello_t* hello);
+
+/*** methods ***/
+
+extern void
+wire_stream_init(wire_stream_t* stream, const wire_caps_t* caps);
+
+extern bool
+wire_known(const wire_stream_t* stream, uint32_t sender, uint64_t base, packet_str_t usrname);
+
+extern uint64_t
+wire_rebase(const wire_stream_t* stream, uint32_t sender, uint64_t nonce);
+
+extern unsigned
+wire_define(wire_stream_t* stream, uint32_t sender, uint64_t base, packet_str_t usrname, uint8_t* buf);
+
+extern unsigned
+wire_encode(const wire_stream_t* stream, const packet_view_t* view, uint32_t sender, uint64_t base, uint8_t* buf);
+
+extern void
+wire_decoder_init(wire_decoder_t* decoder, const wire_caps_t* caps);
+
+extern int
+wire_feed(wire_decoder_t* decoder, const uint8_t* data, size_t len, size_t* used, packet_view_t* view);
+
+#endif /* !defined(WIRE_H) */
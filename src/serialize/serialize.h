@@ -3,34 +3,68 @@
 #define SERIALIZE_H
 
 #include <stdint.h>
+#include <string.h>
+
+/* fixed width fields sit at any offset in a frame, so they go through memcpy, which compiles to
+ * a plain load or store, and are swapped to network order in a register */
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define SERIALIZE_BE32(X) (X)
+#define SERIALIZE_BE64(X) (X)
+#else
+#define SERIALIZE_BE32(X) __builtin_bswap32(X)
+#define SERIALIZE_BE64(X) __builtin_bswap64(X)
+#endif
 
 /*** pack ***/
 
-extern void
-pack_chr(uint8_t* buf, uint8_t byte);
+static inline void
+pack_chr(uint8_t* buf, uint8_t byte) {
+    *buf = byte;
+}
 
 extern void
 pack_str(uint8_t* buf, const char* data);
 
-extern void
-pack_u32(uint8_t* buf, uint32_t data);
+static inline void
+pack_u32(uint8_t* buf, uint32_t data) {
+    uint32_t be = SERIALIZE_BE32(data);
 
-extern void
-pack_u64(uint8_t* buf, uint64_t data);
+    memcpy(buf, &be, sizeof(be));
+}
+
+static inline void
+pack_u64(uint8_t* buf, uint64_t data) {
+    uint64_t be = SERIALIZE_BE64(data);
+
+    memcpy(buf, &be, sizeof(be));
+}
 
 
 /*** unpack ***/
 
-extern void
-unpack_chr(uint8_t* field, const uint8_t* buf);
+static inline void
+unpack_chr(uint8_t* field, const uint8_t* buf) {
+    *field = *buf;
+}
 
 extern void
 unpack_str(char* field, const uint8_t* buf);
 
-extern void
-unpack_u32(uint32_t* field, const uint8_t* buf);
+static inline void
+unpack_u32(uint32_t* field, const uint8_t* buf) {
+    uint32_t be;
 
-extern void
-unpack_u64(uint64_t* field, const uint8_t* buf);
+    memcpy(&be, buf, sizeof(be));
+    *field = SERIALIZE_BE32(be);
+}
+
+static inline void
+unpack_u64(uint64_t* field, const uint8_t* buf) {
+    uint64_t be;
+
+    memcpy(&be, buf, sizeof(be));
+    *field = SERIALIZE_BE64(be);
+}
 
 #endif /* !defined(SERIALIZE_H) */
@@ -0,0 +1,77 @@
+#include "sadmit.h"
+
+#include <stdlib.h>
+
+#include "../../error/error.h"
+
+
+/*** data ***/
+
+#define ONE_SC_US 1000000LL
+#define SADMIT_BURST_US ONE_SC_US               /* a second's worth goes through at once */
+#define SADMIT_DEFER_MAX_MS (10 * 60 * 1000)
+
+
+/*** methods ***/
+
+void
+sadmit_init(sadmit_t** admit, unsigned rate) {
+    *admit = malloc(sizeof(sadmit_t));
+
+    if (*admit == NULL) {
+        error_shutdown("sadmit err: malloc");
+    }
+
+    **admit = (sadmit_t) {
+        .interval = rate > 0 ? (ONE_SC_US + rate - 1) / rate : 0,
+        .tat = 0,
+        .slot = 0,
+    };
+}
+
+void
+sadmit_free(sadmit_t* admit) {
+    free(admit);
+}
+
+bool
+sadmit_take(sadmit_t* admit, int64_t now_ms) {
+    int64_t now = now_ms * 1000;
+
+    if (admit->interval == 0) {
+        return true;
+    }
+
+    if (admit->tat < now) {                     /* idle time banks nothing past the burst */
+        admit->tat = now;
+    }
+
+    if (admit->tat - now >= SADMIT_BURST_US) {
+        return false;
+    }
+
+    admit->tat += admit->interval;
+
+    return true;
+}
+
+void
+sadmit_defer(sadmit_t* admit, int64_t now_ms, packet_retry_t* retry) {
+    int64_t now = now_ms * 1000;
+    int64_t free_at = admit->tat - SADMIT_BURST_US;
+
+    if (admit->slot < free_at) {
+        admit->slot = free_at;
+    }
+
+    if (admit->slot < now) {
+        admit->slot = now;
+    }
+
+    int64_t after = (admit->slot - now) / 1000;
+
+    admit->slot += admit->interval;             /* one return per admission, in the order turned away */
+
+    retry->after_ms = (uint32_t)(after < SADMIT_DEFER_MAX_MS ? after : SADMIT_DEFER_MAX_MS);
+    retry->jitter_ms = (uint32_t)((admit->interval + 999) / 1000);
+}
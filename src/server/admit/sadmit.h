@@ -0,0 +1,33 @@
+#if !defined(SADMIT_H)
+#define SADMIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../../packet/packet.h"
+
+/*** data ***/
+
+/* the accept budget of one shard: a generic cell rate limiter, plus the return times handed out */
+typedef struct sadmit {
+    int64_t interval;                           /* us between admissions, 0 admits everyone */
+    int64_t tat;                                /* theoretical arrival time of the next one, us */
+    int64_t slot;                               /* the earliest return not promised to anyone yet, us */
+} sadmit_t;
+
+
+/*** methods ***/
+
+extern void
+sadmit_init(sadmit_t** admit, unsigned rate);
+
+extern void
+sadmit_free(sadmit_t* admit);
+
+extern bool
+sadmit_take(sadmit_t* admit, int64_t now_ms);
+
+extern void
+sadmit_defer(sadmit_t* admit, int64_t now_ms, packet_retry_t* retry);
+
+#endif /* !defined(SADMIT_H) */
@@ -0,0 +1,327 @@
+#include "sconf.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../conf.h"
+
+#include "../../error/error.h"
+#include "../../net/net.h"
+#include "../../packet/packet.h"
+
+/*** data ***/
+
+#define POS_OPTS 2
+#define BASE_TEN 10
+
+#define DEFAULT_QUEUE_SIZE 256
+#define MIN_QUEUE_SIZE 2                        /* a v2 sender definition and the frame it is for */
+#define MAX_QUEUE_SIZE (1 << 16)
+
+#define MAX_THREADS 256
+
+#define DEFAULT_HISTORY 64
+#define MAX_HISTORY 4096
+#define DEFAULT_HISTORY_BYTES (1 << 16)
+#define MAX_HISTORY_BYTES (1 << 24)
+
+#define DEFAULT_PRESENCE_MS 100
+#define MAX_PRESENCE_MS 10000
+
+#define DEFAULT_GRACE_SECS 30
+#define MAX_GRACE_SECS 3600
+
+#define DEFAULT_ACCEPT_RATE 2000
+#define MAX_ACCEPT_RATE (1 << 20)
+#define MAX_CONNS (1 << 24)
+
+#define DEFAULT_HEARTBEAT_SECS 15
+#define MAX_HEARTBEAT_SECS 3600
+#define DEFAULT_MAX_MISSES 3
+#define MAX_MISSES 100
+#define MAX_STATS_SECS 86400
+
+#define LOG_SYNC_EVERY_PREFIX "every:"
+#define LOG_SYNC_INTERVAL_PREFIX "interval:"
+#define DEFAULT_LOG_SYNC_MS 1000
+#define MAX_LOG_SYNC_VALUE (1 << 20)
+#define DEFAULT_LOG_SEGMENT_MB 16
+#define MAX_LOG_SEGMENT_MB 1024                 /* offsets within a segment are 32 bit */
+#define MAX_LOG_RETAIN_MB (1 << 20)
+#define MAX_LOG_RETAIN_SECS (1u << 31)
+
+typedef void (*sconf_parse_fn_t)(sconf_t* conf, const char* value);
+
+typedef struct {
+    const char* name;
+    sconf_parse_fn_t parse;
+} sconf_opt_t;
+
+
+/*** aux ***/
+
+static bool
+sconf_extract_bool(const char* value, const char* name) {
+    if (strcmp(value, "on") == 0) {
+        return true;
+    }
+
+    if (strcmp(value, "off") != 0) {
+        error_shutdown("sconf err: %s must be on or off", name);
+    }
+
+    return false;
+}
+
+static unsigned
+sconf_extract_uint(const char* value, unsigned min, unsigned max, const char* name) {
+    char* endptr = NULL;
+    long num = strtol(value, &endptr, BASE_TEN);
+
+    if (endptr == value || *endptr != '\0' || num < (long)min || num > (long)max) {
+        error_shutdown("sconf err: %s must be between %u and %u", name, min, max);
+    }
+
+    return (unsigned)num;
+}
+
+
+/*** parsers ***/
+
+static void
+sconf_parse_port(sconf_t* conf, const char* value) {
+    if (validate_port(value) != 0) {
+        error_shutdown("sconf err: invalid port number");
+    }
+
+    conf->port = value;
+}
+
+static void
+sconf_parse_queue(sconf_t* conf, const char* value) {
+    conf->queue_size = sconf_extract_uint(value, MIN_QUEUE_SIZE, MAX_QUEUE_SIZE, "queue");
+}
+
+static void
+sconf_parse_overflow(sconf_t* conf, const char* value) {
+    if (strcmp(value, "disconnect") == 0) {
+        conf->overflow = OVERFLOW_DISCONNECT;
+    } else if (strcmp(value, "drop-oldest") == 0) {
+        conf->overflow = OVERFLOW_DROP_OLDEST;
+    } else if (strcmp(value, "drop-new") == 0) {
+        conf->overflow = OVERFLOW_DROP_NEW;
+    } else {
+        error_shutdown("sconf err: overflow must be disconnect, drop-oldest or drop-new");
+    }
+}
+
+static void
+sconf_parse_threads(sconf_t* conf, const char* value) {
+    conf->threads = sconf_extract_uint(value, 1, MAX_THREADS, "threads");
+}
+
+static void
+sconf_parse_pin(sconf_t* conf, const char* value) {
+    conf->pin = sconf_extract_bool(value, "pin");
+}
+
+static void
+sconf_parse_io(sconf_t* conf, const char* value) {
+    if (strcmp(value, "poll") == 0) {
+        conf->io = IO_BACKEND_POLL;
+    } else if (strcmp(value, "epoll") == 0) {
+        conf->io = IO_BACKEND_EPOLL;
+    } else if (strcmp(value, "uring") == 0) {
+        conf->io = IO_BACKEND_URING;
+    } else {
+        error_shutdown("sconf err: io must be poll, epoll or uring");
+    }
+}
+
+static void
+sconf_parse_zerocopy(sconf_t* conf, const char* value) {
+    conf->zerocopy = sconf_extract_bool(value, "zerocopy");
+}
+
+static void
+sconf_parse_checksum(sconf_t* conf, const char* value) {
+    if (strcmp(value, "crc32") == 0) {
+        conf->checksum = PACKET_CHECKSUM_CRC32;
+    } else if (strcmp(value, "none") == 0) {
+        conf->checksum = PACKET_CHECKSUM_NONE;
+    } else {
+        error_shutdown("sconf err: checksum must be crc32 or none");
+    }
+}
+
+static void
+sconf_parse_history(sconf_t* conf, const char* value) {
+    conf->history = sconf_extract_uint(value, 0, MAX_HISTORY, "history");
+}
+
+static void
+sconf_parse_history_bytes(sconf_t* conf, const char* value) {
+    conf->history_bytes = sconf_extract_uint(value, PACKET_SIZE_MAX, MAX_HISTORY_BYTES, "history-bytes");
+}
+
+static void
+sconf_parse_presence_window(sconf_t* conf, const char* value) {
+    conf->presence_ms = sconf_extract_uint(value, 0, MAX_PRESENCE_MS, "presence-window");
+}
+
+static void
+sconf_parse_grace(sconf_t* conf, const char* value) {
+    conf->grace_secs = sconf_extract_uint(value, 0, MAX_GRACE_SECS, "grace");
+}
+
+static void
+sconf_parse_accept_rate(sconf_t* conf, const char* value) {
+    conf->accept_rate = sconf_extract_uint(value, 0, MAX_ACCEPT_RATE, "accept-rate");
+}
+
+static void
+sconf_parse_max_conns(sconf_t* conf, const char* value) {
+    conf->max_conns = sconf_extract_uint(value, 0, MAX_CONNS, "max-conns");
+}
+
+static void
+sconf_parse_heartbeat(sconf_t* conf, const char* value) {
+    conf->heartbeat_secs = sconf_extract_uint(value, 0, MAX_HEARTBEAT_SECS, "heartbeat");
+}
+
+static void
+sconf_parse_max_misses(sconf_t* conf, const char* value) {
+    conf->max_misses = sconf_extract_uint(value, 1, MAX_MISSES, "max-misses");
+}
+
+static void
+sconf_parse_stats(sconf_t* conf, const char* value) {
+    conf->stats_secs = sconf_extract_uint(value, 0, MAX_STATS_SECS, "stats");
+}
+
+static void
+sconf_parse_log(sconf_t* conf, const char* value) {
+    conf->log_dir = value;
+}
+
+static void
+sconf_parse_log_sync(sconf_t* conf, const char* value) {
+    if (strcmp(value, "none") == 0) {
+        conf->log_sync = LOG_SYNC_NONE;
+    } else if (strncmp(value, LOG_SYNC_EVERY_PREFIX, strlen(LOG_SYNC_EVERY_PREFIX)) == 0) {
+        conf->log_sync = LOG_SYNC_EVERY;
+        value += strlen(LOG_SYNC_EVERY_PREFIX);
+    } else if (strncmp(value, LOG_SYNC_INTERVAL_PREFIX, strlen(LOG_SYNC_INTERVAL_PREFIX)) == 0) {
+        conf->log_sync = LOG_SYNC_INTERVAL;
+        value += strlen(LOG_SYNC_INTERVAL_PREFIX);
+    } else {
+        error_shutdown("sconf err: log-sync must be none, every:<appends> or interval:<ms>");
+    }
+
+    if (conf->log_sync != LOG_SYNC_NONE) {
+        conf->log_sync_value = sconf_extract_uint(value, 1, MAX_LOG_SYNC_VALUE, "log-sync");
+    }
+}
+
+static void
+sconf_parse_log_segment(sconf_t* conf, const char* value) {
+    conf->log_segment_mb = sconf_extract_uint(value, 1, MAX_LOG_SEGMENT_MB, "log-segment");
+}
+
+static void
+sconf_parse_log_retain_mb(sconf_t* conf, const char* value) {
+    conf->log_retain_mb = sconf_extract_uint(value, 0, MAX_LOG_RETAIN_MB, "log-retain-mb");
+}
+
+static void
+sconf_parse_log_retain_secs(sconf_t* conf, const char* value) {
+    conf->log_retain_secs = sconf_extract_uint(value, 0, MAX_LOG_RETAIN_SECS, "log-retain-secs");
+}
+
+static const sconf_opt_t sconf_opts[] = {
+    {"--port",            sconf_parse_port},
+    {"--queue",           sconf_parse_queue},
+    {"--overflow",        sconf_parse_overflow},
+    {"--threads",         sconf_parse_threads},
+    {"--pin",             sconf_parse_pin},
+    {"--io",              sconf_parse_io},
+    {"--zerocopy",        sconf_parse_zerocopy},
+    {"--checksum",        sconf_parse_checksum},
+    {"--history",         sconf_parse_history},
+    {"--history-bytes",   sconf_parse_history_bytes},
+    {"--presence-window", sconf_parse_presence_window},
+    {"--grace",           sconf_parse_grace},
+    {"--accept-rate",     sconf_parse_accept_rate},
+    {"--max-conns",       sconf_parse_max_conns},
+    {"--heartbeat",       sconf_parse_heartbeat},
+    {"--max-misses",      sconf_parse_max_misses},
+    {"--stats",           sconf_parse_stats},
+    {"--log",             sconf_parse_log},
+    {"--log-sync",        sconf_parse_log_sync},
+    {"--log-segment",     sconf_parse_log_segment},
+    {"--log-retain-mb",   sconf_parse_log_retain_mb},
+    {"--log-retain-secs", sconf_parse_log_retain_secs},
+};
+
+static void
+sconf_parse_opt(sconf_t* conf, const char* name, const char* value) {
+    for (size_t i = 0; i < sizeof(sconf_opts) / sizeof(sconf_opts[0]); ++i) {
+        if (strcmp(name, sconf_opts[i].name) == 0) {
+            sconf_opts[i].parse(conf, value);
+            return;
+        }
+    }
+
+    error_shutdown("sconf err: unknown option %s", name);
+}
+
+
+/*** methods ***/
+
+void
+sconf_init(sconf_t** conf, const char** args) {
+    *conf = malloc(sizeof(sconf_t));
+
+    if (*conf == NULL) {
+        error_shutdown("sconf err: malloc");
+    }
+
+    **conf = (sconf_t) {
+        .port            = DEFAULT_PORT,
+        .queue_size      = DEFAULT_QUEUE_SIZE,
+        .overflow        = OVERFLOW_DISCONNECT,
+        .threads         = 1,
+        .pin             = false,
+        .io              = IO_BACKEND_EPOLL,
+        .zerocopy        = false,
+        .checksum        = PACKET_CHECKSUM_CRC32,
+        .history         = DEFAULT_HISTORY,
+        .history_bytes   = DEFAULT_HISTORY_BYTES,
+        .presence_ms     = DEFAULT_PRESENCE_MS,
+        .grace_secs      = DEFAULT_GRACE_SECS,
+        .accept_rate     = DEFAULT_ACCEPT_RATE,
+        .max_conns       = 0,
+        .heartbeat_secs  = DEFAULT_HEARTBEAT_SECS,
+        .max_misses      = DEFAULT_MAX_MISSES,
+        .stats_secs      = 0,
+        .log_dir         = NULL,
+        .log_sync        = LOG_SYNC_INTERVAL,
+        .log_sync_value  = DEFAULT_LOG_SYNC_MS,
+        .log_segment_mb  = DEFAULT_LOG_SEGMENT_MB,
+        .log_retain_mb   = 0,
+        .log_retain_secs = 0,
+    };
+
+    for (const char** arg = args + POS_OPTS; *arg != NULL; arg += 2) {
+        if (arg[1] == NULL) {
+            error_shutdown("sconf err: option %s needs a value", arg[0]);
+        }
+
+        sconf_parse_opt(*conf, arg[0], arg[1]);
+    }
+}
+
+void
+sconf_free(sconf_t* conf) {
+    free(conf);
+}
@@ -0,0 +1,57 @@
+#if !defined(SCONF_H)
+#define SCONF_H
+
+#include <stdbool.h>
+
+#include "../../net/io/io.h"
+#include "../../packet/packet.h"
+
+/*** data ***/
+
+typedef enum {
+    OVERFLOW_DISCONNECT,                        /* close the slow consumer and announce DISC */
+    OVERFLOW_DROP_OLDEST,                       /* evict the oldest frame not yet on the wire */
+    OVERFLOW_DROP_NEW,                          /* refuse the incoming frame */
+} sconf_overflow_t;
+
+typedef enum {
+    LOG_SYNC_NONE,                              /* leave it to the page cache */
+    LOG_SYNC_EVERY,                             /* one fdatasync per log_sync_value appends */
+    LOG_SYNC_INTERVAL,                          /* one fdatasync per log_sync_value ms with appends */
+} sconf_log_sync_t;
+
+typedef struct sconfig {
+    const char* port;
+    unsigned queue_size;                        /* max frames waiting per connection */
+    sconf_overflow_t overflow;
+    unsigned threads;                           /* reactor shards, each with its own listener */
+    bool pin;                                   /* pin shard i to cpu i */
+    io_backend_t io;                            /* requested, a shard may fall back */
+    bool zerocopy;                              /* MSG_ZEROCOPY for large fan-out flushes */
+    packet_checksum_t checksum;                 /* picked for v2 connections whenever the client offers it */
+    unsigned history;                           /* messages replayed per room on JOIN, 0 is off */
+    unsigned history_bytes;                     /* and the most they may add up to per room */
+    unsigned presence_ms;                       /* presence changes are batched this long, 0 per loop pass */
+    unsigned grace_secs;                        /* a dropped session waits this long for a resume, 0 is off */
+    unsigned accept_rate;                       /* connections let in per second, the rest told when to return */
+    unsigned max_conns;                         /* connections held at once over all shards, 0 is no limit */
+    unsigned heartbeat_secs;                    /* a connection this quiet is pinged, 0 is off */
+    unsigned max_misses;                        /* and closed after this many unanswered pings */
+    unsigned stats_secs;                        /* each shard prints its connection metrics this often, 0 is off */
+    const char* log_dir;                        /* NULL keeps messages in memory only */
+    sconf_log_sync_t log_sync;
+    unsigned log_sync_value;
+    unsigned log_segment_mb;                    /* a segment rotates once it reaches this */
+    unsigned log_retain_mb;                     /* whole segments go past this, 0 keeps all */
+    unsigned log_retain_secs;                   /* and once their newest record is older, 0 keeps all */
+} sconf_t;
+
+/*** methods ***/
+
+extern void
+sconf_init(sconf_t** conf, const char** args);
+
+extern void
+sconf_free(sconf_t* conf);
+
+#endif /* !defined(SCONF_H) */
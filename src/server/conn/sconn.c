@@ -0,0 +1,99 @@
+#include "sconn.h"
+
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../../error/error.h"
+#include "../../net/net.h"
+
+
+/*** methods ***/
+
+void
+sconn_init(sconn_t** conn_ptr, int sockfd, unsigned queue_size) {
+    *conn_ptr = malloc(sizeof(sconn_t));
+
+    if (*conn_ptr == NULL) {
+        error_shutdown("sconn err: malloc");
+    }
+
+    sconn_t* conn = *conn_ptr;
+
+    *conn = (sconn_t) {
+        .sockfd = sockfd,
+        .handle = NULL,
+        .idx = 0,
+        .room = NULL,
+        .room_idx = 0,
+        .usrname = {0},
+        .uid = 0,
+        .base = 0,
+        .caps = wire_caps_v1(),
+        .state = SCONN_STATE_CONNECTED,
+        .closing = false,
+        .flushing = false,
+        .catchup_after = 0,
+        .catchup_until = 0,
+        .heard = 0,
+        .ping_nonce = 0,
+        .ping_sent = 0,
+        .pinged = 0,
+        .missed = 0,
+        .ack_len = 0,
+        .next_reap = NULL,
+        .next_flush = NULL,
+        .wire_out = NULL,
+        .wire_in = NULL,
+    };
+
+    rtt_init(&conn->rtt);
+    sdedup_init(&conn->dedup);
+    packet_parser_init(&conn->parser);
+    squeue_init(&conn->queue, queue_size);
+
+    struct sockaddr_storage remote;
+    socklen_t addrlen = sizeof(remote);
+
+    if (getpeername(sockfd, (struct sockaddr*)&remote, &addrlen) == -1
+            || inet_ntop(remote.ss_family, get_in_addr((struct sockaddr*)&remote), conn->addr, sizeof(conn->addr)) == NULL) {
+        (void)strcpy(conn->addr, "unknown");
+    }
+}
+
+void
+sconn_upgrade(sconn_t* conn, bool inbound) {
+    if (!inbound && conn->wire_out == NULL) {
+        conn->wire_out = malloc(sizeof(wire_stream_t));
+
+        if (conn->wire_out == NULL) {
+            error_shutdown("sconn err: malloc");
+        }
+
+        wire_stream_init(conn->wire_out, &conn->caps);
+    }
+
+    if (inbound && conn->wire_in == NULL) {
+        conn->wire_in = malloc(sizeof(wire_decoder_t));
+
+        if (conn->wire_in == NULL) {
+            error_shutdown("sconn err: malloc");
+        }
+
+        wire_decoder_init(conn->wire_in, &conn->caps);
+    }
+}
+
+void
+sconn_free(sconn_t* conn) {
+    if (conn->sockfd != -1) {
+        close(conn->sockfd);
+    }
+
+    squeue_free(&conn->queue);
+    free(conn->wire_out);
+    free(conn->wire_in);
+    free(conn);
+}
@@ -0,0 +1,78 @@
+#if !defined(SCONN_H)
+#define SCONN_H
+
+/*** includes ***/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include "../dedup/sdedup.h"
+#include "../queue/squeue.h"
+#include "../room/sroom.h"
+
+#include "../../net/io/io.h"
+#include "../../net/rtt/rtt.h"
+#include "../../packet/packet.h"
+#include "../../packet/parser/parser.h"
+#include "../../packet/wire/wire.h"
+#include "../../timer/wheel/wheel.h"
+
+/*** data ***/
+
+typedef enum {
+    SCONN_STATE_CONNECTED,                      /* socket accepted, no JOIN seen yet */
+    SCONN_STATE_JOINED,                         /* JOIN seen, peers know about this user */
+    SCONN_STATE_EXITED,                         /* EXIT seen, no DISC notice on close */
+    SCONN_STATE_REFUSED,                        /* JOIN under a taken name, dropped until one succeeds */
+    SCONN_STATE_PARKED,                         /* socket gone, the name kept for a resume */
+} sconn_state_t;
+
+typedef struct sconn {
+    int sockfd;
+    io_handle_t* handle;
+    size_t idx;                                 /* position in the server connection table */
+    sroom_t* room;                              /* every tracked connection sits in exactly one */
+    size_t room_idx;                            /* position in the room's member array */
+    char addr[INET6_ADDRSTRLEN];
+    char usrname[SIZE_USRNAME + 1];
+    uint32_t uid;                               /* handed out at JOIN, what its frames go by on v2 streams */
+    uint64_t base;                              /* the uid's nonce base, its first relayed message's */
+    wire_caps_t caps;
+    sconn_state_t state;
+    bool closing;                               /* doomed, freed once the backend lets go of it */
+    bool flushing;                              /* queued for the end of batch flush */
+    uint64_t catchup_after;                     /* history sequence replayed up to, when catching up */
+    uint64_t catchup_until;                     /* newest one at JOIN, later frames arrive live */
+    int64_t heard;                              /* safe_time_ms of the last read, pings only go to the quiet */
+    uint64_t ping_nonce;                        /* of the ping in flight, a late pong for an older one is ignored */
+    int64_t ping_sent;                          /* safe_time_us it left at, 0 when none is in flight */
+    int64_t pinged;                             /* safe_time_ms of the last one, answered or not */
+    unsigned missed;                            /* pings sent since it last said anything */
+    rtt_t rtt;
+    wheel_timer_t heartbeat;                    /* armed while the server heartbeat is on */
+    sdedup_t dedup;                             /* the session's, carried over a resume */
+    packet_ack_t acks[PACKET_ACK_MAX];          /* messages accepted since the last flush, one ACK for all */
+    unsigned ack_len;
+    struct sconn* next_reap;
+    struct sconn* next_flush;
+    packet_parser_t parser;                     /* reassembles frames split across reads */
+    wire_stream_t* wire_out;                    /* NULL until a HELO settles on v2, then what it is sent */
+    wire_decoder_t* wire_in;                    /* likewise for what it sends, once it confirmed */
+    squeue_t queue;
+} sconn_t;
+
+
+/*** methods ***/
+
+extern void
+sconn_init(sconn_t** conn, int sockfd, unsigned queue_size);
+
+extern void
+sconn_upgrade(sconn_t* conn, bool inbound);
+
+extern void
+sconn_free(sconn_t* conn);
+
+#endif /* !defined(SCONN_H) */
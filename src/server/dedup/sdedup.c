@@ -0,0 +1,43 @@
+#include "sdedup.h"
+
+
+/*** data ***/
+
+#define SDEDUP_AHEAD (1ULL << 63)               /* nonces wrap, half the space counts as newer */
+
+
+/*** methods ***/
+
+void
+sdedup_init(sdedup_t* dedup) {
+    *dedup = (sdedup_t) {
+        .top = 0,
+        .seen = 0,
+    };
+}
+
+bool
+sdedup_fresh(sdedup_t* dedup, uint64_t nonce) {
+    uint64_t ahead = nonce - dedup->top;
+
+    if (dedup->seen == 0 || (ahead != 0 && ahead < SDEDUP_AHEAD)) {
+        dedup->seen = dedup->seen == 0 || ahead >= SDEDUP_WINDOW ? 0 : dedup->seen << ahead;
+        dedup->seen |= 1;
+        dedup->top = nonce;
+        return true;
+    }
+
+    uint64_t behind = dedup->top - nonce;
+
+    if (behind >= SDEDUP_WINDOW) {              /* too old to tell, a resend that late is dropped */
+        return false;
+    }
+
+    if (dedup->seen & (1ULL << behind)) {
+        return false;
+    }
+
+    dedup->seen |= 1ULL << behind;
+
+    return true;
+}
@@ -0,0 +1,26 @@
+#if !defined(SDEDUP_H)
+#define SDEDUP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*** data ***/
+
+#define SDEDUP_WINDOW 64                        /* nonces remembered below the newest, a client resends fewer */
+
+/* one sender's recent nonces, a sliding bitmap like ipsec replay protection */
+typedef struct sdedup {
+    uint64_t top;                               /* the newest nonce seen */
+    uint64_t seen;                              /* bit i set when top - i was seen */
+} sdedup_t;
+
+
+/*** methods ***/
+
+extern void
+sdedup_init(sdedup_t* dedup);
+
+extern bool
+sdedup_fresh(sdedup_t* dedup, uint64_t nonce);
+
+#endif /* !defined(SDEDUP_H) */
@@ -0,0 +1,287 @@
+#include "sdir.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../error/error.h"
+
+
+/*** data ***/
+
+#define INIT_SLOTS_SIZE 64
+
+
+/*** aux ***/
+
+static uint64_t
+sdir_hash(const sdir_t* dir, const char* usrname) {
+    return siphash_generate(&dir->key, usrname, strnlen(usrname, SIZE_USRNAME));
+}
+
+static size_t
+sdir_probe(const sdir_t* dir, const char* usrname, uint64_t hash) {
+    size_t mask = dir->size - 1;
+    size_t slot = hash & mask;
+
+    while (dir->slots[slot].usrname[0] != '\0') {   /* the load factor keeps a free slot around */
+        const sdir_entry_t* entry = &dir->slots[slot];
+
+        if (entry->hash == hash && strncmp(entry->usrname, usrname, SIZE_USRNAME) == 0) {
+            break;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static uint64_t
+sdir_token(sdir_t* dir) {
+    uint64_t token;
+
+    do {                                        /* unguessable without the key, 0 means none */
+        uint64_t count = dir->tokens++;
+
+        token = siphash_generate(&dir->token_key, (const char*)&count, sizeof(count));
+    } while (token == 0);
+
+    return token;
+}
+
+static void
+sdir_grow(sdir_t* dir) {
+    sdir_entry_t* slots = dir->slots;
+    size_t size = dir->size;
+
+    dir->size = size * 2;
+    dir->slots = calloc(dir->size, sizeof(sdir_entry_t));
+
+    if (dir->slots == NULL) {
+        error_shutdown("sdir err: calloc");
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        if (slots[i].usrname[0] != '\0') {
+            dir->slots[sdir_probe(dir, slots[i].usrname, slots[i].hash)] = slots[i];
+        }
+    }
+
+    free(slots);
+}
+
+static void
+sdir_remove(sdir_t* dir, size_t hole) {
+    size_t mask = dir->size - 1;
+
+    /* backward shift, so lookups never need tombstones */
+    for (size_t slot = (hole + 1) & mask; dir->slots[slot].usrname[0] != '\0'; slot = (slot + 1) & mask) {
+        size_t home = dir->slots[slot].hash & mask;
+
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            dir->slots[hole] = dir->slots[slot];
+            hole = slot;
+        }
+    }
+
+    dir->slots[hole].usrname[0] = '\0';
+    dir->len -= 1;
+}
+
+
+/*** methods ***/
+
+void
+sdir_init(sdir_t** dir) {
+    *dir = malloc(sizeof(sdir_t));
+
+    if (*dir == NULL) {
+        error_shutdown("sdir err: malloc");
+    }
+
+    if (pthread_mutex_init(&(*dir)->lock, NULL) != 0) {
+        error_shutdown("sdir err: pthread_mutex_init");
+    }
+
+    (*dir)->key = siphash_key_random();
+    (*dir)->token_key = siphash_key_random();
+    (*dir)->tokens = 0;
+    (*dir)->slots = calloc(INIT_SLOTS_SIZE, sizeof(sdir_entry_t));
+    (*dir)->len = 0;
+    (*dir)->size = INIT_SLOTS_SIZE;
+
+    if ((*dir)->slots == NULL) {
+        error_shutdown("sdir err: calloc");
+    }
+}
+
+void
+sdir_free(sdir_t* dir) {
+    pthread_mutex_destroy(&dir->lock);
+    free(dir->slots);
+    free(dir);
+}
+
+sdir_claim_t
+sdir_claim(sdir_t* dir, const char* usrname, const char* room, unsigned shard, struct sconn* conn,
+        uint64_t* token, char* evicted) {
+    uint64_t hash = sdir_hash(dir, usrname);
+    sdir_claim_t rv = SDIR_CLAIMED;
+
+    *token = 0;
+
+    if (usrname[0] == '\0') {                   /* anonymous, nobody can whisper to it */
+        return SDIR_CLAIMED;
+    }
+
+    pthread_mutex_lock(&dir->lock);
+
+    if ((dir->len + 1) * 4 > dir->size * 3) {
+        sdir_grow(dir);
+    }
+
+    sdir_entry_t* slot = &dir->slots[sdir_probe(dir, usrname, hash)];
+
+    if (slot->usrname[0] != '\0' && slot->conn != NULL && slot->conn != conn) {
+        pthread_mutex_unlock(&dir->lock);
+        return SDIR_TAKEN;
+    }
+
+    bool fresh = slot->usrname[0] == '\0';
+
+    if (fresh) {
+        dir->len += 1;
+    } else if (slot->conn == NULL) {            /* a plain JOIN wins over a session nobody resumed */
+        memcpy(evicted, slot->room, sizeof(slot->room));
+        rv = SDIR_EVICTED;
+    }
+
+    if (fresh || rv == SDIR_EVICTED) {          /* otherwise ours already, a JOIN into another room */
+        *slot = (sdir_entry_t) {
+            .usrname = {0},
+            .room = {0},
+            .hash = hash,
+            .token = sdir_token(dir),
+            .shard = shard,
+            .conn = conn,
+        };
+
+        sdedup_init(&slot->dedup);
+
+        memcpy(slot->usrname, usrname, strnlen(usrname, SIZE_USRNAME));
+    }
+
+    memset(slot->room, 0, sizeof(slot->room));
+    memcpy(slot->room, room, strnlen(room, SIZE_OPTIONS));
+
+    *token = slot->token;
+
+    pthread_mutex_unlock(&dir->lock);
+
+    return rv;
+}
+
+void
+sdir_release(sdir_t* dir, const char* usrname, const struct sconn* conn) {
+    uint64_t hash = sdir_hash(dir, usrname);
+
+    pthread_mutex_lock(&dir->lock);
+
+    size_t slot = sdir_probe(dir, usrname, hash);
+
+    if (dir->slots[slot].usrname[0] != '\0' && dir->slots[slot].conn == conn) {
+        sdir_remove(dir, slot);
+    }
+
+    pthread_mutex_unlock(&dir->lock);
+}
+
+uint64_t
+sdir_park(sdir_t* dir, const char* usrname, const struct sconn* conn, const sdedup_t* dedup) {
+    uint64_t hash = sdir_hash(dir, usrname);
+    uint64_t token = 0;
+
+    pthread_mutex_lock(&dir->lock);
+
+    sdir_entry_t* entry = &dir->slots[sdir_probe(dir, usrname, hash)];
+
+    if (entry->usrname[0] != '\0' && entry->conn == conn) {    /* resumed elsewhere, nothing to keep */
+        entry->conn = NULL;
+        entry->dedup = *dedup;
+        token = entry->token;
+    }
+
+    pthread_mutex_unlock(&dir->lock);
+
+    return token;
+}
+
+bool
+sdir_resume(sdir_t* dir, const char* usrname, uint64_t* token, unsigned shard, struct sconn* conn,
+        sdir_entry_t* prev) {
+    uint64_t hash = sdir_hash(dir, usrname);
+    bool resumed = false;
+
+    if (*token == 0) {
+        return false;
+    }
+
+    pthread_mutex_lock(&dir->lock);
+
+    sdir_entry_t* entry = &dir->slots[sdir_probe(dir, usrname, hash)];
+
+    /* parked, or still live when the old socket has not timed out yet */
+    if (entry->usrname[0] != '\0' && entry->token == *token && entry->conn != conn) {
+        *prev = *entry;
+        *token = sdir_token(dir);               /* single use, the client gets the next one */
+
+        entry->token = *token;
+        entry->shard = shard;
+        entry->conn = conn;
+        resumed = true;
+    }
+
+    pthread_mutex_unlock(&dir->lock);
+
+    return resumed;
+}
+
+bool
+sdir_expire(sdir_t* dir, const char* usrname, uint64_t token, char* room) {
+    uint64_t hash = sdir_hash(dir, usrname);
+    bool expired = false;
+
+    pthread_mutex_lock(&dir->lock);
+
+    size_t slot = sdir_probe(dir, usrname, hash);
+    const sdir_entry_t* entry = &dir->slots[slot];
+
+    if (entry->usrname[0] != '\0' && entry->conn == NULL && entry->token == token) {
+        memcpy(room, entry->room, sizeof(entry->room));
+        sdir_remove(dir, slot);
+        expired = true;
+    }
+
+    pthread_mutex_unlock(&dir->lock);
+
+    return expired;
+}
+
+bool
+sdir_lookup(sdir_t* dir, const char* usrname, unsigned* shard, struct sconn** conn) {
+    uint64_t hash = sdir_hash(dir, usrname);
+
+    pthread_mutex_lock(&dir->lock);
+
+    const sdir_entry_t* entry = &dir->slots[sdir_probe(dir, usrname, hash)];
+    bool found = entry->usrname[0] != '\0' && entry->conn != NULL; /* parked sessions get nothing */
+
+    if (found) {
+        *shard = entry->shard;
+        *conn = entry->conn;
+    }
+
+    pthread_mutex_unlock(&dir->lock);
+
+    return found;
+}
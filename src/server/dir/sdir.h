@@ -0,0 +1,74 @@
+#if !defined(SDIR_H)
+#define SDIR_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../dedup/sdedup.h"
+
+#include "../../crypto/siphash/siphash.h"
+#include "../../packet/packet.h"
+
+/*** data ***/
+
+struct sconn;
+
+typedef enum {
+    SDIR_TAKEN   = -1,                          /* somebody else answers to that name */
+    SDIR_CLAIMED =  0,
+    SDIR_EVICTED =  1,                          /* claimed from a parked session, nobody said it left */
+} sdir_claim_t;
+
+typedef struct sdir_entry {
+    char usrname[SIZE_USRNAME + 1];             /* empty marks a free slot */
+    char room[SIZE_OPTIONS + 1];                /* as of the last JOIN */
+    uint64_t hash;
+    uint64_t token;                             /* resumes the session, never 0 */
+    unsigned shard;
+    struct sconn* conn;                         /* only ever dereferenced by that shard, NULL while parked */
+    sdedup_t dedup;                             /* the nonces it sent, kept while parked */
+} sdir_entry_t;
+
+/* every joined username across all shards, so a whisper goes to one socket */
+typedef struct sdir {
+    pthread_mutex_t lock;                       /* taken on JOIN, EXIT, close and whispers only */
+    siphash_key_t key;                          /* usernames come from clients */
+    siphash_key_t token_key;                    /* tokens are a keyed hash of a counter */
+    uint64_t tokens;
+    sdir_entry_t* slots;                        /* open addressing, linear probing, power of two */
+    size_t len;
+    size_t size;
+} sdir_t;
+
+
+/*** methods ***/
+
+extern void
+sdir_init(sdir_t** dir);
+
+extern void
+sdir_free(sdir_t* dir);
+
+extern sdir_claim_t
+sdir_claim(sdir_t* dir, const char* usrname, const char* room, unsigned shard, struct sconn* conn,
+        uint64_t* token, char* evicted);
+
+extern void
+sdir_release(sdir_t* dir, const char* usrname, const struct sconn* conn);
+
+extern uint64_t
+sdir_park(sdir_t* dir, const char* usrname, const struct sconn* conn, const sdedup_t* dedup);
+
+extern bool
+sdir_resume(sdir_t* dir, const char* usrname, uint64_t* token, unsigned shard, struct sconn* conn,
+        sdir_entry_t* prev);
+
+extern bool
+sdir_expire(sdir_t* dir, const char* usrname, uint64_t token, char* room);
+
+extern bool
+sdir_lookup(sdir_t* dir, const char* usrname, unsigned* shard, struct sconn** conn);
+
+#endif /* !defined(SDIR_H) */
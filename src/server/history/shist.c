@@ -0,0 +1,368 @@
+#include "shist.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../error/error.h"
+#include "../../serialize/serialize.h"
+
+
+/*** data ***/
+
+#define INIT_SLOTS_SIZE 16
+#define SHIST_ROOMS_MAX 4096                    /* rooms are client named, past this no history */
+#define SHIST_SEQ_SHIFT 20
+
+typedef struct {
+    shist_t* hist;
+    frame_pool_t* pool;
+    size_t loaded;
+} shist_warm_t;
+
+
+/*** aux ***/
+
+static uint64_t
+shist_hash(const shist_t* hist, const char* room) {
+    return siphash_generate(&hist->key, room, strlen(room));
+}
+
+static size_t
+shist_probe(const shist_t* hist, const char* room, uint64_t hash) {
+    size_t mask = hist->size - 1;
+    size_t slot = hash & mask;
+
+    while (hist->slots[slot] != NULL) {         /* the load factor keeps an empty slot around */
+        const shist_ring_t* ring = hist->slots[slot];
+
+        if (ring->hash == hash && strcmp(ring->name, room) == 0) {
+            break;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static void
+shist_grow(shist_t* hist) {
+    shist_ring_t** slots = hist->slots;
+    size_t size = hist->size;
+
+    hist->size = size * 2;
+    hist->slots = calloc(hist->size, sizeof(shist_ring_t*));
+
+    if (hist->slots == NULL) {
+        error_shutdown("shist err: calloc");
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        if (slots[i] != NULL) {
+            hist->slots[shist_probe(hist, slots[i]->name, slots[i]->hash)] = slots[i];
+        }
+    }
+
+    free(slots);
+}
+
+static shist_ring_t*
+shist_create(shist_t* hist, const char* room, uint64_t hash) {
+    if (hist->len == SHIST_ROOMS_MAX) {
+        return NULL;
+    }
+
+    if ((hist->len + 1) * 4 > hist->size * 3) {
+        shist_grow(hist);
+    }
+
+    shist_ring_t* ring = malloc(sizeof(shist_ring_t));
+
+    if (ring == NULL) {
+        error_shutdown("shist err: malloc");
+    }
+
+    *ring = (shist_ring_t) {
+        .name = {0},
+        .hash = hash,
+        .frames = malloc(sizeof(frame_t*) * hist->cap),
+        .seqs = malloc(sizeof(uint64_t) * hist->cap),
+        .head = 0,
+        .len = 0,
+        .bytes = 0,
+        .sealed = false,
+    };
+
+    if (ring->frames == NULL || ring->seqs == NULL) {
+        error_shutdown("shist err: malloc");
+    }
+
+    strncpy(ring->name, room, SIZE_OPTIONS);
+
+    hist->slots[shist_probe(hist, ring->name, hash)] = ring;
+    hist->len += 1;
+
+    return ring;
+}
+
+static bool
+shist_warm_visit(const slog_rec_t* rec, void* arg) {
+    shist_warm_t* warm = arg;
+    shist_t* hist = warm->hist;
+
+    if (rec->len < PACKET_SIZE_MIN || rec->len > PACKET_SIZE_MAX) {
+        return true;
+    }
+
+    if (rec->seq >= hist->next_seq) {
+        hist->next_seq = rec->seq + 1;
+    }
+
+    uint64_t hash = shist_hash(hist, rec->room);
+    shist_ring_t* ring = hist->slots[shist_probe(hist, rec->room, hash)];
+
+    if (ring == NULL) {
+        ring = shist_create(hist, rec->room, hash);
+    }
+
+    if (ring == NULL || ring->sealed) {
+        return true;
+    }
+
+    if (ring->len == hist->cap || ring->bytes + rec->len > hist->cap_bytes) {
+        ring->sealed = true;                    /* older frames would leave a gap */
+        return true;
+    }
+
+    ring->head = (ring->head + hist->cap - 1) % hist->cap;   /* newest first, so prepend */
+    ring->frames[ring->head] = frame_copy(warm->pool, rec->buf, rec->len);
+    ring->seqs[ring->head] = rec->seq;
+    ring->len += 1;
+    ring->bytes += rec->len;
+    warm->loaded += 1;
+
+    return true;
+}
+
+static bool
+shist_match(const frame_t* frame, const char* usrname, uint64_t nonce) {
+    uint64_t frame_nonce;
+
+    if (strncmp((const char*)frame->buf + OFFSET_USRNAME, usrname, SIZE_USRNAME) != 0) {
+        return false;
+    }
+
+    unpack_u64(&frame_nonce, frame->buf + OFFSET_NONCE);
+
+    return frame_nonce == nonce;
+}
+
+static void
+shist_evict(shist_ring_t* ring, unsigned cap) {
+    frame_t* frame = ring->frames[ring->head];
+
+    ring->head = (ring->head + 1) % cap;
+    ring->len -= 1;
+    ring->bytes -= frame->len;
+
+    frame_unref(frame);
+}
+
+
+/*** methods ***/
+
+void
+shist_init(shist_t** hist, unsigned cap, size_t cap_bytes) {
+    *hist = malloc(sizeof(shist_t));
+
+    if (*hist == NULL) {
+        error_shutdown("shist err: malloc");
+    }
+
+    (*hist)->key = siphash_key_random();
+    (*hist)->slots = calloc(INIT_SLOTS_SIZE, sizeof(shist_ring_t*));
+    (*hist)->len = 0;
+    (*hist)->size = INIT_SLOTS_SIZE;
+    (*hist)->cap = cap;
+    (*hist)->cap_bytes = cap_bytes;
+    (*hist)->next_seq = (uint64_t)time(NULL) << SHIST_SEQ_SHIFT;
+
+    if ((*hist)->slots == NULL) {
+        error_shutdown("shist err: calloc");
+    }
+}
+
+void
+shist_clone(shist_t** hist, const shist_t* from) {
+    shist_init(hist, from->cap, from->cap_bytes);
+
+    (*hist)->next_seq = from->next_seq;
+
+    for (size_t i = 0; i < from->size; ++i) {
+        const shist_ring_t* src = from->slots[i];
+
+        if (src == NULL) {
+            continue;
+        }
+
+        shist_ring_t* ring = shist_create(*hist, src->name, shist_hash(*hist, src->name));
+
+        for (unsigned k = 0; k < src->len; ++k) {
+            ring->frames[k] = frame_ref(src->frames[(src->head + k) % from->cap]);
+            ring->seqs[k] = src->seqs[(src->head + k) % from->cap];
+        }
+
+        ring->len = src->len;
+        ring->bytes = src->bytes;
+        ring->sealed = src->sealed;
+    }
+}
+
+void
+shist_free(shist_t* hist) {
+    for (size_t i = 0; i < hist->size; ++i) {
+        shist_ring_t* ring = hist->slots[i];
+
+        if (ring == NULL) {
+            continue;
+        }
+
+        while (ring->len > 0) {
+            shist_evict(ring, hist->cap);
+        }
+
+        free(ring->frames);
+        free(ring->seqs);
+        free(ring);
+    }
+
+    free(hist->slots);
+    free(hist);
+}
+
+size_t
+shist_warm(shist_t* hist, slog_t* log, frame_pool_t* pool) {
+    shist_warm_t warm = {
+        .hist = hist,
+        .pool = pool,
+        .loaded = 0,
+    };
+
+    if (hist->cap == 0) {
+        return 0;
+    }
+
+    slog_scan(log, shist_warm_visit, &warm);
+
+    return warm.loaded;
+}
+
+void
+shist_append(shist_t* hist, const char* room, frame_t* frame) {
+    if (hist->cap == 0 || frame->len > hist->cap_bytes) {
+        return;
+    }
+
+    uint64_t hash = shist_hash(hist, room);
+    shist_ring_t* ring = hist->slots[shist_probe(hist, room, hash)];
+
+    if (ring == NULL) {
+        ring = shist_create(hist, room, hash);
+    }
+
+    if (ring == NULL) {
+        return;
+    }
+
+    while (ring->len == hist->cap || ring->bytes + frame->len > hist->cap_bytes) {
+        shist_evict(ring, hist->cap);
+    }
+
+    unsigned tail = (ring->head + ring->len) % hist->cap;
+
+    ring->frames[tail] = frame_ref(frame);
+    ring->seqs[tail] = hist->next_seq++;
+    ring->len += 1;
+    ring->bytes += frame->len;
+}
+
+unsigned
+shist_snapshot(shist_t* hist, const char* room, frame_t** frames, unsigned max) {
+    if (hist->cap == 0 || max == 0) {
+        return 0;
+    }
+
+    uint64_t hash = shist_hash(hist, room);
+    unsigned count = 0;
+
+    const shist_ring_t* ring = hist->slots[shist_probe(hist, room, hash)];
+
+    if (ring != NULL) {                         /* the newest max, oldest first */
+        unsigned skip = ring->len > max ? ring->len - max : 0;
+
+        for (unsigned i = skip; i < ring->len; ++i) {
+            frames[count++] = frame_ref(ring->frames[(ring->head + i) % hist->cap]);
+        }
+    }
+
+    return count;
+}
+
+uint64_t
+shist_locate(shist_t* hist, const char* room, const char* usrname, uint64_t nonce, uint64_t* until) {
+    uint64_t hash = shist_hash(hist, room);
+    uint64_t seq = 0;
+
+    *until = 0;
+
+    if (hist->cap == 0) {
+        return 0;
+    }
+
+    const shist_ring_t* ring = hist->slots[shist_probe(hist, room, hash)];
+
+    if (ring != NULL && ring->len > 0) {
+        *until = ring->seqs[(ring->head + ring->len - 1) % hist->cap];
+
+        for (unsigned i = ring->len; i > 0; --i) {
+            unsigned idx = (ring->head + i - 1) % hist->cap;
+
+            if (shist_match(ring->frames[idx], usrname, nonce)) {
+                seq = ring->seqs[idx];
+                break;
+            }
+        }
+    }
+
+    return seq;                                 /* 0 when it fell out, everything kept is newer */
+}
+
+unsigned
+shist_after(shist_t* hist, const char* room, uint64_t* after, uint64_t until, frame_t** frames, unsigned max) {
+    if (hist->cap == 0 || max == 0) {
+        return 0;
+    }
+
+    uint64_t hash = shist_hash(hist, room);
+    unsigned count = 0;
+
+    const shist_ring_t* ring = hist->slots[shist_probe(hist, room, hash)];
+
+    for (unsigned i = 0; ring != NULL && i < ring->len && count < max; ++i) {
+        unsigned idx = (ring->head + i) % hist->cap;
+
+        if (ring->seqs[idx] <= *after) {
+            continue;
+        }
+
+        if (ring->seqs[idx] > until) {
+            break;
+        }
+
+        frames[count++] = frame_ref(ring->frames[idx]);
+        *after = ring->seqs[idx];
+    }
+
+    return count;
+}
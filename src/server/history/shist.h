@@ -0,0 +1,65 @@
+#if !defined(SHIST_H)
+#define SHIST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../log/slog.h"
+
+#include "../../crypto/siphash/siphash.h"
+#include "../../packet/packet.h"
+#include "../../packet/frame/frame.h"
+
+/*** data ***/
+
+typedef struct shist_ring {
+    char name[SIZE_OPTIONS + 1];                /* empty is the lobby */
+    uint64_t hash;
+    frame_t** frames;                           /* encoded frames, oldest at head */
+    uint64_t* seqs;                             /* parallel to frames */
+    unsigned head;
+    unsigned len;
+    size_t bytes;
+    bool sealed;                                /* warm start: an older frame no longer fits */
+} shist_ring_t;
+
+/* recent messages of every room, one per shard, only its thread touches it */
+typedef struct shist {
+    siphash_key_t key;
+    shist_ring_t** slots;                       /* open addressing, linear probing, power of two */
+    size_t len;
+    size_t size;
+    unsigned cap;                               /* frames kept per room, 0 disables history */
+    size_t cap_bytes;                           /* and their total size per room */
+    uint64_t next_seq;                          /* increases within every room of this replica */
+} shist_t;
+
+
+/*** methods ***/
+
+extern void
+shist_init(shist_t** hist, unsigned cap, size_t cap_bytes);
+
+extern void
+shist_clone(shist_t** hist, const shist_t* from);
+
+extern size_t
+shist_warm(shist_t* hist, slog_t* log, frame_pool_t* pool);
+
+extern void
+shist_free(shist_t* hist);
+
+extern void
+shist_append(shist_t* hist, const char* room, frame_t* frame);
+
+extern unsigned
+shist_snapshot(shist_t* hist, const char* room, frame_t** frames, unsigned max);
+
+extern uint64_t
+shist_locate(shist_t* hist, const char* room, const char* usrname, uint64_t nonce, uint64_t* until);
+
+extern unsigned
+shist_after(shist_t* hist, const char* room, uint64_t* after, uint64_t until, frame_t** frames, unsigned max);
+
+#endif /* !defined(SHIST_H) */
@@ -0,0 +1,168 @@
+#include "inbox.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "../../error/error.h"
+
+
+/*** data ***/
+
+#define CACHE_LINE 64
+
+typedef struct {
+    atomic_size_t seq;                          /* publishes the slot to the other side */
+    inbox_msg_t msg;
+} inbox_slot_t;
+
+struct inbox {
+    _Alignas(CACHE_LINE) atomic_size_t tail;    /* claimed by producers */
+    _Alignas(CACHE_LINE) size_t head;           /* owned by the consumer */
+    _Alignas(CACHE_LINE) atomic_bool woken;     /* an eventfd wakeup is already in flight */
+    inbox_slot_t* slots;
+    size_t mask;
+    int evfd;
+};
+
+
+/*** aux ***/
+
+static size_t
+inbox_round_pow2(unsigned cap) {
+    size_t size = 1;
+
+    while (size < cap) {
+        size <<= 1;
+    }
+
+    return size;
+}
+
+static void
+inbox_wake(inbox_t* inbox) {
+    uint64_t one = 1;
+
+    if (atomic_exchange_explicit(&inbox->woken, true, memory_order_seq_cst)) {
+        return;
+    }
+
+    while (write(inbox->evfd, &one, sizeof(one)) == -1 && errno == EINTR) {}
+}
+
+
+/*** methods ***/
+
+void
+inbox_init(inbox_t** inbox_ptr, unsigned cap) {
+    inbox_t* inbox = aligned_alloc(CACHE_LINE, sizeof(inbox_t));
+
+    if (inbox == NULL) {
+        error_shutdown("inbox err: aligned_alloc");
+    }
+
+    size_t size = inbox_round_pow2(cap);
+
+    inbox->slots = malloc(sizeof(inbox_slot_t) * size);
+    inbox->mask = size - 1;
+    inbox->head = 0;
+    inbox->evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (inbox->slots == NULL) {
+        error_shutdown("inbox err: malloc");
+    }
+
+    if (inbox->evfd == -1) {
+        error_shutdown("inbox err: eventfd");
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        atomic_init(&inbox->slots[i].seq, i);
+    }
+
+    atomic_init(&inbox->tail, 0);
+    atomic_init(&inbox->woken, false);
+
+    *inbox_ptr = inbox;
+}
+
+void
+inbox_free(inbox_t* inbox) {
+    inbox_msg_t msg;
+
+    while (inbox_pop(inbox, &msg)) {
+        frame_unref(msg.frame);
+    }
+
+    close(inbox->evfd);
+    free(inbox->slots);
+    free(inbox);
+}
+
+int
+inbox_get_fd(const inbox_t* inbox) {
+    return inbox->evfd;
+}
+
+bool
+inbox_push(inbox_t* inbox, const inbox_msg_t* msg) {
+    size_t pos = atomic_load_explicit(&inbox->tail, memory_order_relaxed);
+    inbox_slot_t* slot;
+
+    while (true) {
+        slot = &inbox->slots[pos & inbox->mask];
+
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&inbox->tail, &pos, pos + 1,
+                        memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {                  /* full, the caller decides how to back off */
+            inbox_wake(inbox);
+            return false;
+        } else {
+            pos = atomic_load_explicit(&inbox->tail, memory_order_relaxed);
+        }
+    }
+
+    slot->msg = *msg;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+    inbox_wake(inbox);
+
+    return true;
+}
+
+void
+inbox_ack(inbox_t* inbox) {
+    uint64_t count;
+
+    while (read(inbox->evfd, &count, sizeof(count)) == -1 && errno == EINTR) {}
+
+    /* cleared before draining, so a push racing with the drain wakes us again */
+    atomic_store_explicit(&inbox->woken, false, memory_order_seq_cst);
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+bool
+inbox_pop(inbox_t* inbox, inbox_msg_t* msg) {
+    inbox_slot_t* slot = &inbox->slots[inbox->head & inbox->mask];
+    size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+
+    if ((intptr_t)seq - (intptr_t)(inbox->head + 1) < 0) {
+        return false;
+    }
+
+    *msg = slot->msg;
+    atomic_store_explicit(&slot->seq, inbox->head + inbox->mask + 1, memory_order_release);
+
+    inbox->head += 1;
+
+    return true;
+}
@@ -0,0 +1,40 @@
+#if !defined(INBOX_H)
+#define INBOX_H
+
+#include <stdbool.h>
+
+#include "../../packet/frame/frame.h"
+
+/*** data ***/
+
+typedef struct {
+    frame_t* frame;
+    unsigned origin;
+    char room[SIZE_OPTIONS + 1];                /* by name, every shard keeps its own index */
+    char usrname[SIZE_USRNAME + 1];             /* a whisper for this user only, empty otherwise */
+} inbox_msg_t;
+
+typedef struct inbox inbox_t;
+
+
+/*** methods ***/
+
+extern void
+inbox_init(inbox_t** inbox, unsigned cap);
+
+extern void
+inbox_free(inbox_t* inbox);
+
+extern int
+inbox_get_fd(const inbox_t* inbox);
+
+extern bool
+inbox_push(inbox_t* inbox, const inbox_msg_t* msg);
+
+extern void
+inbox_ack(inbox_t* inbox);
+
+extern bool
+inbox_pop(inbox_t* inbox, inbox_msg_t* msg);
+
+#endif /* !defined(INBOX_H) */
@@ -0,0 +1,592 @@
+#include "slog.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../../error/error.h"
+#include "../../syscall/syscall.h"
+
+
+/*** data ***/
+
+#define INIT_SEGS_SIZE 8
+#define INIT_RETIRED_SIZE 4
+#define SEG_NAME_LEN 32
+#define SEG_DIGITS 20
+#define SEG_LOG ".log"
+#define SEG_IDX ".idx"
+#define ONE_MB (1 << 20)
+#define SLOG_BATCH 64
+#define SLOG_INBOX_SIZE 16384
+
+_Static_assert(sizeof(slog_entry_t) == 32, "index entries are read back by fixed offset");
+
+
+/*** aux ***/
+
+static void
+slog_name(char* name, uint64_t base, const char* ext) {
+    snprintf(name, SEG_NAME_LEN, "%0*" PRIu64 "%s", SEG_DIGITS, base, ext);
+}
+
+static bool
+slog_parse_name(const char* name, uint64_t* base) {
+    char* endptr = NULL;
+
+    if (strlen(name) != SEG_DIGITS + strlen(SEG_LOG)) {
+        return false;
+    }
+
+    *base = strtoull(name, &endptr, 10);
+
+    return endptr == name + SEG_DIGITS && strcmp(endptr, SEG_LOG) == 0;
+}
+
+static int
+slog_open(const slog_t* log, uint64_t base, const char* ext, int flags) {
+    char name[SEG_NAME_LEN];
+
+    slog_name(name, base, ext);
+
+    return openat(log->dirfd, name, flags | O_CLOEXEC, 0600);
+}
+
+static void
+slog_unlink(const slog_t* log, uint64_t base) {
+    char name[SEG_NAME_LEN];
+
+    slog_name(name, base, SEG_LOG);
+    (void)unlinkat(log->dirfd, name, 0);
+
+    slog_name(name, base, SEG_IDX);
+    (void)unlinkat(log->dirfd, name, 0);
+}
+
+static int
+slog_write(int fd, const void* buf, size_t len) {
+    const uint8_t* ptr = buf;
+
+    while (len > 0) {
+        ssize_t nbytes = write(fd, ptr, len);
+
+        if (nbytes == -1 && errno == EINTR) {
+            continue;
+        }
+
+        if (nbytes == -1) {
+            return -1;
+        }
+
+        ptr += nbytes;
+        len -= (size_t)nbytes;
+    }
+
+    return 0;
+}
+
+static void
+slog_push_seg(slog_t* log, slog_seg_t seg) {
+    if (log->segs_len == log->segs_size) {
+        log->segs_size = log->segs_size == 0 ? INIT_SEGS_SIZE : log->segs_size * 2;
+        log->segs = realloc(log->segs, sizeof(slog_seg_t) * log->segs_size);
+
+        if (log->segs == NULL) {
+            error_shutdown("slog err: realloc");
+        }
+    }
+
+    log->segs[log->segs_len++] = seg;
+    log->total_bytes += seg.bytes;
+}
+
+static int
+slog_cmp_seg(const void* a, const void* b) {
+    uint64_t x = ((const slog_seg_t*)a)->base;
+    uint64_t y = ((const slog_seg_t*)b)->base;
+
+    return (x > y) - (x < y);
+}
+
+static void
+slog_load_seg(slog_t* log, uint64_t base) {
+    int log_fd = slog_open(log, base, SEG_LOG, O_RDONLY);
+    int idx_fd = slog_open(log, base, SEG_IDX, O_RDWR);
+    struct stat log_st;
+    struct stat idx_st;
+
+    if (log_fd == -1 || idx_fd == -1 || fstat(log_fd, &log_st) == -1 || fstat(idx_fd, &idx_st) == -1) {
+        error_shutdown("slog err: failed to open segment %" PRIu64, base);
+    }
+
+    size_t count = (size_t)idx_st.st_size / sizeof(slog_entry_t);
+    slog_entry_t entry = {0};
+
+    /* a crash may leave a torn entry, or one for a frame that never reached the log */
+    while (count > 0) {
+        if (pread(idx_fd, &entry, sizeof(entry), (off_t)((count - 1) * sizeof(entry))) != sizeof(entry)) {
+            error_shutdown("slog err: failed to read index %" PRIu64, base);
+        }
+
+        if ((off_t)entry.off + entry.len <= log_st.st_size) {
+            break;
+        }
+
+        count -= 1;
+    }
+
+    if ((size_t)idx_st.st_size != count * sizeof(entry) && ftruncate(idx_fd, (off_t)(count * sizeof(entry))) == -1) {
+        error_shutdown("slog err: failed to trim index %" PRIu64, base);
+    }
+
+    if (count > 0 && entry.seq > log->last_seq) {
+        log->last_seq = entry.seq;
+    }
+
+    slog_push_seg(log, (slog_seg_t) {
+        .base = base,
+        .bytes = (size_t)log_st.st_size + count * sizeof(entry),
+        .last_ts = count > 0 ? entry.ts : 0,
+    });
+
+    close(log_fd);
+    close(idx_fd);
+}
+
+static void
+slog_load(slog_t* log) {
+    DIR* dir = fdopendir(dup(log->dirfd));
+
+    if (dir == NULL) {
+        error_shutdown("slog err: fdopendir");
+    }
+
+    for (struct dirent* ent = readdir(dir); ent != NULL; ent = readdir(dir)) {
+        uint64_t base;
+
+        if (slog_parse_name(ent->d_name, &base)) {
+            slog_push_seg(log, (slog_seg_t) {.base = base});
+        }
+    }
+
+    closedir(dir);
+
+    size_t len = log->segs_len;
+    slog_seg_t* found = log->segs;
+
+    qsort(found, len, sizeof(slog_seg_t), slog_cmp_seg);
+
+    log->segs = NULL;
+    log->segs_len = 0;
+    log->segs_size = 0;
+    log->total_bytes = 0;
+
+    for (size_t i = 0; i < len; ++i) {
+        slog_load_seg(log, found[i].base);
+    }
+
+    free(found);
+}
+
+static void
+slog_retire(slog_t* log) {
+    if (log->log_fd == -1) {
+        return;
+    }
+
+    if (log->config->log_sync != LOG_SYNC_NONE) {
+        (void)fdatasync(log->log_fd);
+        (void)fdatasync(log->idx_fd);
+    }
+
+    close(log->log_fd);
+    close(log->idx_fd);
+
+    log->log_fd = -1;
+    log->idx_fd = -1;
+    log->unsynced = 0;
+}
+
+static void
+slog_expire(slog_t* log) {
+    uint64_t now = (uint64_t)time(NULL);
+    size_t retain_bytes = (size_t)log->config->log_retain_mb * ONE_MB;
+    unsigned retain_secs = log->config->log_retain_secs;
+    size_t drop = 0;
+
+    while (drop + 1 < log->segs_len) {          /* never the segment being appended to */
+        const slog_seg_t* seg = &log->segs[drop];
+        bool too_big = retain_bytes != 0 && log->total_bytes > retain_bytes;
+        bool too_old = retain_secs != 0 && seg->last_ts + retain_secs < now;
+
+        if (!too_big && !too_old) {
+            break;
+        }
+
+        slog_unlink(log, seg->base);
+        log->total_bytes -= seg->bytes;
+        drop += 1;
+    }
+
+    memmove(log->segs, log->segs + drop, sizeof(slog_seg_t) * (log->segs_len - drop));
+    log->segs_len -= drop;
+}
+
+static int
+slog_rotate(slog_t* log, uint64_t base) {
+    slog_retire(log);
+
+    log->log_fd = slog_open(log, base, SEG_LOG, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND);
+    log->idx_fd = slog_open(log, base, SEG_IDX, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND);
+    log->log_bytes = 0;
+
+    if (log->log_fd == -1 || log->idx_fd == -1) {
+        if (log->log_fd != -1) {
+            close(log->log_fd);
+        }
+
+        if (log->idx_fd != -1) {
+            close(log->idx_fd);
+        }
+
+        log->log_fd = -1;
+        log->idx_fd = -1;
+
+        return -1;
+    }
+
+    slog_push_seg(log, (slog_seg_t) {.base = base});
+    slog_expire(log);
+
+    return 0;
+}
+
+static void
+slog_reopen(slog_t* log) {
+    if (log->segs_len == 0) {
+        return;
+    }
+
+    const slog_seg_t* seg = &log->segs[log->segs_len - 1];
+    size_t segment_bytes = (size_t)log->config->log_segment_mb * ONE_MB;
+
+    if (seg->bytes >= segment_bytes) {          /* full, the first append rotates */
+        return;
+    }
+
+    log->log_fd = slog_open(log, seg->base, SEG_LOG, O_WRONLY | O_APPEND);
+    log->idx_fd = slog_open(log, seg->base, SEG_IDX, O_WRONLY | O_APPEND);
+
+    struct stat st;
+
+    if (log->log_fd == -1 || log->idx_fd == -1 || fstat(log->log_fd, &st) == -1) {
+        error_shutdown("slog err: failed to reopen segment %" PRIu64, seg->base);
+    }
+
+    log->log_bytes = (uint32_t)st.st_size;
+}
+
+static void
+slog_fail(slog_t* log) {
+    if (!log->failed) {
+        error_log("slog err: append to %s failed, messages are not persisted", log->config->log_dir);
+    }
+
+    log->failed = true;
+    slog_retire(log);                           /* offsets are unknown now, start a fresh segment */
+}
+
+static void
+slog_commit(slog_t* log) {
+    if (log->batch_len == 0) {
+        return;
+    }
+
+    size_t idx_bytes = sizeof(slog_entry_t) * log->batch_len;
+    uint64_t ts = log->entries[log->batch_len - 1].ts;
+    size_t log_bytes = log->batch_bytes;
+    unsigned len = log->batch_len;
+    int rv = slog_write(log->log_fd, log->batch, log_bytes);
+
+    if (rv == 0) {
+        rv = slog_write(log->idx_fd, log->entries, idx_bytes);
+    }
+
+    log->batch_bytes = 0;
+    log->batch_len = 0;
+
+    if (rv == -1) {
+        slog_fail(log);
+        return;
+    }
+
+    slog_seg_t* seg = &log->segs[log->segs_len - 1];
+
+    seg->bytes += log_bytes + idx_bytes;
+    seg->last_ts = ts;
+    log->total_bytes += log_bytes + idx_bytes;
+    log->log_bytes += (uint32_t)log_bytes;
+    log->failed = false;
+
+    if (log->unsynced == 0) {
+        log->dirty_ms = safe_time_ms();
+    }
+
+    log->unsynced += len;
+}
+
+static void
+slog_add(slog_t* log, const char* room, const frame_t* frame) {
+    size_t segment_bytes = (size_t)log->config->log_segment_mb * ONE_MB;
+    bool full = (size_t)log->log_bytes + log->batch_bytes + frame->len > segment_bytes;
+
+    if (log->batch_len == SLOG_BATCH || full) {
+        slog_commit(log);
+    }
+
+    uint64_t seq = log->last_seq + 1;
+
+    if (log->log_fd == -1 || full) {
+        if (slog_rotate(log, seq) == -1) {
+            slog_fail(log);
+            return;
+        }
+    }
+
+    slog_entry_t* entry = &log->entries[log->batch_len];
+
+    *entry = (slog_entry_t) {
+        .seq = seq,
+        .ts = (uint64_t)time(NULL),
+        .off = log->log_bytes + (uint32_t)log->batch_bytes,
+        .len = (uint16_t)frame->len,
+        .room = {0},
+    };
+
+    memcpy(entry->room, room, strnlen(room, SIZE_OPTIONS));
+    memcpy(log->batch + log->batch_bytes, frame->buf, frame->len);
+
+    log->batch_bytes += frame->len;
+    log->batch_len += 1;
+    log->last_seq = seq;
+}
+
+static void
+slog_sync(slog_t* log, bool force) {
+    if (log->unsynced == 0 || log->config->log_sync == LOG_SYNC_NONE) {
+        return;
+    }
+
+    bool due = log->config->log_sync == LOG_SYNC_EVERY ? log->unsynced >= log->config->log_sync_value
+            : safe_time_ms() >= log->dirty_ms + log->config->log_sync_value;
+
+    if (due || force) {                         /* the group commit: every append so far in one go */
+        (void)fdatasync(log->log_fd);
+        (void)fdatasync(log->idx_fd);
+        log->unsynced = 0;
+    }
+}
+
+static int
+slog_timeout(const slog_t* log) {
+    if (log->unsynced == 0 || log->config->log_sync != LOG_SYNC_INTERVAL) {
+        return -1;
+    }
+
+    int64_t left = log->dirty_ms + log->config->log_sync_value - safe_time_ms();
+
+    return left > 0 ? (int)left : 0;
+}
+
+static void*
+slog_write_loop(void* log_nullable) {
+    slog_t* log = (slog_t*) log_nullable;
+    struct pollfd pfd = {.fd = inbox_get_fd(log->inbox), .events = POLLIN, .revents = 0};
+    bool stopping = false;
+
+    while (!stopping) {
+        if (poll(&pfd, 1, slog_timeout(log)) == -1 && errno != EINTR) {
+            error_shutdown("slog err: poll");
+        }
+
+        inbox_msg_t msg;
+
+        inbox_ack(log->inbox);
+
+        while (!stopping && inbox_pop(log->inbox, &msg)) {
+            stopping = msg.frame == NULL;       /* slog_free's, the shards are gone */
+
+            if (!stopping) {
+                slog_add(log, msg.room, msg.frame);
+                frame_unref(msg.frame);
+            }
+        }
+
+        slog_commit(log);
+        slog_sync(log, stopping);
+        atomic_store_explicit(&log->behind, false, memory_order_relaxed);
+    }
+
+    return NULL;
+}
+
+
+/*** methods ***/
+
+void
+slog_init(slog_t** log, const sconf_t* config) {
+    *log = calloc(1, sizeof(slog_t));
+
+    if (*log == NULL) {
+        error_shutdown("slog err: calloc");
+    }
+
+    (*log)->config = config;
+    (*log)->log_fd = -1;
+    (*log)->idx_fd = -1;
+
+    if (mkdir(config->log_dir, 0700) == -1 && errno != EEXIST) {
+        error_shutdown("slog err: mkdir %s", config->log_dir);
+    }
+
+    (*log)->dirfd = open(config->log_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if ((*log)->dirfd == -1) {
+        error_shutdown("slog err: open %s", config->log_dir);
+    }
+
+    (*log)->batch = malloc((size_t)SLOG_BATCH * PACKET_SIZE_MAX);
+    (*log)->entries = malloc(sizeof(slog_entry_t) * SLOG_BATCH);
+
+    if ((*log)->batch == NULL || (*log)->entries == NULL) {
+        error_shutdown("slog err: malloc");
+    }
+
+    atomic_init(&(*log)->behind, false);
+    inbox_init(&(*log)->inbox, SLOG_INBOX_SIZE);
+
+    slog_load(*log);
+    slog_reopen(*log);
+
+    if (pthread_create(&(*log)->writer, NULL, &slog_write_loop, *log) != 0) {
+        error_shutdown("slog err: pthread_create");
+    }
+}
+
+void
+slog_free(slog_t* log) {
+    inbox_msg_t stop = {
+        .frame = NULL,
+        .origin = 0,
+        .room = {0},
+        .usrname = {0},
+    };
+
+    while (!inbox_push(log->inbox, &stop)) {    /* behind everything already handed over */
+        sched_yield();
+    }
+
+    if (pthread_join(log->writer, NULL) != 0) {
+        error_log("slog err: pthread_join");
+    }
+
+    if (log->log_fd != -1) {
+        close(log->log_fd);
+        close(log->idx_fd);
+    }
+
+    inbox_free(log->inbox);
+    close(log->dirfd);
+    free(log->batch);
+    free(log->entries);
+    free(log->segs);
+    free(log);
+}
+
+void
+slog_scan(slog_t* log, slog_visit_fn_t visit, void* arg) {
+    /* startup only, nothing is handed to the writer yet */
+    for (size_t i = log->segs_len; i-- > 0;) {
+        uint64_t base = log->segs[i].base;
+        int log_fd = slog_open(log, base, SEG_LOG, O_RDONLY);
+        int idx_fd = slog_open(log, base, SEG_IDX, O_RDONLY);
+        struct stat log_st;
+        struct stat idx_st;
+
+        if (log_fd == -1 || idx_fd == -1 || fstat(log_fd, &log_st) == -1 || fstat(idx_fd, &idx_st) == -1) {
+            error_shutdown("slog err: failed to open segment %" PRIu64, base);
+        }
+
+        size_t count = (size_t)idx_st.st_size / sizeof(slog_entry_t);
+        bool more = true;
+
+        if (count > 0 && log_st.st_size > 0) {
+            const slog_entry_t* entries = mmap(NULL, (size_t)idx_st.st_size, PROT_READ, MAP_PRIVATE, idx_fd, 0);
+            const uint8_t* frames = mmap(NULL, (size_t)log_st.st_size, PROT_READ, MAP_PRIVATE, log_fd, 0);
+
+            if (entries == MAP_FAILED || frames == MAP_FAILED) {
+                error_shutdown("slog err: mmap segment %" PRIu64, base);
+            }
+
+            for (size_t k = count; more && k-- > 0;) {
+                const slog_entry_t* entry = &entries[k];
+                slog_rec_t rec = {
+                    .room = {0},
+                    .seq = entry->seq,
+                    .ts = entry->ts,
+                    .buf = frames + entry->off,
+                    .len = entry->len,
+                };
+
+                if ((off_t)entry->off + entry->len > log_st.st_size) {
+                    continue;                   /* torn by a crash without a sync */
+                }
+
+                memcpy(rec.room, entry->room, SIZE_OPTIONS);
+                more = visit(&rec, arg);
+            }
+
+            munmap((void*)entries, (size_t)idx_st.st_size);
+            munmap((void*)frames, (size_t)log_st.st_size);
+        }
+
+        close(log_fd);
+        close(idx_fd);
+
+        if (!more) {
+            return;
+        }
+    }
+}
+
+void
+slog_append(slog_t* log, const char* room, frame_t* frame) {
+    inbox_msg_t msg = {
+        .frame = frame_ref(frame),
+        .origin = 0,
+        .room = {0},
+        .usrname = {0},
+    };
+
+    strncpy(msg.room, room, SIZE_OPTIONS);
+
+    if (inbox_push(log->inbox, &msg)) {
+        return;
+    }
+
+    frame_unref(frame);
+
+    if (!atomic_exchange_explicit(&log->behind, true, memory_order_relaxed)) {
+        error_log("slog err: the log fell behind, messages are not persisted");
+    }
+}
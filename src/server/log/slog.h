@@ -0,0 +1,81 @@
+#if !defined(SLOG_H)
+#define SLOG_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../conf/sconf.h"
+#include "../inbox/inbox.h"
+
+#include "../../packet/packet.h"
+#include "../../packet/frame/frame.h"
+
+/*** data ***/
+
+/* one per record in the sidecar index, native byte order, the log holds the bare frames */
+typedef struct slog_entry {
+    uint64_t seq;
+    uint64_t ts;                                /* server clock, seconds since the epoch */
+    uint32_t off;                               /* into the segment's .log file */
+    uint16_t len;
+    char room[SIZE_OPTIONS];                    /* not nul terminated when full */
+} slog_entry_t;
+
+typedef struct slog_seg {
+    uint64_t base;                              /* first sequence number, names both files */
+    size_t bytes;                               /* log and index together */
+    uint64_t last_ts;
+} slog_seg_t;
+
+typedef struct slog_rec {
+    char room[SIZE_OPTIONS + 1];
+    uint64_t seq;
+    uint64_t ts;
+    const uint8_t* buf;                         /* straight from the mapping, valid during the visit */
+    unsigned len;
+} slog_rec_t;
+
+typedef bool (*slog_visit_fn_t)(const slog_rec_t* rec, void* arg);
+
+typedef struct slog {
+    pthread_t writer;                           /* the only thread touching the files once started */
+    inbox_t* inbox;
+    const sconf_t* config;
+    int dirfd;
+    int log_fd;                                 /* the segment being appended to */
+    int idx_fd;
+    uint32_t log_bytes;
+    slog_seg_t* segs;                           /* oldest first, the last one is current */
+    size_t segs_len;
+    size_t segs_size;
+    size_t total_bytes;
+    uint64_t last_seq;
+    uint8_t* batch;                             /* frames gathered for one write */
+    slog_entry_t* entries;
+    size_t batch_bytes;
+    unsigned batch_len;
+    unsigned unsynced;                          /* appends written since the last fdatasync */
+    int64_t dirty_ms;                           /* when the first of them was */
+    atomic_bool behind;                         /* the inbox was full, complain once */
+    bool failed;                                /* a write failed, complain once */
+} slog_t;
+
+
+/*** methods ***/
+
+extern void
+slog_init(slog_t** log, const sconf_t* config);
+
+extern void
+slog_free(slog_t* log);
+
+extern void
+slog_scan(slog_t* log, slog_visit_fn_t visit, void* arg);
+
+extern void
+slog_append(slog_t* log, const char* room, frame_t* frame);
+
+#endif /* !defined(SLOG_H) */
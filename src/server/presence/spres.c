@@ -0,0 +1,130 @@
+#include "spres.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../error/error.h"
+
+
+/*** data ***/
+
+#define INIT_DELTAS_SIZE 8
+
+
+/*** aux ***/
+
+static spres_delta_t*
+spres_find(spres_t* pres, const char* room) {
+    for (size_t i = 0; i < pres->len; ++i) {
+        if (strcmp(pres->deltas[i].room, room) == 0) {
+            return &pres->deltas[i];
+        }
+    }
+
+    if (pres->len == pres->size) {
+        pres->size *= 2;
+        pres->deltas = realloc(pres->deltas, sizeof(spres_delta_t) * pres->size);
+
+        if (pres->deltas == NULL) {
+            error_shutdown("spres err: realloc");
+        }
+    }
+
+    spres_delta_t* delta = &pres->deltas[pres->len++];
+
+    *delta = (spres_delta_t) {
+        .room = {0},
+        .joined = 0,
+        .left = 0,
+        .names = {0},
+        .names_len = 0,
+    };
+
+    memcpy(delta->room, room, strnlen(room, SIZE_OPTIONS));
+
+    return delta;
+}
+
+
+/*** methods ***/
+
+void
+spres_init(spres_t** pres) {
+    *pres = malloc(sizeof(spres_t));
+
+    if (*pres == NULL) {
+        error_shutdown("spres err: malloc");
+    }
+
+    (*pres)->deltas = malloc(sizeof(spres_delta_t) * INIT_DELTAS_SIZE);
+    (*pres)->len = 0;
+    (*pres)->size = INIT_DELTAS_SIZE;
+
+    if ((*pres)->deltas == NULL) {
+        error_shutdown("spres err: malloc");
+    }
+}
+
+void
+spres_free(spres_t* pres) {
+    free(pres->deltas);
+    free(pres);
+}
+
+bool
+spres_note(spres_t* pres, const char* room, const char* usrname, bool joined) {
+    bool opened = pres->len == 0;
+    spres_delta_t* delta = spres_find(pres, room);
+    size_t len = strnlen(usrname, SIZE_USRNAME);
+
+    if (joined) {
+        delta->joined += 1;
+    } else {
+        delta->left += 1;
+    }
+
+    if (memchr(usrname, '\n', len) == NULL && delta->names_len + 2 + len <= SIZE_PAYLD) {
+        delta->names[delta->names_len++] = '\n';
+        delta->names[delta->names_len++] = joined ? '+' : '-';
+        memcpy(delta->names + delta->names_len, usrname, len);
+        delta->names_len += len;
+        delta->names[delta->names_len] = '\0';
+    }
+
+    return opened;
+}
+
+bool
+spres_pop(spres_t* pres, packet_t* packet) {
+    if (pres->len == 0) {
+        return false;
+    }
+
+    const spres_delta_t* delta = &pres->deltas[--pres->len];
+    int used = snprintf(packet->payld, sizeof(packet->payld), "+%u -%u", delta->joined, delta->left);
+
+    /* names that do not fit after the counts are cut whole, the client then shows counts only */
+    for (size_t i = 0; i < delta->names_len; ) {
+        size_t end = i + 1;
+
+        while (end < delta->names_len && delta->names[end] != '\n') {
+            ++end;
+        }
+
+        if ((size_t)used + (end - i) > SIZE_PAYLD) {
+            break;
+        }
+
+        memcpy(packet->payld + used, delta->names + i, end - i);
+        used += (int)(end - i);
+        i = end;
+    }
+
+    packet->payld[used] = '\0';
+
+    memset(packet->options, 0, sizeof(packet->options));
+    memcpy(packet->options, delta->room, strnlen(delta->room, SIZE_OPTIONS));
+
+    return true;
+}
@@ -0,0 +1,41 @@
+#if !defined(SPRES_H)
+#define SPRES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../../packet/packet.h"
+
+/*** data ***/
+
+typedef struct spres_delta {
+    char room[SIZE_OPTIONS + 1];
+    unsigned joined;
+    unsigned left;
+    char names[SIZE_PAYLD + 1];                 /* "\n+name" and "\n-name" while they fit */
+    size_t names_len;
+} spres_delta_t;
+
+/* presence changes of one shard, held for a short window and sent as one frame per room */
+typedef struct spres {
+    spres_delta_t* deltas;                      /* rooms changed in this window, searched linearly */
+    size_t len;
+    size_t size;
+} spres_t;
+
+
+/*** methods ***/
+
+extern void
+spres_init(spres_t** pres);
+
+extern void
+spres_free(spres_t* pres);
+
+extern bool
+spres_note(spres_t* pres, const char* room, const char* usrname, bool joined);
+
+extern bool
+spres_pop(spres_t* pres, packet_t* packet);
+
+#endif /* !defined(SPRES_H) */
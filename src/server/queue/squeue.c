@@ -0,0 +1,324 @@
+#include "squeue.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "../../error/error.h"
+
+
+/*** data ***/
+
+#define INIT_QUEUE_SIZE 4
+#define SQUEUE_ZEROCOPY_MIN 16384               /* below this, pinning and notifying costs more than copying */
+
+
+/*** aux ***/
+
+inline static unsigned
+squeue_idx(const squeue_t* queue, unsigned ridx) {
+    return (queue->head + ridx) % queue->size;
+}
+
+static void
+squeue_grow(squeue_t* queue) {
+    unsigned size = queue->size == 0 ? INIT_QUEUE_SIZE : queue->size * 2;
+
+    if (size > queue->cap) {
+        size = queue->cap;
+    }
+
+    frame_t** entries = malloc(sizeof(frame_t*) * size);
+
+    if (entries == NULL) {
+        error_shutdown("squeue err: malloc");
+    }
+
+    for (unsigned i = 0; i < queue->len; ++i) {
+        entries[i] = queue->entries[squeue_idx(queue, i)];
+    }
+
+    free(queue->entries);
+
+    queue->entries = entries;
+    queue->size = size;
+    queue->head = 0;
+}
+
+static struct iovec*
+squeue_iov(squeue_t* queue, unsigned count) {
+    if (count <= queue->iov_size) {
+        return queue->iov;
+    }
+
+    unsigned size = queue->iov_size == 0 ? INIT_QUEUE_SIZE : queue->iov_size;
+
+    while (size < count) {
+        size *= 2;
+    }
+
+    queue->iov = realloc(queue->iov, sizeof(struct iovec) * size);
+
+    if (queue->iov == NULL) {
+        error_shutdown("squeue err: realloc");
+    }
+
+    queue->iov_size = size;
+
+    return queue->iov;
+}
+
+static void
+squeue_retire(squeue_t* queue, frame_t* frame_nullable) {
+    if (queue->retired_len == queue->retired_size) {
+        unsigned size = queue->retired_size == 0 ? INIT_QUEUE_SIZE : queue->retired_size * 2;
+        frame_t** retired = malloc(sizeof(frame_t*) * size);
+
+        if (retired == NULL) {
+            error_shutdown("squeue err: malloc");
+        }
+
+        for (unsigned i = 0; i < queue->retired_len; ++i) {
+            retired[i] = queue->retired[(queue->retired_head + i) % queue->retired_size];
+        }
+
+        free(queue->retired);
+
+        queue->retired = retired;
+        queue->retired_size = size;
+        queue->retired_head = 0;
+    }
+
+    queue->retired[(queue->retired_head + queue->retired_len) % queue->retired_size] = frame_nullable;
+    queue->retired_len += 1;
+}
+
+static void
+squeue_consume(squeue_t* queue, size_t bytes, bool pinned) {
+    while (bytes > 0) {
+        frame_t* frame = queue->entries[queue->head];
+        size_t left = frame->len - queue->off;
+
+        if (bytes < left) {
+            queue->off += (unsigned)bytes;
+            return;
+        }
+
+        bytes -= left;
+
+        if (pinned) {                               /* the kernel still reads it, hold on until released */
+            squeue_retire(queue, frame);
+        } else {
+            frame_unref(frame);
+        }
+
+        queue->head = squeue_idx(queue, 1);
+        queue->len -= 1;
+        queue->off = 0;
+    }
+}
+
+
+/*** methods ***/
+
+void
+squeue_init(squeue_t* queue, unsigned cap) {
+    *queue = (squeue_t) {
+        .entries = NULL,
+        .size = 0,
+        .cap = cap,
+        .head = 0,
+        .len = 0,
+        .off = 0,
+        .inflight = 0,
+        .inflight_bytes = 0,
+        .blocked = false,
+        .iov = NULL,
+        .iov_size = 0,
+        .retired = NULL,
+        .retired_size = 0,
+        .retired_head = 0,
+        .retired_len = 0,
+    };
+}
+
+void
+squeue_free(squeue_t* queue) {
+    for (unsigned i = 0; i < queue->len; ++i) {
+        frame_unref(queue->entries[squeue_idx(queue, i)]);
+    }
+
+    for (unsigned i = 0; i < queue->retired_len; ++i) {
+        frame_t* frame = queue->retired[(queue->retired_head + i) % queue->retired_size];
+
+        if (frame != NULL) {
+            frame_unref(frame);
+        }
+    }
+
+    free(queue->entries);
+    free(queue->iov);
+    free(queue->retired);
+
+    queue->entries = NULL;
+    queue->size = 0;
+    queue->len = 0;
+    queue->iov = NULL;
+    queue->iov_size = 0;
+    queue->retired = NULL;
+    queue->retired_size = 0;
+    queue->retired_head = 0;
+    queue->retired_len = 0;
+}
+
+bool
+squeue_full(const squeue_t* queue) {
+    return queue->len == queue->cap;
+}
+
+bool
+squeue_empty(const squeue_t* queue) {
+    return queue->len == 0;
+}
+
+unsigned
+squeue_vacant(const squeue_t* queue) {
+    return queue->cap - queue->len;
+}
+
+int
+squeue_push(squeue_t* queue, frame_t* frame) {
+    if (squeue_full(queue)) {
+        return -1;
+    }
+
+    if (queue->len == queue->size) {
+        squeue_grow(queue);
+    }
+
+    queue->entries[squeue_idx(queue, queue->len)] = frame_ref(frame);
+    queue->len += 1;
+
+    return 0;
+}
+
+int
+squeue_drop_oldest(squeue_t* queue) {
+    /* frames the backend is still sending, or the half written head, cannot move */
+    unsigned pinned = queue->inflight > 0 ? queue->inflight : (queue->off > 0 ? 1 : 0);
+
+    unsigned oldest = pinned;
+
+    while (oldest < queue->len && queue->entries[squeue_idx(queue, oldest)]->keep) {
+        oldest += 1;                            /* later frames lean on a v2 definition */
+    }
+
+    if (oldest >= queue->len) {
+        return -1;
+    }
+
+    frame_unref(queue->entries[squeue_idx(queue, oldest)]);
+
+    for (unsigned i = oldest; i > 0; --i) {
+        queue->entries[squeue_idx(queue, i)] = queue->entries[squeue_idx(queue, i - 1)];
+    }
+
+    queue->head = squeue_idx(queue, 1);
+    queue->len -= 1;
+
+    return 0;
+}
+
+int
+squeue_flush(squeue_t* queue, io_t* io, io_handle_t* handle, bool zerocopy) {
+    if (queue->inflight > 0 || queue->blocked) {    /* retrying a full socket only burns a syscall */
+        return FLUSH_BLOCKED;
+    }
+
+    if (queue->len == 0) {
+        return FLUSH_DRAINED;
+    }
+
+    int iovcnt = (int)queue->len;
+    struct iovec* iov = squeue_iov(queue, queue->len);
+    size_t total = 0;
+
+    for (int i = 0; i < iovcnt; ++i) {
+        frame_t* frame = queue->entries[squeue_idx(queue, (unsigned)i)];
+
+        iov[i] = (struct iovec) {
+            .iov_base = frame->buf,
+            .iov_len = frame->len,
+        };
+
+        total += frame->len;
+    }
+
+    iov[0].iov_base = (uint8_t*)iov[0].iov_base + queue->off;
+    iov[0].iov_len -= queue->off;
+    total -= queue->off;
+
+    zerocopy = zerocopy && total >= SQUEUE_ZEROCOPY_MIN;
+
+    ssize_t n = io_send(io, handle, iov, iovcnt, &zerocopy);
+
+    if (n == IO_SEND_QUEUED) {                  /* the frames stay referenced until it completes */
+        queue->inflight = (unsigned)iovcnt;
+        queue->inflight_bytes = total;
+        return FLUSH_BLOCKED;
+    }
+
+    if (n == -1) {
+        return FLUSH_ERROR;
+    }
+
+    squeue_consume(queue, (size_t)n, zerocopy);
+
+    if (zerocopy) {                             /* io_send pinned with a single call, so one marker */
+        if (queue->off > 0) {                   /* the written prefix of the head is pinned as well */
+            squeue_retire(queue, frame_ref(queue->entries[queue->head]));
+        }
+
+        squeue_retire(queue, NULL);
+    }
+
+    queue->blocked = (size_t)n < total;
+
+    return queue->blocked ? FLUSH_BLOCKED : FLUSH_DRAINED;
+}
+
+int
+squeue_complete(squeue_t* queue, int res) {
+    size_t bytes = queue->inflight_bytes;
+
+    queue->inflight = 0;
+    queue->inflight_bytes = 0;
+
+    if (res < 0) {
+        return -1;
+    }
+
+    squeue_consume(queue, bytes < (size_t)res ? bytes : (size_t)res, false);
+
+    return 0;
+}
+
+void
+squeue_unblock(squeue_t* queue) {
+    queue->blocked = false;
+}
+
+void
+squeue_release(squeue_t* queue, unsigned sends) {
+    while (sends > 0 && queue->retired_len > 0) {
+        frame_t* frame = queue->retired[queue->retired_head];
+
+        queue->retired_head = (queue->retired_head + 1) % queue->retired_size;
+        queue->retired_len -= 1;
+
+        if (frame == NULL) {
+            sends -= 1;
+        } else {
+            frame_unref(frame);
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#if !defined(SQUEUE_H)
+#define SQUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include "../../net/io/io.h"
+#include "../../packet/frame/frame.h"
+
+/*** data ***/
+
+typedef enum {
+    FLUSH_ERROR   = -1,                         /* the socket is broken */
+    FLUSH_BLOCKED =  0,                         /* the socket is full or a send is in flight */
+    FLUSH_DRAINED =  1,                         /* every queued byte is on the wire */
+} squeue_flush_t;
+
+typedef struct squeue {
+    frame_t** entries;
+    unsigned size;                              /* allocated entries, grows up to cap */
+    unsigned cap;
+    unsigned head;
+    unsigned len;
+    unsigned off;                               /* bytes of the head entry already written */
+    unsigned inflight;                          /* entries the backend still sends, pinned in place */
+    size_t inflight_bytes;
+    bool blocked;                               /* a write came up short, wait for the backend */
+    struct iovec* iov;                          /* gather list, must outlive a queued send */
+    unsigned iov_size;
+    frame_t** retired;                          /* written zero copy, NULL ends each send's frames */
+    unsigned retired_size;
+    unsigned retired_head;
+    unsigned retired_len;
+} squeue_t;
+
+
+/*** methods ***/
+
+extern void
+squeue_init(squeue_t* queue, unsigned cap);
+
+extern void
+squeue_free(squeue_t* queue);
+
+extern bool
+squeue_full(const squeue_t* queue);
+
+extern bool
+squeue_empty(const squeue_t* queue);
+
+extern unsigned
+squeue_vacant(const squeue_t* queue);
+
+extern int
+squeue_push(squeue_t* queue, frame_t* frame);
+
+extern int
+squeue_drop_oldest(squeue_t* queue);
+
+extern int
+squeue_flush(squeue_t* queue, io_t* io, io_handle_t* handle, bool zerocopy);
+
+extern int
+squeue_complete(squeue_t* queue, int res);
+
+extern void
+squeue_unblock(squeue_t* queue);
+
+extern void
+squeue_release(squeue_t* queue, unsigned sends);
+
+#endif /* !defined(SQUEUE_H) */
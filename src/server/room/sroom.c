@@ -0,0 +1,195 @@
+#include "sroom.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../conn/sconn.h"
+
+#include "../../error/error.h"
+
+
+/*** data ***/
+
+#define INIT_SLOTS_SIZE 16
+#define INIT_MEMBERS_SIZE 4
+
+
+/*** aux ***/
+
+static uint64_t
+sroom_hash(const sroom_index_t* index, const char* name) {
+    return siphash_generate(&index->key, name, strlen(name));
+}
+
+static size_t
+sroom_probe(const sroom_index_t* index, const char* name, uint64_t hash) {
+    size_t mask = index->size - 1;
+    size_t slot = hash & mask;
+
+    while (index->slots[slot] != NULL) {        /* the load factor keeps an empty slot around */
+        const sroom_t* room = index->slots[slot];
+
+        if (room->hash == hash && strcmp(room->name, name) == 0) {
+            break;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static void
+sroom_index_grow(sroom_index_t* index) {
+    sroom_t** slots = index->slots;
+    size_t size = index->size;
+
+    index->size = size * 2;
+    index->slots = calloc(index->size, sizeof(sroom_t*));
+
+    if (index->slots == NULL) {
+        error_shutdown("sroom err: calloc");
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        if (slots[i] != NULL) {
+            index->slots[sroom_probe(index, slots[i]->name, slots[i]->hash)] = slots[i];
+        }
+    }
+
+    free(slots);
+}
+
+static sroom_t*
+sroom_create(sroom_index_t* index, const char* name, uint64_t hash) {
+    if ((index->len + 1) * 4 > index->size * 3) {
+        sroom_index_grow(index);
+    }
+
+    sroom_t* room = malloc(sizeof(sroom_t));
+
+    if (room == NULL) {
+        error_shutdown("sroom err: malloc");
+    }
+
+    *room = (sroom_t) {
+        .name = {0},
+        .hash = hash,
+        .members = NULL,
+        .len = 0,
+        .size = 0,
+    };
+
+    strncpy(room->name, name, SIZE_OPTIONS);
+
+    index->slots[sroom_probe(index, room->name, hash)] = room;
+    index->len += 1;
+
+    return room;
+}
+
+static void
+sroom_destroy(sroom_index_t* index, sroom_t* room) {
+    size_t mask = index->size - 1;
+    size_t hole = sroom_probe(index, room->name, room->hash);
+
+    /* backward shift, so lookups never need tombstones */
+    for (size_t slot = (hole + 1) & mask; index->slots[slot] != NULL; slot = (slot + 1) & mask) {
+        size_t home = index->slots[slot]->hash & mask;
+
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            index->slots[hole] = index->slots[slot];
+            hole = slot;
+        }
+    }
+
+    index->slots[hole] = NULL;
+    index->len -= 1;
+
+    free(room->members);
+    free(room);
+}
+
+
+/*** methods ***/
+
+void
+sroom_index_init(sroom_index_t** index) {
+    *index = malloc(sizeof(sroom_index_t));
+
+    if (*index == NULL) {
+        error_shutdown("sroom err: malloc");
+    }
+
+    (*index)->key = siphash_key_random();
+    (*index)->slots = calloc(INIT_SLOTS_SIZE, sizeof(sroom_t*));
+    (*index)->len = 0;
+    (*index)->size = INIT_SLOTS_SIZE;
+
+    if ((*index)->slots == NULL) {
+        error_shutdown("sroom err: calloc");
+    }
+}
+
+void
+sroom_index_free(sroom_index_t* index) {
+    for (size_t i = 0; i < index->size; ++i) {
+        if (index->slots[i] != NULL) {
+            free(index->slots[i]->members);
+            free(index->slots[i]);
+        }
+    }
+
+    free(index->slots);
+    free(index);
+}
+
+sroom_t*
+sroom_find(const sroom_index_t* index, const char* name) {
+    return index->slots[sroom_probe(index, name, sroom_hash(index, name))];
+}
+
+sroom_t*
+sroom_join(sroom_index_t* index, const char* name, sconn_t* conn) {
+    uint64_t hash = sroom_hash(index, name);
+    sroom_t* room = index->slots[sroom_probe(index, name, hash)];
+
+    if (room == NULL) {
+        room = sroom_create(index, name, hash);
+    }
+
+    if (room->len == room->size) {
+        room->size = room->size == 0 ? INIT_MEMBERS_SIZE : room->size * 2;
+        room->members = realloc(room->members, sizeof(sconn_t*) * room->size);
+
+        if (room->members == NULL) {
+            error_shutdown("sroom err: realloc");
+        }
+    }
+
+    room->members[room->len] = conn;
+    conn->room = room;
+    conn->room_idx = room->len++;
+
+    return room;
+}
+
+void
+sroom_leave(sroom_index_t* index, sconn_t* conn) {
+    sroom_t* room = conn->room;
+
+    if (room == NULL) {
+        return;
+    }
+
+    sconn_t* last = room->members[--room->len];
+
+    room->members[conn->room_idx] = last;
+    last->room_idx = conn->room_idx;
+
+    conn->room = NULL;
+
+    if (room->len == 0) {
+        sroom_destroy(index, room);
+    }
+}
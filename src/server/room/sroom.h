@@ -0,0 +1,49 @@
+#if !defined(SROOM_H)
+#define SROOM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../crypto/siphash/siphash.h"
+#include "../../packet/packet.h"
+
+/*** data ***/
+
+#define SROOM_LOBBY ""                          /* where a connection sits until it names a room */
+
+struct sconn;
+
+typedef struct sroom {
+    char name[SIZE_OPTIONS + 1];
+    uint64_t hash;
+    struct sconn** members;                     /* compact, swap removed, order is meaningless */
+    size_t len;
+    size_t size;
+} sroom_t;
+
+typedef struct sroom_index {
+    siphash_key_t key;                          /* room names come from clients */
+    sroom_t** slots;                            /* open addressing, linear probing, power of two */
+    size_t len;
+    size_t size;
+} sroom_index_t;
+
+
+/*** methods ***/
+
+extern void
+sroom_index_init(sroom_index_t** index);
+
+extern void
+sroom_index_free(sroom_index_t* index);
+
+extern sroom_t*
+sroom_find(const sroom_index_t* index, const char* name);
+
+extern sroom_t*
+sroom_join(sroom_index_t* index, const char* name, struct sconn* conn);
+
+extern void
+sroom_leave(sroom_index_t* index, struct sconn* conn);
+
+#endif /* !defined(SROOM_H) */
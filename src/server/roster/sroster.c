@@ -0,0 +1,295 @@
+#include "sroster.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../error/error.h"
+
+
+/*** data ***/
+
+#define INIT_SLOTS_SIZE 16
+#define INIT_MEMBERS_SIZE 8
+
+
+/*** aux ***/
+
+static uint64_t
+sroster_hash(const sroster_t* roster, const char* str, size_t max) {
+    return siphash_generate(&roster->key, str, strnlen(str, max));
+}
+
+static size_t
+sroster_probe_room(const sroster_t* roster, const char* room, uint64_t hash) {
+    size_t mask = roster->size - 1;
+    size_t slot = hash & mask;
+
+    while (roster->slots[slot] != NULL) {       /* the load factor keeps an empty slot around */
+        const sroster_room_t* entry = roster->slots[slot];
+
+        if (entry->hash == hash && strcmp(entry->name, room) == 0) {
+            break;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static size_t
+sroster_probe_member(const sroster_room_t* room, const char* usrname, uint64_t hash) {
+    size_t mask = room->size - 1;
+    size_t slot = hash & mask;
+
+    while (room->members[slot].usrname[0] != '\0') {
+        const sroster_member_t* member = &room->members[slot];
+
+        if (member->hash == hash && strncmp(member->usrname, usrname, SIZE_USRNAME) == 0) {
+            break;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static void
+sroster_grow_rooms(sroster_t* roster) {
+    sroster_room_t** slots = roster->slots;
+    size_t size = roster->size;
+
+    roster->size = size * 2;
+    roster->slots = calloc(roster->size, sizeof(sroster_room_t*));
+
+    if (roster->slots == NULL) {
+        error_shutdown("sroster err: calloc");
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        if (slots[i] != NULL) {
+            roster->slots[sroster_probe_room(roster, slots[i]->name, slots[i]->hash)] = slots[i];
+        }
+    }
+
+    free(slots);
+}
+
+static void
+sroster_grow_members(sroster_room_t* room) {
+    sroster_member_t* members = room->members;
+    size_t size = room->size;
+
+    room->size = size * 2;
+    room->members = calloc(room->size, sizeof(sroster_member_t));
+
+    if (room->members == NULL) {
+        error_shutdown("sroster err: calloc");
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        if (members[i].usrname[0] != '\0') {
+            room->members[sroster_probe_member(room, members[i].usrname, members[i].hash)] = members[i];
+        }
+    }
+
+    free(members);
+}
+
+static sroster_room_t*
+sroster_create(sroster_t* roster, const char* name, uint64_t hash) {
+    if ((roster->len + 1) * 4 > roster->size * 3) {
+        sroster_grow_rooms(roster);
+    }
+
+    sroster_room_t* room = malloc(sizeof(sroster_room_t));
+
+    if (room == NULL) {
+        error_shutdown("sroster err: malloc");
+    }
+
+    *room = (sroster_room_t) {
+        .name = {0},
+        .hash = hash,
+        .members = calloc(INIT_MEMBERS_SIZE, sizeof(sroster_member_t)),
+        .len = 0,
+        .size = INIT_MEMBERS_SIZE,
+    };
+
+    if (room->members == NULL) {
+        error_shutdown("sroster err: calloc");
+    }
+
+    memcpy(room->name, name, strnlen(name, SIZE_OPTIONS));
+
+    roster->slots[sroster_probe_room(roster, room->name, hash)] = room;
+    roster->len += 1;
+
+    return room;
+}
+
+static void
+sroster_destroy(sroster_t* roster, size_t hole) {
+    size_t mask = roster->size - 1;
+
+    free(roster->slots[hole]->members);
+    free(roster->slots[hole]);
+
+    /* backward shift, so lookups never need tombstones */
+    for (size_t slot = (hole + 1) & mask; roster->slots[slot] != NULL; slot = (slot + 1) & mask) {
+        size_t home = roster->slots[slot]->hash & mask;
+
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            roster->slots[hole] = roster->slots[slot];
+            hole = slot;
+        }
+    }
+
+    roster->slots[hole] = NULL;
+    roster->len -= 1;
+}
+
+static void
+sroster_unlink(sroster_room_t* room, size_t hole) {
+    size_t mask = room->size - 1;
+
+    for (size_t slot = (hole + 1) & mask; room->members[slot].usrname[0] != '\0'; slot = (slot + 1) & mask) {
+        size_t home = room->members[slot].hash & mask;
+
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            room->members[hole] = room->members[slot];
+            hole = slot;
+        }
+    }
+
+    room->members[hole].usrname[0] = '\0';
+    room->len -= 1;
+}
+
+
+/*** methods ***/
+
+void
+sroster_init(sroster_t** roster) {
+    *roster = malloc(sizeof(sroster_t));
+
+    if (*roster == NULL) {
+        error_shutdown("sroster err: malloc");
+    }
+
+    if (pthread_mutex_init(&(*roster)->lock, NULL) != 0) {
+        error_shutdown("sroster err: pthread_mutex_init");
+    }
+
+    (*roster)->key = siphash_key_random();
+    (*roster)->slots = calloc(INIT_SLOTS_SIZE, sizeof(sroster_room_t*));
+    (*roster)->len = 0;
+    (*roster)->size = INIT_SLOTS_SIZE;
+
+    if ((*roster)->slots == NULL) {
+        error_shutdown("sroster err: calloc");
+    }
+}
+
+void
+sroster_free(sroster_t* roster) {
+    for (size_t i = 0; i < roster->size; ++i) {
+        if (roster->slots[i] != NULL) {
+            free(roster->slots[i]->members);
+            free(roster->slots[i]);
+        }
+    }
+
+    pthread_mutex_destroy(&roster->lock);
+    free(roster->slots);
+    free(roster);
+}
+
+void
+sroster_add(sroster_t* roster, const char* room, const char* usrname) {
+    uint64_t room_hash = sroster_hash(roster, room, SIZE_OPTIONS);
+    uint64_t hash = sroster_hash(roster, usrname, SIZE_USRNAME);
+
+    pthread_mutex_lock(&roster->lock);
+
+    sroster_room_t* entry = roster->slots[sroster_probe_room(roster, room, room_hash)];
+
+    if (entry == NULL) {
+        entry = sroster_create(roster, room, room_hash);
+    }
+
+    if ((entry->len + 1) * 4 > entry->size * 3) {
+        sroster_grow_members(entry);
+    }
+
+    sroster_member_t* member = &entry->members[sroster_probe_member(entry, usrname, hash)];
+
+    if (member->usrname[0] == '\0') {           /* a repeated JOIN is already counted */
+        memset(member->usrname, 0, sizeof(member->usrname));
+        memcpy(member->usrname, usrname, strnlen(usrname, SIZE_USRNAME));
+        member->hash = hash;
+        entry->len += 1;
+    }
+
+    pthread_mutex_unlock(&roster->lock);
+}
+
+void
+sroster_remove(sroster_t* roster, const char* room, const char* usrname) {
+    uint64_t room_hash = sroster_hash(roster, room, SIZE_OPTIONS);
+    uint64_t hash = sroster_hash(roster, usrname, SIZE_USRNAME);
+
+    pthread_mutex_lock(&roster->lock);
+
+    size_t slot = sroster_probe_room(roster, room, room_hash);
+    sroster_room_t* entry = roster->slots[slot];
+
+    if (entry != NULL) {
+        size_t idx = sroster_probe_member(entry, usrname, hash);
+
+        if (entry->members[idx].usrname[0] != '\0') {
+            sroster_unlink(entry, idx);
+        }
+
+        if (entry->len == 0) {                  /* rooms are client named, empty ones must not pile up */
+            sroster_destroy(roster, slot);
+        }
+    }
+
+    pthread_mutex_unlock(&roster->lock);
+}
+
+size_t
+sroster_snapshot(sroster_t* roster, const char* room, char* payld, size_t size) {
+    uint64_t room_hash = sroster_hash(roster, room, SIZE_OPTIONS);
+
+    pthread_mutex_lock(&roster->lock);
+
+    const sroster_room_t* entry = roster->slots[sroster_probe_room(roster, room, room_hash)];
+    size_t count = entry != NULL ? entry->len : 0;
+    size_t used = (size_t)snprintf(payld, size, "=%zu", count);
+
+    for (size_t i = 0; entry != NULL && i < entry->size; ++i) {    /* as many names as fit, the count is exact */
+        const char* usrname = entry->members[i].usrname;
+        size_t len = strlen(usrname);
+
+        if (len == 0 || strchr(usrname, '\n') != NULL) {
+            continue;
+        }
+
+        if (used + 1 + len >= size) {
+            break;
+        }
+
+        payld[used++] = '\n';
+        memcpy(payld + used, usrname, len + 1);
+        used += len;
+    }
+
+    pthread_mutex_unlock(&roster->lock);
+
+    return count;
+}
@@ -0,0 +1,53 @@
+#if !defined(SROSTER_H)
+#define SROSTER_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../crypto/siphash/siphash.h"
+#include "../../packet/packet.h"
+
+/*** data ***/
+
+typedef struct sroster_member {
+    char usrname[SIZE_USRNAME + 1];             /* empty marks a free slot */
+    uint64_t hash;
+} sroster_member_t;
+
+typedef struct sroster_room {
+    char name[SIZE_OPTIONS + 1];                /* empty is the lobby */
+    uint64_t hash;
+    sroster_member_t* members;                  /* open addressing, linear probing, power of two */
+    size_t len;
+    size_t size;
+} sroster_room_t;
+
+/* who is in every room across all shards, parked sessions included, read for snapshots */
+typedef struct sroster {
+    pthread_mutex_t lock;                       /* taken on presence changes and snapshots only */
+    siphash_key_t key;
+    sroster_room_t** slots;                     /* by room name, a room goes with its last member */
+    size_t len;
+    size_t size;
+} sroster_t;
+
+
+/*** methods ***/
+
+extern void
+sroster_init(sroster_t** roster);
+
+extern void
+sroster_free(sroster_t* roster);
+
+extern void
+sroster_add(sroster_t* roster, const char* room, const char* usrname);
+
+extern void
+sroster_remove(sroster_t* roster, const char* room, const char* usrname);
+
+extern size_t
+sroster_snapshot(sroster_t* roster, const char* room, char* payld, size_t size);
+
+#endif /* !defined(SROSTER_H) */
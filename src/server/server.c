@@ -1,202 +1,1444 @@
+#define _GNU_SOURCE                             /* pthread_setaffinity_np */
+
 #include "server.h"
 
-#include <arpa/inet.h>
-#include <netdb.h>
-#include <poll.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
-#include "../conf.h"
+#include "admit/sadmit.h"
+#include "conf/sconf.h"
+#include "conn/sconn.h"
+#include "dir/sdir.h"
+#include "history/shist.h"
+#include "log/slog.h"
+#include "inbox/inbox.h"
+#include "presence/spres.h"
+#include "queue/squeue.h"
+#include "room/sroom.h"
+#include "roster/sroster.h"
 
 #include "../error/error.h"
 #include "../packet/packet.h"
+#include "../packet/frame/frame.h"
+#include "../packet/parser/parser.h"
+#include "../packet/wire/wire.h"
 #include "../net/net.h"
+#include "../net/io/io.h"
+#include "../net/rtt/rtt.h"
+#include "../syscall/syscall.h"
+#include "../timer/wheel/wheel.h"
 
-typedef struct pfds {
-    struct pollfd* arr;
-    size_t fd_count;
-    size_t fd_size;
-} pfds_t;
 
-#define BACKLOG 10
-#define INIT_PFDS_SIZE 5
+/*** data ***/
 
-int
-get_listener_socket(void) {
+#define INIT_CONNS_SIZE 16
+#define INBOX_SIZE 4096
+#define ZEROCOPY_FANOUT_MIN 32                  /* fewer local recipients copy, pinning does not pay off */
+#define CATCHUP_PAGE 64                         /* missed frames replayed per drained queue */
+#define SHED_FULL_MS 5000                       /* turned away at the connection cap, back within one or two of these */
+#define RTT_STALE_BEATS 4                       /* a busy connection is still pinged this often, to keep its rtt fresh */
+
+typedef struct server_group server_group_t;
+typedef struct server server_t;
+
+/* a session whose socket dropped, DISC is announced only if nobody resumes it in time */
+typedef struct server_parked {
+    struct server_parked* next;                 /* every pending one, for the shard to free */
+    struct server_parked* prev;
+    server_t* srv;
+    wheel_timer_t timer;
+    char usrname[SIZE_USRNAME + 1];
+    uint64_t token;                             /* a resume replaces it, so a stale entry does nothing */
+} server_parked_t;
+
+/* one shard: an event loop thread owning its listener and its connections */
+struct server {
+    server_group_t* group;
+    sconf_t* config;
+    io_t* io;
+    frame_pool_t* pool;
+    inbox_t* inbox;                             /* frames published by the other shards */
+    sroom_index_t* rooms;                       /* local members only, by room name */
+    shist_t* history;                           /* this shard's replica, every shard sees every message */
+    frame_t** backfill;                         /* history snapshot taken on JOIN, or a catch-up page */
+    sconn_t** conns;
+    sconn_t* reap;                              /* connections doomed during the current batch */
+    sconn_t* flush;                             /* connections with frames queued this batch */
+    server_parked_t* parked;
+    wheel_t* timers;
+    spres_t* presence;                          /* changes not yet announced */
+    wheel_timer_t presence_timer;               /* armed by the first change, fires when they are */
+    wheel_timer_t stats_timer;                  /* armed while --stats is on */
+    unsigned dead;                              /* connections closed for missed pings since the last stats */
+    sadmit_t* admit;                            /* this shard's share of --accept-rate */
+    size_t conn_count;
+    size_t conn_size;
+    size_t zombies;                             /* closed, but the backend still holds them */
+    unsigned id;
     int listener;
-    int yes = 1;
-    int rv;
+    io_handle_t* accepting;
+    io_handle_t* waking;
+    pthread_t thread;
+};
+
+struct server_group {
+    sconf_t* config;
+    sdir_t* dir;                                /* joined usernames, shared by every shard */
+    sroster_t* roster;                          /* and who is in which room */
+    atomic_uint conns;                          /* tracked by every shard, held to --max-conns */
+    atomic_uint uids;                           /* the last sender id handed out, 0 is the server's */
+    slog_t* log;                                /* NULL unless --log names a directory */
+    frame_pool_t* pool;                         /* frames read back from the log at startup */
+    server_t* shards;
+    unsigned count;
+};
 
-    struct addrinfo hints, *ai, *p;
 
-    // Gets us a socket and bind it
-    memset(&hints, 0, sizeof(struct addrinfo));
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_flags = AI_PASSIVE;
+/*** connections ***/
 
-    if ((rv = getaddrinfo(NULL, DEFAULT_PORT, &hints, &ai)) != 0) {
-        fprintf(stderr, "pollserver: %s\n", gai_strerror(rv));
-        exit(1);
+static void
+server_track(server_t* srv, sconn_t* conn) {
+    if (srv->conn_count == srv->conn_size) {
+        srv->conn_size *= 2;
+        srv->conns = realloc(srv->conns, sizeof(sconn_t*) * srv->conn_size);
+
+        if (srv->conns == NULL) {
+            error_shutdown("server err: realloc");
+        }
     }
 
-    for (p = ai; p != NULL; p = p->ai_next) {
-        if ((listener = socket(p->ai_family, p->ai_socktype, p->ai_protocol)) < 0) {
-            error_log("network err: socket");
-            continue;
+    conn->idx = srv->conn_count;
+    srv->conns[srv->conn_count++] = conn;
+
+    atomic_fetch_add(&srv->group->conns, 1);
+}
+
+static void
+server_untrack(server_t* srv, sconn_t* conn) {
+    sconn_t* last = srv->conns[--srv->conn_count];
+
+    srv->conns[conn->idx] = last;
+    last->idx = conn->idx;
+
+    atomic_fetch_sub(&srv->group->conns, 1);
+}
+
+static void
+server_forget(server_t* srv, io_handle_t* handle) {
+    if (!io_forget(srv->io, handle)) {          /* IO_EV_RELEASED settles it */
+        srv->zombies += 1;
+    }
+}
+
+static void
+server_close(server_t* srv, sconn_t* conn) {
+    if (conn->state == SCONN_STATE_JOINED) {    /* before the free, whispers must not find it */
+        sdir_release(srv->group->dir, conn->usrname, conn);
+    }
+
+    server_untrack(srv, conn);
+    sroom_leave(srv->rooms, conn);
+    wheel_cancel(srv->timers, &conn->heartbeat);
+
+    if (!io_forget(srv->io, conn->handle)) {    /* sends in flight still point into its queue */
+        srv->zombies += 1;
+        return;
+    }
+
+    sconn_free(conn);
+}
+
+static void
+server_doom(server_t* srv, sconn_t* conn) {
+    if (conn->closing) {
+        return;
+    }
+
+    conn->closing = true;
+    conn->next_reap = srv->reap;
+    srv->reap = conn;
+}
+
+
+/*** events ***/
+
+static void
+server_shed(int sockfd, const packet_retry_t* retry) {
+    uint8_t buf[PACKET_SIZE_MAX] = {0};
+    packet_t packet = packet_build(PACKET_SERVER_USRNAME);
+
+    packet_set_retry(&packet, retry);
+    packet_seal(&packet, PACKET_FLAG_DISC);
+    packet_encode(&packet, buf);
+
+    /* a fresh socket has the room, no connection state is worth making for one frame */
+    (void)send(sockfd, buf, PACKET_SIZE_MIN + packet.payld_len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    (void)shutdown(sockfd, SHUT_WR);
+
+    while (recv(sockfd, buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+        continue;                               /* unread bytes would turn the close into a reset */
+    }
+
+    close(sockfd);
+
+    printf("server: turned away socket %d, retry in %u ms\n", sockfd, retry->after_ms);
+}
+
+static void
+server_heartbeat(wheel_timer_t* timer, void* srv_ptr);
+
+static bool
+server_admit(server_t* srv, int sockfd) {
+    packet_retry_t retry = {                    /* nothing frees up on a schedule, so a wide window */
+        .after_ms = SHED_FULL_MS,
+        .jitter_ms = SHED_FULL_MS,
+    };
+    unsigned max = srv->config->max_conns;
+    bool full = max > 0 && atomic_load(&srv->group->conns) >= max;
+    int64_t now = safe_time_ms();
+
+    if (!full && sadmit_take(srv->admit, now)) {
+        return true;
+    }
+
+    if (!full) {
+        sadmit_defer(srv->admit, now, &retry);
+    }
+
+    server_shed(sockfd, &retry);
+
+    return false;
+}
+
+static void
+server_accept(server_t* srv, int sockfd) {
+    if (!server_admit(srv, sockfd)) {
+        return;
+    }
+
+    sconn_t* conn;
+    sconn_init(&conn, sockfd, srv->config->queue_size);
+
+    conn->handle = io_watch(srv->io, sockfd, conn);
+
+    if (conn->handle == NULL) {
+        sconn_free(conn);
+        return;
+    }
+
+    if (srv->config->zerocopy) {
+        (void)io_zerocopy(srv->io, conn->handle);
+    }
+
+    server_track(srv, conn);
+    (void)sroom_join(srv->rooms, SROOM_LOBBY, conn);
+
+    conn->heard = safe_time_ms();
+    wheel_timer_init(&conn->heartbeat, server_heartbeat, srv);
+
+    if (srv->config->heartbeat_secs > 0) {
+        wheel_arm(srv->timers, &conn->heartbeat, conn->heard + (int64_t)srv->config->heartbeat_secs * 1000);
+    }
+
+    printf("server: new connection from %s on socket %d\n", conn->addr, sockfd);
+}
+
+static void
+server_catchup(server_t* srv, sconn_t* conn);
+
+static void
+server_lost(server_t* srv, sconn_t* conn, const char* call) {
+    if (errno == EPIPE || errno == ECONNRESET) {
+        printf("server: socket %d hung up\n", conn->sockfd);
+    } else {
+        error_log("server err: %s (fd = %d)", call, conn->sockfd);
+    }
+
+    server_doom(srv, conn);
+}
+
+static void
+server_flush(server_t* srv, sconn_t* conn) {
+    bool zerocopy = conn->room->len >= ZEROCOPY_FANOUT_MIN;
+    int rv = squeue_flush(&conn->queue, srv->io, conn->handle, zerocopy);
+
+    if (rv == FLUSH_ERROR) {
+        server_lost(srv, conn, "send");
+        return;
+    }
+
+    if (rv == FLUSH_DRAINED && conn->catchup_until != 0) {  /* the next page only once the last one left */
+        server_catchup(srv, conn);
+    }
+}
+
+static void
+server_send(server_t* srv, sconn_t* dest, frame_t* frame) {
+    if (dest->closing) {
+        return;
+    }
+
+    bool define = dest->wire_out != NULL && !frame_known(frame, dest->wire_out);
+    unsigned need = define ? 2 : 1;
+
+    if (squeue_vacant(&dest->queue) < need) {   /* pending frames may just be waiting for the batch flush */
+        server_flush(srv, dest);
+    }
+
+    if (dest->closing) {
+        return;
+    }
+
+    if (squeue_vacant(&dest->queue) < need) {
+        switch (srv->config->overflow) {
+            case OVERFLOW_DROP_NEW:
+                return;
+            case OVERFLOW_DROP_OLDEST:
+                while (squeue_vacant(&dest->queue) < need) {
+                    if (squeue_drop_oldest(&dest->queue) == -1) {
+                        return;
+                    }
+                }
+                break;
+            case OVERFLOW_DISCONNECT:
+                error_log("server err: slow consumer on fd %d, disconnecting", dest->sockfd);
+                server_doom(srv, dest);
+                return;
         }
+    }
+
+    bool idle = squeue_empty(&dest->queue);
+
+    if (define) {
+        frame_t* def = frame_define(srv->pool, dest->wire_out, frame);
+
+        (void)squeue_push(&dest->queue, def);
+        frame_unref(def);
+    }
+
+    if (dest->wire_out != NULL) {
+        frame_t* wire = frame_transcode(srv->pool, dest->wire_out, frame);
+
+        (void)squeue_push(&dest->queue, wire);
+        frame_unref(wire);
+    } else {
+        (void)squeue_push(&dest->queue, frame);
+    }
 
-        // Lose the pesky "addres already in use" error message
-        if (setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int)) == -1) {
-            perror("setsockopt");
-            exit(1);
+    if (idle && !dest->flushing) {              /* coalesce into one write at the end of the batch */
+        dest->flushing = true;
+        dest->next_flush = srv->flush;
+        srv->flush = dest;
+    }
+}
+
+static void
+server_broadcast(server_t* srv, const sroom_t* room, const sconn_t* sender, frame_t* frame) {
+    for (size_t i = 0; i < room->len; ++i) {
+        sconn_t* dest = room->members[i];
+
+        if (dest != sender) {
+            server_send(srv, dest, frame);
         }
+    }
+}
 
-        if (bind(listener, p->ai_addr, p->ai_addrlen) < 0) {
-            perror("bind");
-            close(listener);
+static void
+server_deliver(server_t* srv, const char* usrname, frame_t* frame) {
+    unsigned shard;
+    sconn_t* dest;
+
+    if (!sdir_lookup(srv->group->dir, usrname, &shard, &dest)) {
+        return;                                 /* nobody by that name, or gone meanwhile */
+    }
+
+    if (shard == srv->id) {                     /* ours, so it cannot be freed under us */
+        server_send(srv, dest, frame);
+    }
+}
+
+static void
+server_drain(server_t* srv) {
+    inbox_msg_t msg;
+
+    while (inbox_pop(srv->inbox, &msg)) {
+        if (msg.usrname[0] != '\0') {
+            server_deliver(srv, msg.usrname, msg.frame);
+            frame_unref(msg.frame);
             continue;
         }
 
-        break;
+        const sroom_t* room = sroom_find(srv->rooms, msg.room);
+
+        if (room != NULL) {                     /* no local members, nothing to do */
+            server_broadcast(srv, room, NULL, msg.frame);
+        }
+
+        if (msg.frame->buf[OFFSET_FLAGS] == PACKET_FLAG_MSG) {
+            shist_append(srv->history, msg.room, msg.frame);
+        }
+
+        frame_unref(msg.frame);
     }
+}
 
-    freeaddrinfo(ai);
+static void
+server_push(server_t* srv, server_t* shard, const inbox_msg_t* msg) {
+    frame_ref(msg->frame);
 
-    // We didn't get bound if we got to this point
-    if (p == NULL) {
-        return -1;
+    while (!inbox_push(shard->inbox, msg)) {    /* full, drain ours so a peer blocked on us can move */
+        server_drain(srv);
+        sched_yield();
     }
+}
+
+static void
+server_forward(server_t* srv, const char* room, frame_t* frame) {
+    inbox_msg_t msg = {
+        .frame = frame,
+        .origin = srv->id,
+        .room = {0},
+        .usrname = {0},
+    };
+
+    strncpy(msg.room, room, SIZE_OPTIONS);
 
-    if (listen(listener, BACKLOG) == -1) {
-        return -1;
+    for (unsigned i = 0; i < srv->group->count; ++i) {
+        server_t* shard = &srv->group->shards[i];
+
+        if (shard != srv) {
+            server_push(srv, shard, &msg);
+        }
     }
+}
+
+static void
+server_whisper(server_t* srv, const char* usrname, frame_t* frame) {
+    unsigned shard;
+    sconn_t* dest;
 
-    printf("server is ready to listen\n");
+    if (!sdir_lookup(srv->group->dir, usrname, &shard, &dest)) {
+        return;
+    }
+
+    if (shard == srv->id) {
+        server_send(srv, dest, frame);
+        return;
+    }
 
-    return listener;
+    inbox_msg_t msg = {                         /* only the owning shard hears about it */
+        .frame = frame,
+        .origin = srv->id,
+        .room = {0},
+        .usrname = {0},
+    };
+
+    memcpy(msg.usrname, usrname, strnlen(usrname, SIZE_USRNAME));
+
+    server_push(srv, &srv->group->shards[shard], &msg);
 }
 
-void
-add_to_pfds(pfds_t* pfds, int newfd) {
-    if (pfds->fd_count == pfds->fd_size) {
-        pfds->fd_size *= 2;
-        pfds->arr = realloc(pfds->arr, sizeof(struct pollfd) * pfds->fd_size);
+static void
+server_publish(server_t* srv, const char* room, const sconn_t* sender, frame_t* frame) {
+    const sroom_t* local = sroom_find(srv->rooms, room);
+
+    if (local != NULL) {
+        server_broadcast(srv, local, sender, frame);
     }
 
-    pfds->arr[pfds->fd_count].fd = newfd;
-    pfds->arr[pfds->fd_count].events = POLLIN; /* Check ready-to-read */
+    server_forward(srv, room, frame);
+}
+
+static void
+server_announce(server_t* srv, const char* room, const char* usrname, bool joined) {
+    if (joined) {
+        sroster_add(srv->group->roster, room, usrname);
+    } else {
+        sroster_remove(srv->group->roster, room, usrname);
+    }
 
-    ++(pfds->fd_count);
+    if (spres_note(srv->presence, room, usrname, joined)) {    /* the first change opens the window */
+        wheel_arm(srv->timers, &srv->presence_timer, safe_time_ms() + srv->config->presence_ms);
+    }
 }
 
-void
-del_from_pfds(pfds_t* pfds, int i) {
-    pfds->arr[i] = pfds->arr[--(pfds->fd_count)];
+static void
+server_present(wheel_timer_t* timer, void* srv_ptr) {
+    server_t* srv = (server_t*) srv_ptr;
+
+    (void)timer;
+
+    packet_t packet = packet_build(PACKET_SERVER_USRNAME);
+
+    while (spres_pop(srv->presence, &packet)) {
+        packet_seal(&packet, PACKET_FLAG_ROST);
+
+        frame_t* frame = frame_encode(srv->pool, &packet);
+
+        server_publish(srv, packet.options, NULL, frame);
+        frame_unref(frame);
+    }
 }
 
-pfds_t*
-init_pfds(void) {
-    pfds_t* pfds = malloc(sizeof(pfds_t));
+static void
+server_roster(server_t* srv, sconn_t* conn) {
+    packet_t packet = packet_build(PACKET_SERVER_USRNAME);
+
+    memcpy(packet.options, conn->room->name, sizeof(packet.options));
+    (void)sroster_snapshot(srv->group->roster, conn->room->name, packet.payld, sizeof(packet.payld));
+    packet_seal(&packet, PACKET_FLAG_ROST);
+
+    frame_t* frame = frame_encode(srv->pool, &packet);
 
-    *pfds = (pfds_t) {
-        .arr = malloc(sizeof(struct pollfd) * INIT_PFDS_SIZE),
-        .fd_count = 0,
-        .fd_size = 5
+    server_send(srv, conn, frame);
+    frame_unref(frame);
+}
+
+static void
+server_ack(server_t* srv, sconn_t* conn) {
+    packet_t packet = packet_build(PACKET_SERVER_USRNAME);
+
+    packet_set_acks(&packet, conn->acks, conn->ack_len);
+    packet_seal(&packet, PACKET_FLAG_ACK);
+    conn->ack_len = 0;
+
+    frame_t* frame = frame_encode(srv->pool, &packet);
+
+    server_send(srv, conn, frame);
+    frame_unref(frame);
+}
+
+static void
+server_accepted(server_t* srv, sconn_t* conn, uint64_t nonce) {
+    packet_ack_t* last = conn->ack_len > 0 ? &conn->acks[conn->ack_len - 1] : NULL;
+
+    if (last != NULL && nonce - last->first < last->count) {    /* a resend of one already covered */
+        return;
+    }
+
+    if (last != NULL && nonce == last->first + last->count) {
+        last->count += 1;
+    } else {
+        if (conn->ack_len == conn->caps.batch) {
+            server_ack(srv, conn);
+        }
+
+        conn->acks[conn->ack_len++] = (packet_ack_t) {.first = nonce, .count = 1};
+    }
+
+    if (!conn->flushing) {                      /* acked with the flush, even if nothing else is queued */
+        conn->flushing = true;
+        conn->next_flush = srv->flush;
+        srv->flush = conn;
+    }
+}
+
+static void
+server_flush_pending(server_t* srv) {
+    while (srv->flush != NULL) {
+        sconn_t* conn = srv->flush;
+
+        srv->flush = conn->next_flush;
+
+        if (conn->ack_len > 0) {                /* still flagged, so the ack does not queue it again */
+            server_ack(srv, conn);
+        }
+
+        conn->flushing = false;
+
+        if (!conn->closing) {
+            server_flush(srv, conn);
+        }
+    }
+}
+
+static void
+server_unpark(server_t* srv, server_parked_t* parked) {
+    wheel_cancel(srv->timers, &parked->timer);
+
+    if (parked->prev != NULL) {
+        parked->prev->next = parked->next;
+    } else {
+        srv->parked = parked->next;
+    }
+
+    if (parked->next != NULL) {
+        parked->next->prev = parked->prev;
+    }
+
+    free(parked);
+}
+
+static void
+server_expire(wheel_timer_t* timer, void* parked_ptr) {
+    server_parked_t* parked = (server_parked_t*) parked_ptr;
+    server_t* srv = parked->srv;
+    char room[SIZE_OPTIONS + 1];
+
+    (void)timer;
+
+    if (sdir_expire(srv->group->dir, parked->usrname, parked->token, room)) {
+        server_announce(srv, room, parked->usrname, false);
+    }
+
+    server_unpark(srv, parked);
+}
+
+static void
+server_park(server_t* srv, sconn_t* conn) {
+    uint64_t token = sdir_park(srv->group->dir, conn->usrname, conn, &conn->dedup);
+
+    conn->state = SCONN_STATE_PARKED;           /* the close leaves the name alone */
+
+    if (token == 0) {                           /* already resumed on another socket */
+        return;
+    }
+
+    server_parked_t* parked = malloc(sizeof(server_parked_t));
+
+    if (parked == NULL) {
+        error_shutdown("server err: malloc");
+    }
+
+    *parked = (server_parked_t) {
+        .next = srv->parked,
+        .prev = NULL,
+        .srv = srv,
+        .usrname = {0},
+        .token = token,
     };
 
-    return pfds;
+    memcpy(parked->usrname, conn->usrname, sizeof(parked->usrname));
+
+    if (srv->parked != NULL) {
+        srv->parked->prev = parked;
+    }
+
+    srv->parked = parked;
+
+    wheel_timer_init(&parked->timer, server_expire, parked);
+    wheel_arm(srv->timers, &parked->timer, safe_time_ms() + (int64_t)srv->config->grace_secs * 1000);
 }
 
-void
-free_pfds(pfds_t* pfds) {
-    free(pfds->arr);
-    free(pfds);
+static void
+server_reap(server_t* srv) {
+    char usrname[SIZE_USRNAME + 1];
+    char room[SIZE_OPTIONS + 1];
+
+    while (srv->reap != NULL) {                 /* announcing may doom more consumers */
+        sconn_t* conn = srv->reap;
+
+        srv->reap = conn->next_reap;
+
+        if (conn->state == SCONN_STATE_JOINED && srv->config->grace_secs > 0) {
+            server_park(srv, conn);
+        }
+
+        bool announce = conn->state == SCONN_STATE_JOINED;
+
+        memcpy(usrname, conn->usrname, sizeof(usrname));
+        memcpy(room, conn->room->name, sizeof(room));  /* the room goes away with its last member */
+        server_close(srv, conn);
+
+        if (announce) {
+            server_announce(srv, room, usrname, false);
+        }
+    }
 }
 
-int
-server(void) {
-    int newfd;                          /* Newly accept()ed socket descriptor */
-    struct sockaddr_storage remoteaddr; /* Client address */
-    socklen_t addrlen;
+static void
+server_settle(server_t* srv) {
+    while (srv->flush != NULL || srv->reap != NULL) {   /* flushing dooms, reaping announces */
+        server_flush_pending(srv);
+        server_reap(srv);
+    }
+}
+
+static void
+server_backfill(server_t* srv, sconn_t* conn) {
+    unsigned max = squeue_vacant(&conn->queue); /* the replay must never trip the overflow policy */
+
+    if (max > srv->config->history) {
+        max = srv->config->history;
+    }
+
+    unsigned count = shist_snapshot(srv->history, conn->room->name, srv->backfill, max);
+
+    for (unsigned i = 0; i < count; ++i) {
+        server_send(srv, conn, srv->backfill[i]);
+        frame_unref(srv->backfill[i]);
+    }
+}
+
+static void
+server_catchup(server_t* srv, sconn_t* conn) {
+    unsigned max = squeue_vacant(&conn->queue) / 2; /* half stays free for live frames */
+
+    if (max > CATCHUP_PAGE) {
+        max = CATCHUP_PAGE;
+    }
+
+    if (max > srv->config->history) {           /* the scratch buffer is sized for a backfill */
+        max = srv->config->history;
+    }
+
+    unsigned count = shist_after(srv->history, conn->room->name, &conn->catchup_after,
+            conn->catchup_until, srv->backfill, max);
+
+    if (count < max || max == 0) {              /* caught up, or a queue too short to ever page */
+        conn->catchup_after = 0;
+        conn->catchup_until = 0;
+    }
+
+    for (unsigned i = 0; i < count; ++i) {
+        server_send(srv, conn, srv->backfill[i]);
+        frame_unref(srv->backfill[i]);
+    }
+}
+
+static bool
+server_rewind(server_t* srv, sconn_t* conn, const packet_resume_t* resume) {
+    if (resume->usrname[0] == '\0') {           /* nothing rendered yet */
+        return false;
+    }
+
+    /* a position that fell out of the history replays all of it, older is lost anyway */
+    conn->catchup_after = shist_locate(srv->history, conn->room->name, resume->usrname, resume->nonce,
+            &conn->catchup_until);
+    server_catchup(srv, conn);
+
+    return true;
+}
+
+static bool
+server_move(server_t* srv, sconn_t* conn, const char* room) {
+    char old[SIZE_OPTIONS + 1];
+
+    if (strcmp(conn->room->name, room) == 0) {
+        return false;
+    }
+
+    memcpy(old, conn->room->name, sizeof(old));
+
+    sroom_leave(srv->rooms, conn);
+    (void)sroom_join(srv->rooms, room, conn);
+
+    conn->catchup_after = 0;                    /* the cursor was into the old room */
+    conn->catchup_until = 0;
+
+    if (conn->state == SCONN_STATE_JOINED) {    /* switching rooms, the old one sees it go */
+        server_announce(srv, old, conn->usrname, false);
+    }
+
+    return true;
+}
+
+static void
+server_refuse(server_t* srv, sconn_t* conn, const char* usrname) {
+    packet_t packet = packet_build(usrname);
+
+    error_log("server err: username %s already taken, refused fd %d", usrname, conn->sockfd);
+
+    packet_seal(&packet, PACKET_FLAG_EXIT);
+
+    frame_t* frame = frame_encode(srv->pool, &packet);
+
+    server_send(srv, conn, frame);
+    frame_unref(frame);
+
+    if (conn->state != SCONN_STATE_JOINED) {    /* a rename keeps the old name */
+        conn->state = SCONN_STATE_REFUSED;
+    }
+}
+
+static bool
+server_claim(server_t* srv, sconn_t* conn, const char* usrname, const char* room, uint64_t* token) {
+    char evicted[SIZE_OPTIONS + 1];
+    bool renamed = conn->state == SCONN_STATE_JOINED && strcmp(conn->usrname, usrname) != 0;
+
+    switch (sdir_claim(srv->group->dir, usrname, room, srv->id, conn, token, evicted)) {
+        case SDIR_TAKEN:
+            server_refuse(srv, conn, usrname);
+            return false;
+        case SDIR_EVICTED:                      /* its grace cut short, the room hears it dropped */
+            server_announce(srv, evicted, usrname, false);
+            break;
+        case SDIR_CLAIMED:
+            break;
+    }
+
+    if (renamed) {
+        sdir_release(srv->group->dir, conn->usrname, conn);
+    }
+
+    return true;
+}
+
+static bool
+server_reattach(server_t* srv, sconn_t* conn, const char* usrname, uint64_t* token) {
+    sdir_entry_t prev;
+
+    if (!sdir_resume(srv->group->dir, usrname, token, srv->id, conn, &prev)) {
+        return false;
+    }
 
-    char buf[PACKET_SIZE_MAX];          /* Buffer for client data */ 
-    char remoteIP[INET6_ADDRSTRLEN];
+    conn->dedup = prev.dedup;
 
-    pfds_t* pfds = init_pfds();
-    int listener = get_listener_socket();
+    if (prev.conn != NULL && prev.shard == srv->id) {   /* the old socket has not timed out yet */
+        conn->dedup = prev.conn->dedup;         /* newer than the parked copy, if there even is one */
+        prev.conn->state = SCONN_STATE_EXITED;
+        server_doom(srv, prev.conn);
+    }
+
+    sroom_leave(srv->rooms, conn);
+    (void)sroom_join(srv->rooms, prev.room, conn);
+
+    memcpy(conn->usrname, prev.usrname, sizeof(conn->usrname));
+    conn->state = SCONN_STATE_JOINED;
+
+    return true;
+}
+
+static void
+server_issue(server_t* srv, sconn_t* conn, const char* usrname, uint64_t token) {
+    packet_resume_t resume = {
+        .token = token,
+        .nonce = 0,
+        .usrname = {0},
+    };
 
-    if (listener == -1) {
-        fprintf(stderr, "error getting listening socket\n");
-        exit(1);
+    if (srv->config->grace_secs == 0 || token == 0) {
+        return;
     }
 
-    // Add the listener to set
-    add_to_pfds(pfds, listener);
+    packet_t packet = packet_build(usrname);
+
+    packet_set_resume(&packet, &resume);
+    packet_seal(&packet, PACKET_FLAG_JOIN);     /* under its own name, which a client never renders */
+
+    frame_t* frame = frame_encode(srv->pool, &packet);
+
+    server_send(srv, conn, frame);
+    frame_unref(frame);
+}
+
+static void
+server_join(server_t* srv, sconn_t* conn, const packet_t* packet) {
+    packet_resume_t resume = {0};
+    bool fresh = conn->state != SCONN_STATE_JOINED;
+    bool resuming = packet_get_resume(packet, &resume);
+    uint64_t token = resume.token;
+    bool silent = fresh && resuming && server_reattach(srv, conn, packet->usrname, &token);
+
+    if (!silent && !server_claim(srv, conn, packet->usrname, packet->options, &token)) {
+        return;
+    }
+
+    bool renamed = strcmp(conn->usrname, packet->usrname) != 0;
+    bool moved = server_move(srv, conn, packet->options);
+
+    if (renamed && !fresh && !moved) {          /* the same room, under the old name */
+        server_announce(srv, conn->room->name, conn->usrname, false);
+    }
+
+    if (!server_rewind(srv, conn, &resume) && (moved || fresh)) {  /* a repeated JOIN is not replayed to */
+        server_backfill(srv, conn);
+    }
+
+    if (silent || renamed) {
+        server_issue(srv, conn, packet->usrname, token);
+    }
+
+    if (fresh || renamed) {                     /* a wrapped id is defined again, streams compare the name */
+        conn->uid = atomic_fetch_add(&srv->group->uids, 1) + 1;
+        conn->base = 0;
+    }
 
-    while (1) {
-        int poll_count = poll(pfds->arr, pfds->fd_count, -1);
+    memcpy(conn->usrname, packet->usrname, sizeof(conn->usrname));
+    conn->state = SCONN_STATE_JOINED;
 
-        if (poll_count == -1) {
-            perror("poll");
-            exit(1);
+    if ((fresh && !silent) || moved || renamed) {
+        server_announce(srv, conn->room->name, conn->usrname, true);
+    }
+
+    if ((fresh && !silent) || moved) {
+        server_roster(srv, conn);
+    }
+}
+
+static void
+server_ping(server_t* srv, sconn_t* conn, int64_t now) {
+    packet_t packet = packet_build_ping(PACKET_SERVER_USRNAME);
+
+    packet.nonce = ++conn->ping_nonce;          /* echoed back, so a late pong is not mistaken for this one */
+    conn->ping_sent = safe_time_us();
+    conn->pinged = now;
+
+    frame_t* frame = frame_encode(srv->pool, &packet);
+
+    server_send(srv, conn, frame);
+    frame_unref(frame);
+}
+
+static void
+server_answer(server_t* srv, sconn_t* conn, const packet_view_t* view) {
+    if (view->flags == PACKET_FLAG_PONG) {
+        if (conn->ping_sent != 0 && view->nonce == conn->ping_nonce) {
+            rtt_sample(&conn->rtt, safe_time_us() - conn->ping_sent);
+            conn->ping_sent = 0;
         }
 
-        for (int i = 0; poll_count > 0; ++i) { // keep going until no more events left 
-            if (!(pfds->arr[i].revents & POLLIN)) {
-                continue;
-            }
+        return;
+    }
 
-            --poll_count; // decrease in event
+    frame_t* frame = frame_view(srv->pool, view);   /* the client measures with its own nonce */
 
-            if (pfds->arr[i].fd == listener) {
-                // If listener is ready to read, handle new connection
-                addrlen = sizeof(struct sockaddr_storage);
+    frame->buf[OFFSET_FLAGS] = PACKET_FLAG_PONG;
 
-                newfd = accept(listener, (struct sockaddr*)&remoteaddr, &addrlen);
+    server_send(srv, conn, frame);
+    frame_unref(frame);
+}
 
-                if (newfd == -1) {
-                    perror("accept");
-                } else {
-                    add_to_pfds(pfds, newfd);
+static void
+server_hello(server_t* srv, sconn_t* conn, const packet_view_t* view) {
+    packet_hello_t hello;
+    packet_t packet;
 
-                    printf("pollserver: new connection from %s on socket %d\n",
-                            inet_ntop(remoteaddr.ss_family, get_in_addr((struct sockaddr*)&remoteaddr), remoteIP, sizeof(remoteIP)), newfd);
-                }
-            } else {
-                // If not the listener, we're just a regular client
-                int nbytes = recv(pfds->arr[i].fd, buf, sizeof(buf), 0);
-                int sender_fd = pfds->arr[i].fd;
-
-                if (nbytes <= 0) {
-                    if (nbytes == 0) {
-                        printf("pollserver: socket %d hung up\n", sender_fd);
-                    } else {
-                        perror("recv");
-                    }
+    packet_view_copy(view, &packet);
 
-                    close(pfds->arr[i].fd);
-                    del_from_pfds(pfds, i);
-                    --i; // so you don't skip the deleted one
-                } else {
-                    for (size_t j = 0; j < pfds->fd_count; ++j) {
-                        int dest_fd = pfds->arr[j].fd;
-
-                        if (dest_fd != listener && dest_fd != sender_fd) {
-                            if (send(dest_fd, buf, nbytes, 0) == -1) {
-                                perror("send");
-                            }
-                        }
-                    }
-                }
+    if (!packet_get_hello(&packet, &hello)) {
+        return;
+    }
+
+    if (conn->wire_out != NULL) {               /* the confirmation, the client speaks v2 from here on */
+        sconn_upgrade(conn, true);
+        return;
+    }
+
+    (void)wire_pick(&hello, srv->config->checksum, &conn->caps);
+    wire_hello(&conn->caps, &hello);
+
+    packet = packet_build(PACKET_SERVER_USRNAME);
+    packet_set_hello(&packet, &hello);
+    packet_seal(&packet, PACKET_FLAG_HELO);
+
+    frame_t* frame = frame_encode(srv->pool, &packet);
+
+    server_send(srv, conn, frame);
+    frame_unref(frame);
+
+    if (conn->caps.version == WIRE_V2) {
+        sconn_upgrade(conn, false);
+    }
+}
+
+static void
+server_heartbeat(wheel_timer_t* timer, void* srv_ptr) {
+    server_t* srv = (server_t*) srv_ptr;
+    sconn_t* conn = (sconn_t*)((char*)timer - offsetof(sconn_t, heartbeat));
+    int64_t interval = (int64_t)srv->config->heartbeat_secs * 1000;
+    int64_t now = safe_time_ms();
+
+    if (conn->closing) {
+        return;
+    }
+
+    if (conn->heard >= conn->pinged) {
+        conn->missed = 0;
+    }
+
+    if (now - conn->heard < interval) {
+        if (now - conn->pinged >= interval * RTT_STALE_BEATS) {
+            server_ping(srv, conn, now);        /* not for liveness, only to keep the rtt current */
+        }
+
+        wheel_arm(srv->timers, timer, conn->heard + interval);
+        return;
+    }
+
+    if (conn->missed >= srv->config->max_misses) {
+        errno = ETIMEDOUT;
+        error_log("server err: fd %d silent for %u pings, disconnecting", conn->sockfd, conn->missed);
+        srv->dead += 1;
+        server_doom(srv, conn);
+        return;
+    }
+
+    conn->missed += 1;
+    server_ping(srv, conn, now);
+    wheel_arm(srv->timers, timer, now + interval);
+}
+
+static void
+server_dispatch(server_t* srv, sconn_t* conn, const packet_view_t* view) {
+    if (view->flags == PACKET_FLAG_ROST || view->flags == PACKET_FLAG_ACK) {
+        return;
+    }
+
+    if (view->flags == PACKET_FLAG_HELO) {
+        server_hello(srv, conn, view);
+        return;
+    }
+
+    if (view->flags & (PACKET_FLAG_PING | PACKET_FLAG_PONG)) {
+        server_answer(srv, conn, view);
+        return;
+    }
+
+    if (view->flags & PACKET_FLAG_JOIN) {       /* options name the room, empty is the lobby */
+        packet_t packet;
+
+        packet_view_copy(view, &packet);        /* a JOIN is kept, the name and room outlive the frame */
+        server_join(srv, conn, &packet);
+        return;
+    }
+
+    if (conn->state == SCONN_STATE_REFUSED) {
+        return;
+    }
+
+    if (view->flags & PACKET_FLAG_EXIT) {
+        if (conn->state == SCONN_STATE_JOINED) {
+            sdir_release(srv->group->dir, conn->usrname, conn);
+            server_announce(srv, conn->room->name, conn->usrname, false);
+        }
+
+        conn->state = SCONN_STATE_EXITED;
+        return;
+    }
+
+    bool tracked = view->flags & (PACKET_FLAG_MSG | PACKET_FLAG_WHSP);
+
+    if (tracked && !sdedup_fresh(&conn->dedup, view->nonce)) {
+        server_accepted(srv, conn, view->nonce);    /* a resend whose ack was lost, acked but not fanned out */
+        return;
+    }
+
+    frame_t* frame = frame_view(srv->pool, view);
+
+    if (tracked) {                              /* anything else names its sender, its nonces are unrelated */
+        conn->base = conn->base != 0 ? conn->base : view->nonce;
+        frame->sender = conn->uid;
+        frame->base = conn->base;
+    }
+
+    if (view->flags & PACKET_FLAG_WHSP) {
+        char dest[SIZE_USRNAME + 1];
+
+        packet_str_copy(view->options, dest);   /* options name the one recipient */
+        server_whisper(srv, dest, frame);
+    } else {
+        server_publish(srv, conn->room->name, conn, frame);
+    }
+
+    if (view->flags == PACKET_FLAG_MSG) {       /* notices and whispers are not replayed */
+        shist_append(srv->history, conn->room->name, frame);
+
+        if (srv->group->log != NULL) {
+            slog_append(srv->group->log, conn->room->name, frame);
+        }
+    }
+
+    if (tracked) {
+        server_accepted(srv, conn, view->nonce);
+    }
+
+    frame_unref(frame);
+}
+
+static void
+server_parse(server_t* srv, sconn_t* conn, const uint8_t* buf, size_t len) {
+    packet_view_t view;
+    size_t off = 0;
+
+    while (off < len) {
+        size_t used = 0;
+        int rv = conn->wire_in != NULL ? wire_feed(conn->wire_in, buf + off, len - off, &used, &view)
+                : packet_parser_feed(&conn->parser, buf + off, len - off, &used, &view);
+
+        off += used;
+
+        if (rv == PARSE_INVAL && conn->wire_in != NULL) {
+            error_log("server err: corrupt v2 stream from fd %d, disconnecting", conn->sockfd);
+            server_doom(srv, conn);
+            return;
+        }
+
+        if (rv == PARSE_INVAL) {
+            error_log("server err: dropped corrupt frame from fd %d", conn->sockfd);
+            continue;
+        }
+
+        if (rv == PARSE_FRAME) {
+            server_dispatch(srv, conn, &view);
+        }
+    }
+}
+
+static void
+server_recv(server_t* srv, sconn_t* conn, const uint8_t* buf, size_t len) {
+    if (conn->closing) {
+        return;
+    }
+
+    conn->heard = safe_time_ms();
+
+    server_parse(srv, conn, buf, len);
+    server_flush_pending(srv);                  /* every frame of this read goes out in one write */
+}
+
+static void
+server_writable(server_t* srv, sconn_t* conn) {
+    squeue_unblock(&conn->queue);
+
+    if (!conn->closing) {
+        server_flush(srv, conn);
+    }
+}
+
+static void
+server_sent(server_t* srv, sconn_t* conn, int res) {
+    if (conn->closing) {
+        return;
+    }
+
+    if (squeue_complete(&conn->queue, res) == -1) {
+        errno = -res;
+        server_lost(srv, conn, "send");
+        return;
+    }
+
+    server_flush(srv, conn);
+}
+
+static void
+server_unpin(sconn_t* conn, int res) {
+    squeue_release(&conn->queue, (unsigned)res);    /* closing too, the frames must not leak */
+}
+
+static void
+server_hangup(server_t* srv, sconn_t* conn, int res) {
+    if (conn->closing) {
+        return;
+    }
+
+    if (res == 0) {
+        printf("server: socket %d hung up\n", conn->sockfd);
+        server_doom(srv, conn);
+        return;
+    }
+
+    errno = -res;
+    server_lost(srv, conn, "recv");
+}
+
+static void
+server_release(server_t* srv, sconn_t* conn_nullable) {
+    if (conn_nullable != NULL) {                /* the listener and the inbox carry no data */
+        sconn_free(conn_nullable);
+    }
+
+    srv->zombies -= 1;
+}
+
+static void
+server_handle(server_t* srv, const io_event_t* event) {
+    switch (event->type) {
+        case IO_EV_ACCEPT:
+            server_accept(srv, event->fd);
+            break;
+        case IO_EV_RECV:
+            server_recv(srv, event->data, event->buf, event->len);
+            break;
+        case IO_EV_HUP:
+            server_hangup(srv, event->data, event->res);
+            break;
+        case IO_EV_WRITABLE:
+            server_writable(srv, event->data);
+            break;
+        case IO_EV_SENT:
+            server_sent(srv, event->data, event->res);
+            break;
+        case IO_EV_WAKE:
+            inbox_ack(srv->inbox);
+            server_drain(srv);
+            break;
+        case IO_EV_RELEASED:
+            server_release(srv, event->data);
+            break;
+        case IO_EV_ZEROCOPY:
+            server_unpin(event->data, event->res);
+            break;
+    }
+}
+
+
+/*** shard ***/
+
+static void
+server_stats(wheel_timer_t* timer, void* srv_ptr) {
+    server_t* srv = (server_t*) srv_ptr;
+    int64_t sum = 0;
+    int64_t max = 0;
+    size_t measured = 0;
+
+    for (size_t i = 0; i < srv->conn_count; ++i) {
+        const rtt_t* rtt = &srv->conns[i]->rtt;
+
+        if (rtt->samples == 0) {
+            continue;
+        }
+
+        sum += rtt->srtt_us;
+        max = rtt->srtt_us > max ? rtt->srtt_us : max;
+        measured += 1;
+    }
+
+    printf("server: shard %u stats: %zu conns, rtt avg %.2f ms max %.2f ms over %zu, %u dead peers reaped\n",
+            srv->id, srv->conn_count, measured > 0 ? (double)sum / (double)measured / 1000.0 : 0.0,
+            (double)max / 1000.0, measured, srv->dead);
+
+    srv->dead = 0;
+    wheel_arm(srv->timers, timer, safe_time_ms() + (int64_t)srv->config->stats_secs * 1000);
+}
+
+static void
+server_init(server_t* srv) {
+    srv->conns = malloc(sizeof(sconn_t*) * INIT_CONNS_SIZE);
+    srv->backfill = malloc(sizeof(frame_t*) * (srv->config->history + 1));
+    srv->reap = NULL;
+    srv->flush = NULL;
+    srv->parked = NULL;
+    srv->conn_count = 0;
+    srv->conn_size = INIT_CONNS_SIZE;
+    srv->zombies = 0;
+    srv->dead = 0;
+    srv->listener = get_socket_listen(srv->config->port, srv->group->count > 1);
+
+    if (srv->conns == NULL || srv->backfill == NULL) {
+        error_shutdown("server err: malloc");
+    }
+
+    if (srv->listener == -1) {
+        error_shutdown("server err: failed to get listening socket");
+    }
+
+    if (set_socket_nonblock(srv->listener) == -1) {
+        error_shutdown("server err: failed to set listener non blocking");
+    }
+
+    sroom_index_init(&srv->rooms);
+    spres_init(&srv->presence);
+    wheel_init(&srv->timers, safe_time_ms());
+    wheel_timer_init(&srv->presence_timer, server_present, srv);
+    wheel_timer_init(&srv->stats_timer, server_stats, srv);
+    sadmit_init(&srv->admit, (srv->config->accept_rate + srv->group->count - 1) / srv->group->count);
+    io_init(&srv->io, srv->config->io);         /* per thread, io_uring rings want a single issuer */
+    frame_pool_init(&srv->pool);                /* created here, so the pool belongs to this thread */
+
+    if (srv->config->stats_secs > 0) {
+        wheel_arm(srv->timers, &srv->stats_timer, safe_time_ms() + (int64_t)srv->config->stats_secs * 1000);
+    }
+
+    srv->accepting = io_listen(srv->io, srv->listener, NULL);
+    srv->waking = io_watch_wake(srv->io, inbox_get_fd(srv->inbox), NULL);
+
+    if (srv->accepting == NULL) {
+        error_shutdown("server err: failed to watch listener");
+    }
+
+    if (srv->waking == NULL) {
+        error_shutdown("server err: failed to watch inbox");
+    }
+}
+
+static void
+server_free(server_t* srv) {
+    io_event_t events[IO_MAX_EVENTS];
+
+    while (srv->conn_count > 0) {
+        server_close(srv, srv->conns[srv->conn_count - 1]);
+    }
+
+    server_forget(srv, srv->accepting);
+    server_forget(srv, srv->waking);
+
+    while (srv->zombies > 0) {                  /* wait for the backend to cancel what is in flight */
+        int count = io_wait(srv->io, events, IO_MAX_EVENTS, -1);
+
+        if (count == -1) {
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            if (events[i].type == IO_EV_RELEASED) {
+                server_release(srv, events[i].data);
             }
         }
     }
 
-    free_pfds(pfds);
+    while (srv->parked != NULL) {
+        server_unpark(srv, srv->parked);
+    }
+
+    io_free(srv->io);
+    wheel_free(srv->timers);
+    spres_free(srv->presence);
+    sadmit_free(srv->admit);
+    sroom_index_free(srv->rooms);
+    close(srv->listener);
+    free(srv->conns);
+    free(srv->backfill);
+}
+
+static void
+server_pin(const server_t* srv) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET((int)(srv->id % (unsigned)(cpus > 0 ? cpus : 1)), &set);
+
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        error_log("server err: failed to pin shard %u", srv->id);
+    }
+}
+
+static void*
+server_loop(void* srv_nullable) {
+    server_t* srv = (server_t*) srv_nullable;
+    io_event_t events[IO_MAX_EVENTS];
+
+    if (srv->config->pin) {
+        server_pin(srv);
+    }
+
+    server_init(srv);
+
+    printf("server: shard %u ready to listen on port %s (%s)\n", srv->id, srv->config->port, io_get_name(srv->io));
+
+    while (true) {
+        int count = io_wait(srv->io, events, IO_MAX_EVENTS, wheel_timeout(srv->timers, safe_time_ms()));
+
+        if (count == -1) {
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            server_handle(srv, &events[i]);
+        }
+
+        wheel_advance(srv->timers, safe_time_ms());
+        server_settle(srv);
+    }
+
+    server_free(srv);
+
+    return NULL;
+}
+
+
+/*** server ***/
+
+static void
+server_group_init(server_group_t* group, const char** args) {
+    sconf_init(&group->config, args);
+    sdir_init(&group->dir);
+    sroster_init(&group->roster);
+    atomic_init(&group->conns, 0);
+    atomic_init(&group->uids, 0);
+    group->log = NULL;
+
+    if (group->config->log_dir != NULL) {
+        slog_init(&group->log, group->config);
+    }
+
+    frame_pool_init(&group->pool);
+
+    group->count = group->config->threads;
+    group->shards = calloc(group->count, sizeof(server_t));
+
+    if (group->shards == NULL) {
+        error_shutdown("server err: calloc");
+    }
+
+    shist_init(&group->shards[0].history, group->config->history, group->config->history_bytes);
+
+    if (group->log != NULL) {
+        int64_t start = safe_time_ms();
+        size_t loaded = shist_warm(group->shards[0].history, group->log, group->pool);
+
+        printf("server: warm started %zu messages from %s in %lld ms\n",
+                loaded, group->config->log_dir, (long long)(safe_time_ms() - start));
+    }
+
+    for (unsigned i = 0; i < group->count; ++i) {   /* every inbox exists before any shard runs */
+        server_t* srv = &group->shards[i];
+
+        srv->group = group;
+        srv->config = group->config;
+        srv->id = i;
+
+        if (i > 0) {                            /* the warm start is read once and shared */
+            shist_clone(&srv->history, group->shards[0].history);
+        }
+
+        inbox_init(&srv->inbox, INBOX_SIZE);
+    }
+}
+
+static void
+server_group_free(server_group_t* group) {
+    for (unsigned i = 0; i < group->count; ++i) {
+        inbox_free(group->shards[i].inbox);
+        shist_free(group->shards[i].history);   /* hands its frames back before the pools go */
+    }
+
+    if (group->log != NULL) {
+        slog_free(group->log);
+    }
+
+    for (unsigned i = 0; i < group->count; ++i) {
+        frame_pool_free(group->shards[i].pool);
+    }
+
+    frame_pool_free(group->pool);
+
+    free(group->shards);
+    sroster_free(group->roster);
+    sdir_free(group->dir);
+    sconf_free(group->config);
+}
+
+int
+server(const char** args) {
+    server_group_t group;
+
+    server_group_init(&group, args);
+
+    for (unsigned i = 0; i < group.count; ++i) {
+        if (pthread_create(&group.shards[i].thread, NULL, &server_loop, &group.shards[i]) != 0) {
+            error_shutdown("server err: pthread_create");
+        }
+    }
+
+    for (unsigned i = 0; i < group.count; ++i) {
+        if (pthread_join(group.shards[i].thread, NULL) != 0) {
+            error_shutdown("server err: pthread_join");
+        }
+    }
+
+    server_group_free(&group);
 
     return 0;
 }
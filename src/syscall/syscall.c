@@ -11,6 +11,8 @@
 #include "../error/error.h"
 
 #define MS_IN_SC 1000
+#define US_IN_SC 1000000
+#define NS_IN_US 1000
 
 /*** sleep ***/
 
@@ -62,3 +64,14 @@ safe_time_ms(void) {
 
     return (ts.tv_sec * MS_IN_SC) + (ts.tv_nsec / ONE_MS);
 }
+
+int64_t
+safe_time_us(void) {
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+        error_shutdown("syscall err: clock_gettime");
+    }
+
+    return (ts.tv_sec * US_IN_SC) + (ts.tv_nsec / NS_IN_US);
+}
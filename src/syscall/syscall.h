@@ -16,4 +16,7 @@ safe_rand(void);
 extern int64_t
 safe_time_ms(void);
 
+extern int64_t
+safe_time_us(void);
+
 #endif /* !defined(SYSCALL_H) */
@@ -0,0 +1,259 @@
+#include "wheel.h"
+
+#include <limits.h>
+#include <stdlib.h>
+
+#include "../../error/error.h"
+
+
+/*** data ***/
+
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_REACH (1LL << (WHEEL_BITS * WHEEL_LEVELS))
+
+
+/*** aux ***/
+
+static wheel_timer_t*
+wheel_head(wheel_t* wheel, unsigned slot) {
+    return &wheel->slots[slot / WHEEL_SLOTS][slot % WHEEL_SLOTS];
+}
+
+static void
+wheel_place(wheel_t* wheel, wheel_timer_t* timer) {
+    int64_t expires = timer->deadline > wheel->now ? timer->deadline : wheel->now;
+    int64_t delta = expires - wheel->now;
+    unsigned level = 0;
+
+    if (delta >= WHEEL_REACH) {                 /* parked in the furthest slot, placed again once it cascades */
+        expires = wheel->now + WHEEL_REACH - 1;
+        delta = WHEEL_REACH - 1;
+    }
+
+    while (delta >= 1LL << (WHEEL_BITS * (level + 1))) {
+        level += 1;
+    }
+
+    /* past the first level a slot is never the current one, so it cascades before its deadline */
+    unsigned idx = (unsigned)(expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    wheel_timer_t* head = &wheel->slots[level][idx];
+
+    timer->slot = level * WHEEL_SLOTS + idx;
+    timer->next = head;
+    timer->prev = head->prev;
+    head->prev->next = timer;
+    head->prev = timer;
+
+    wheel->occupied[level] |= 1ULL << idx;
+}
+
+static void
+wheel_unlink(wheel_timer_t* timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = NULL;
+    timer->prev = NULL;
+}
+
+static void
+wheel_take(wheel_t* wheel, unsigned level, unsigned idx, wheel_timer_t* list) {
+    wheel_timer_t* head = &wheel->slots[level][idx];
+
+    if (head->next == head) {
+        list->next = list;
+        list->prev = list;
+        return;
+    }
+
+    list->next = head->next;                    /* the whole slot at once, callbacks may arm into it */
+    list->prev = head->prev;
+    list->next->prev = list;
+    list->prev->next = list;
+
+    head->next = head;
+    head->prev = head;
+
+    wheel->occupied[level] &= ~(1ULL << idx);
+}
+
+static void
+wheel_fire(wheel_t* wheel, unsigned idx) {
+    wheel_timer_t list;
+
+    wheel_take(wheel, 0, idx, &list);
+
+    while (list.next != &list) {
+        wheel_timer_t* timer = list.next;
+
+        wheel_unlink(timer);
+        wheel->len -= 1;
+
+        timer->fn(timer, timer->arg);
+    }
+}
+
+static void
+wheel_cascade(wheel_t* wheel, unsigned level, unsigned idx) {
+    wheel_timer_t list;
+
+    wheel_take(wheel, level, idx, &list);
+
+    while (list.next != &list) {
+        wheel_timer_t* timer = list.next;
+
+        wheel_unlink(timer);
+        wheel_place(wheel, timer);
+    }
+}
+
+static int64_t
+wheel_next(const wheel_t* wheel) {
+    int64_t next = INT64_MAX;
+
+    for (unsigned level = 0; level < WHEEL_LEVELS; ++level) {
+        uint64_t occupied = wheel->occupied[level];
+
+        if (occupied == 0) {
+            continue;
+        }
+
+        unsigned shift = WHEEL_BITS * level;
+        unsigned from = (unsigned)((wheel->now >> shift) + 1) & WHEEL_MASK;
+        uint64_t ahead = (occupied >> from) | (occupied << ((WHEEL_SLOTS - from) & WHEEL_MASK));
+        int64_t at = ((wheel->now >> shift) + __builtin_ctzll(ahead) + 1) << shift;
+
+        if (at < next) {                        /* a higher level may cascade before a lower one fires */
+            next = at;
+        }
+    }
+
+    return next;
+}
+
+static bool
+wheel_late(const wheel_t* wheel) {
+    return wheel->occupied[0] & (1ULL << (wheel->now & WHEEL_MASK));
+}
+
+
+/*** methods ***/
+
+void
+wheel_init(wheel_t** wheel, int64_t now_ms) {
+    *wheel = malloc(sizeof(wheel_t));
+
+    if (*wheel == NULL) {
+        error_shutdown("wheel err: malloc");
+    }
+
+    (*wheel)->now = now_ms;
+    (*wheel)->len = 0;
+
+    for (unsigned level = 0; level < WHEEL_LEVELS; ++level) {
+        (*wheel)->occupied[level] = 0;
+
+        for (unsigned idx = 0; idx < WHEEL_SLOTS; ++idx) {
+            wheel_timer_t* head = &(*wheel)->slots[level][idx];
+
+            head->next = head;
+            head->prev = head;
+        }
+    }
+}
+
+void
+wheel_free(wheel_t* wheel) {
+    free(wheel);
+}
+
+void
+wheel_timer_init(wheel_timer_t* timer, wheel_fn_t fn, void* arg) {
+    *timer = (wheel_timer_t) {
+        .next = NULL,
+        .prev = NULL,
+        .deadline = 0,
+        .slot = 0,
+        .fn = fn,
+        .arg = arg,
+    };
+}
+
+bool
+wheel_armed(const wheel_timer_t* timer) {
+    return timer->next != NULL;
+}
+
+void
+wheel_arm(wheel_t* wheel, wheel_timer_t* timer, int64_t deadline_ms) {
+    wheel_cancel(wheel, timer);
+
+    timer->deadline = deadline_ms;              /* already due fires on the next advance */
+    wheel_place(wheel, timer);
+    wheel->len += 1;
+}
+
+void
+wheel_cancel(wheel_t* wheel, wheel_timer_t* timer) {
+    if (!wheel_armed(timer)) {
+        return;
+    }
+
+    wheel_timer_t* head = wheel_head(wheel, timer->slot);
+
+    wheel_unlink(timer);
+    wheel->len -= 1;
+
+    if (head->next == head) {
+        wheel->occupied[timer->slot / WHEEL_SLOTS] &= ~(1ULL << (timer->slot % WHEEL_SLOTS));
+    }
+}
+
+void
+wheel_advance(wheel_t* wheel, int64_t now_ms) {
+    if (wheel_late(wheel)) {
+        wheel_fire(wheel, (unsigned)(wheel->now & WHEEL_MASK));
+    }
+
+    while (wheel->len > 0) {
+        int64_t next = wheel_next(wheel);
+
+        if (next > now_ms) {
+            break;
+        }
+
+        wheel->now = next;
+
+        for (unsigned level = WHEEL_LEVELS - 1; level > 0; --level) {
+            unsigned shift = WHEEL_BITS * level;
+
+            if ((next & ((1LL << shift) - 1)) == 0) {
+                wheel_cascade(wheel, level, (unsigned)(next >> shift) & WHEEL_MASK);
+            }
+        }
+
+        wheel_fire(wheel, (unsigned)(next & WHEEL_MASK));
+    }
+
+    if (wheel->now < now_ms) {
+        wheel->now = now_ms;
+    }
+}
+
+int
+wheel_timeout(const wheel_t* wheel, int64_t now_ms) {
+    if (wheel->len == 0) {
+        return -1;
+    }
+
+    if (wheel_late(wheel)) {
+        return 0;
+    }
+
+    int64_t left = wheel_next(wheel) - now_ms;
+
+    if (left < 0) {
+        return 0;
+    }
+
+    return left > INT_MAX ? INT_MAX : (int)left;
+}
@@ -0,0 +1,63 @@
+#if !defined(WHEEL_H)
+#define WHEEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*** data ***/
+
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 4                          /* 1 ms ticks, 2^24 ms reach, further out is re-cascaded */
+
+typedef struct wheel_timer wheel_timer_t;
+
+typedef void (*wheel_fn_t)(wheel_timer_t* timer, void* arg);
+
+/* embedded in whatever it times, the wheel never allocates one */
+struct wheel_timer {
+    wheel_timer_t* next;                        /* NULL while disarmed */
+    wheel_timer_t* prev;
+    int64_t deadline;                           /* ms, on the clock the wheel is advanced with */
+    unsigned slot;                              /* level * WHEEL_SLOTS + index, to clear the bitmap */
+    wheel_fn_t fn;
+    void* arg;
+};
+
+/* a hierarchical timing wheel: O(1) arm and cancel, fires in deadline order to the tick */
+typedef struct wheel {
+    int64_t now;                                /* last tick processed */
+    size_t len;
+    uint64_t occupied[WHEEL_LEVELS];            /* a bit per non-empty slot */
+    wheel_timer_t slots[WHEEL_LEVELS][WHEEL_SLOTS];  /* list heads, circular */
+} wheel_t;
+
+
+/*** methods ***/
+
+extern void
+wheel_init(wheel_t** wheel, int64_t now_ms);
+
+extern void
+wheel_free(wheel_t* wheel);
+
+extern void
+wheel_timer_init(wheel_timer_t* timer, wheel_fn_t fn, void* arg);
+
+extern bool
+wheel_armed(const wheel_timer_t* timer);
+
+extern void
+wheel_arm(wheel_t* wheel, wheel_timer_t* timer, int64_t deadline_ms);
+
+extern void
+wheel_cancel(wheel_t* wheel, wheel_timer_t* timer);
+
+extern void
+wheel_advance(wheel_t* wheel, int64_t now_ms);
+
+extern int
+wheel_timeout(const wheel_t* wheel, int64_t now_ms);
+
+#endif /* !defined(WHEEL_H) */